@@ -0,0 +1,209 @@
+#ifndef BENCH_BACKENDS_HPP
+#define BENCH_BACKENDS_HPP
+
+#include "brasstacks/memory/BasicHeap.hpp"
+#include "brasstacks/memory/BuddyHeap.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "bench_helpers.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+namespace bench {
+
+// Every backend the benchmarks can drive exposes the same small interface:
+// a name, alloc(), free(), and fragmentation() where the backend can report it.
+// Backends that can be shared between threads say so with thread_safe, and
+// report how often their lock was found already held via contention().
+// Heap-based backends also hand back Heap's own per-call timings from
+// heap_latency(), when the library was built with BTX_MEMORY_LATENCY.
+
+struct Contention final {
+    std::size_t acquisitions = 0;
+    std::size_t contended = 0;
+};
+
+struct HeapLatency final {
+    Percentiles alloc_ns { };
+    Percentiles free_ns { };
+};
+
+// =============================================================================
+// Wraps one of the library's lock policies, counting how often a thread
+// arrived to find it already held
+template<typename Lock>
+class CountingLock final {
+public:
+    static constexpr char const *name = Lock::name;
+
+    void lock() {
+        if(!_lock.try_lock()) {
+            _contended.fetch_add(1, std::memory_order_relaxed);
+            _lock.lock();
+        }
+
+        ++_acquisitions; // Only touched while the lock is held
+    }
+
+    bool try_lock() {
+        if(!_lock.try_lock()) {
+            return false;
+        }
+
+        ++_acquisitions;
+        return true;
+    }
+
+    void unlock() { _lock.unlock(); }
+
+    [[nodiscard]] Contention contention() const {
+        return Contention {
+            .acquisitions = _acquisitions,
+            .contended = _contended.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    Lock _lock;
+    std::size_t _acquisitions = 0;
+    std::atomic<std::size_t> _contended { 0 };
+};
+
+// =============================================================================
+class MallocBackend final {
+public:
+    static constexpr bool thread_safe = true;
+
+    static std::string name() { return "malloc"; }
+
+    explicit MallocBackend([[maybe_unused]] std::size_t const heap_bytes) { }
+
+    [[nodiscard]] void * alloc(std::size_t const bytes) {
+        return std::malloc(bytes);
+    }
+
+    void free(void *address) { std::free(address); }
+
+    [[nodiscard]] std::optional<float> fragmentation() const {
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<Contention> contention() const {
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<HeapLatency> heap_latency() const {
+        return std::nullopt;
+    }
+};
+
+// =============================================================================
+// Any BasicHeap instantiation, named after its fit and lock policies
+template<typename HeapType>
+class HeapBackend final {
+public:
+    using fit_policy = typename HeapType::fit_policy;
+    using lock_policy = typename HeapType::lock_policy;
+
+    static constexpr bool thread_safe =
+        !std::is_same_v<lock_policy, btx::memory::NoLock>;
+
+    static std::string name() {
+        std::string name = fit_policy::name;
+        if constexpr(thread_safe) {
+            name += '+';
+            name += lock_policy::name;
+        }
+        return name;
+    }
+
+    explicit HeapBackend(std::size_t const heap_bytes) : _heap(heap_bytes) { }
+
+    [[nodiscard]] void * alloc(std::size_t const bytes) {
+        return _heap.alloc(bytes);
+    }
+
+    void free(void *address) { _heap.free(address); }
+
+    [[nodiscard]] std::optional<float> fragmentation() const {
+        return _heap.calc_fragmentation();
+    }
+
+    [[nodiscard]] std::optional<Contention> contention() const {
+        if constexpr(requires { _heap.lock_state().contention(); }) {
+            return _heap.lock_state().contention();
+        }
+        else {
+            return std::nullopt;
+        }
+    }
+
+    [[nodiscard]] std::optional<HeapLatency> heap_latency() const {
+#ifdef BTX_MEMORY_LATENCY
+        return HeapLatency {
+            .alloc_ns = histogram_percentiles_ns(_heap.alloc_latency()),
+            .free_ns = histogram_percentiles_ns(_heap.free_latency()),
+        };
+#else
+        return std::nullopt;
+#endif
+    }
+
+private:
+    HeapType _heap;
+};
+
+// =============================================================================
+class BuddyBackend final {
+public:
+    static constexpr bool thread_safe = false;
+
+    static std::string name() { return "buddy"; }
+
+    // Rounding every block up to a power of two can cost up to half of it,
+    // so the buddy heap gets twice the room the others do
+    explicit BuddyBackend(std::size_t const heap_bytes) :
+        _heap(2 * heap_bytes)
+    { }
+
+    [[nodiscard]] void * alloc(std::size_t const bytes) {
+        return _heap.alloc(bytes);
+    }
+
+    void free(void *address) { _heap.free(address); }
+
+    [[nodiscard]] std::optional<float> fragmentation() const {
+        return _heap.calc_fragmentation();
+    }
+
+    [[nodiscard]] std::optional<Contention> contention() const {
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<HeapLatency> heap_latency() const {
+        return std::nullopt;
+    }
+
+private:
+    btx::memory::BuddyHeap _heap;
+};
+
+template<typename FitPolicy>
+using SingleThreadedHeap = HeapBackend<
+    btx::memory::BasicHeap<FitPolicy, btx::memory::NoLock,
+                           btx::memory::HeapStats, sizeof(void *)>
+>;
+
+template<typename FitPolicy, typename LockPolicy>
+using LockedHeap = HeapBackend<
+    btx::memory::BasicHeap<FitPolicy, CountingLock<LockPolicy>,
+                           btx::memory::HeapStats, sizeof(void *)>
+>;
+
+} // namespace bench
+
+#endif // BENCH_BACKENDS_HPP
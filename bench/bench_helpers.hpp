@@ -0,0 +1,112 @@
+#ifndef BENCH_HELPERS_HPP
+#define BENCH_HELPERS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "brasstacks/memory/LatencyHistogram.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// =============================================================================
+inline std::uint64_t elapsed_ns(Clock::time_point const start,
+                                Clock::time_point const end)
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count()
+    );
+}
+
+// =============================================================================
+struct Percentiles final {
+    std::uint64_t p50 = 0;
+    std::uint64_t p99 = 0;
+    std::uint64_t p999 = 0;
+    std::uint64_t max = 0;
+};
+
+// Sorts the samples in place
+inline Percentiles calc_percentiles(std::vector<std::uint64_t> &samples) {
+    Percentiles result { };
+    if(samples.empty()) {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto const at = [&samples](double const fraction) {
+        auto const index = static_cast<std::size_t>(
+            fraction * static_cast<double>(samples.size() - 1)
+        );
+        return samples[index];
+    };
+
+    result.p50  = at(0.5);
+    result.p99  = at(0.99);
+    result.p999 = at(0.999);
+    result.max  = samples.back();
+
+    return result;
+}
+
+// =============================================================================
+inline Percentiles
+histogram_percentiles_ns(btx::memory::LatencyHistogram const &histogram) {
+    auto const ticks_per_ns = btx::memory::latency_ticks_per_ns();
+    auto const to_ns = [ticks_per_ns](std::uint64_t const ticks) {
+        return static_cast<std::uint64_t>(
+            static_cast<double>(ticks) / ticks_per_ns
+        );
+    };
+
+    return Percentiles {
+        .p50  = to_ns(histogram.p50()),
+        .p99  = to_ns(histogram.p99()),
+        .p999 = to_ns(histogram.p999()),
+        .max  = to_ns(histogram.max()),
+    };
+}
+
+// =============================================================================
+inline void print_percentiles(char const *label, Percentiles const &p) {
+    std::printf("    %-10s ns  p50 %6llu  p99 %6llu  p99.9 %6llu  max %8llu\n",
+                label,
+                static_cast<unsigned long long>(p.p50),
+                static_cast<unsigned long long>(p.p99),
+                static_cast<unsigned long long>(p.p999),
+                static_cast<unsigned long long>(p.max));
+}
+
+// =============================================================================
+// Peak resident set size of the calling process in KiB, or zero where the
+// platform doesn't tell us
+inline std::uint64_t peak_rss_kib() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage { };
+    if(getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    #if defined(__APPLE__)
+        return static_cast<std::uint64_t>(usage.ru_maxrss) / 1024u;
+    #else
+        return static_cast<std::uint64_t>(usage.ru_maxrss);
+    #endif
+#else
+    return 0;
+#endif
+}
+
+} // namespace bench
+
+#endif // BENCH_HELPERS_HPP
@@ -0,0 +1,183 @@
+// Pits the fit policies against a heap whose low addresses are already riddled
+// with holes too small for anything being asked for: the case where first-fit
+// rescans the same useless blocks on every allocation, and next-fit's rover
+// should let it skip them. Reports throughput, per-op latency percentiles and
+// final fragmentation for each. Frees still walk the address-ordered list to
+// find their place, whatever the fit policy, so watch the alloc percentiles.
+//
+// Usage: brasstacks_memory_fragmented [--holes N] [--ops N] [--backend name]
+
+#include "backends.hpp"
+#include "bench_helpers.hpp"
+
+#include <random>
+#include <string>
+#include <string_view>
+
+using namespace btx::memory;
+
+namespace {
+
+// The holes are smaller than any churn request, so they can never be used
+std::size_t constexpr hole_size = 32;
+std::size_t constexpr fence_size = 16;
+
+std::size_t constexpr min_alloc_size = 64;
+std::size_t constexpr max_alloc_size = 256;
+std::size_t constexpr working_set = 1024;
+
+struct Result final {
+    std::size_t ops = 0;
+    std::uint64_t total_ns = 0;
+    bench::Percentiles alloc_ns { };
+    bench::Percentiles free_ns { };
+    bool has_fragmentation = false;
+    float fragmentation = 0.0f;
+};
+
+// =============================================================================
+template<typename Backend>
+Result run(Backend &backend, std::size_t const holes, std::size_t const ops) {
+    // Leave a hole between every pair of fences, all at the front of the heap
+    std::vector<void *> pinned;
+    std::vector<void *> to_free;
+    pinned.reserve(holes);
+    to_free.reserve(holes);
+
+    for(std::size_t hole = 0; hole < holes; ++hole) {
+        to_free.push_back(backend.alloc(hole_size));
+        pinned.push_back(backend.alloc(fence_size));
+    }
+
+    for(void *address : to_free) {
+        backend.free(address);
+    }
+
+    std::minstd_rand rng(1);
+    std::uniform_int_distribution<std::size_t> size_dist(min_alloc_size,
+                                                         max_alloc_size);
+
+    std::vector<void *> live(working_set, nullptr);
+    std::vector<std::uint64_t> alloc_samples;
+    std::vector<std::uint64_t> free_samples;
+    alloc_samples.reserve(ops);
+    free_samples.reserve(ops);
+
+    auto const start = bench::Clock::now();
+
+    for(std::size_t op = 0; op < ops; ++op) {
+        auto &slot = live[rng() % working_set];
+
+        if(slot != nullptr) {
+            auto const free_start = bench::Clock::now();
+            backend.free(slot);
+            free_samples.push_back(
+                bench::elapsed_ns(free_start, bench::Clock::now())
+            );
+
+            slot = nullptr;
+            continue;
+        }
+
+        auto const bytes = size_dist(rng);
+
+        auto const alloc_start = bench::Clock::now();
+        slot = backend.alloc(bytes);
+        alloc_samples.push_back(
+            bench::elapsed_ns(alloc_start, bench::Clock::now())
+        );
+    }
+
+    Result result { };
+    result.ops = ops;
+    result.total_ns = bench::elapsed_ns(start, bench::Clock::now());
+    result.alloc_ns = bench::calc_percentiles(alloc_samples);
+    result.free_ns = bench::calc_percentiles(free_samples);
+
+    if(auto const fragmentation = backend.fragmentation()) {
+        result.has_fragmentation = true;
+        result.fragmentation = *fragmentation;
+    }
+
+    for(void *address : live) {
+        if(address != nullptr) {
+            backend.free(address);
+        }
+    }
+
+    for(void *address : pinned) {
+        backend.free(address);
+    }
+
+    return result;
+}
+
+// =============================================================================
+template<typename Backend>
+void run_with(std::size_t const heap_bytes, std::size_t const holes,
+              std::size_t const ops, std::string_view const filter)
+{
+    auto const name = Backend::name();
+    if(!filter.empty() && name != filter) {
+        return;
+    }
+
+    Backend backend(heap_bytes);
+    auto const result = run(backend, holes, ops);
+
+    auto const ops_per_sec = static_cast<double>(result.ops) * 1.0e9
+                           / static_cast<double>(result.total_ns);
+
+    std::printf("%-24s %12.0f ops/s", name.c_str(), ops_per_sec);
+    if(result.has_fragmentation) {
+        std::printf("  frag %.4f", static_cast<double>(result.fragmentation));
+    }
+    std::printf("\n");
+
+    bench::print_percentiles("alloc", result.alloc_ns);
+    bench::print_percentiles("free", result.free_ns);
+}
+
+} // namespace
+
+// =============================================================================
+int main(int argc, char **argv) {
+    std::size_t holes = 20'000;
+    std::size_t ops = 1'000'000;
+    std::string_view backend_filter;
+
+    for(int arg = 1; arg < argc; ++arg) {
+        std::string_view const option(argv[arg]);
+        if(option == "--holes" && arg + 1 < argc) {
+            holes = std::stoull(argv[++arg]);
+        }
+        else if(option == "--ops" && arg + 1 < argc) {
+            ops = std::stoull(argv[++arg]);
+        }
+        else if(option == "--backend" && arg + 1 < argc) {
+            backend_filter = argv[++arg];
+        }
+        else {
+            std::fprintf(stderr, "Unknown option '%s'\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    // Room for the holes and fences, the whole working set at its largest,
+    // and as much again for fragmentation
+    auto const heap_bytes =
+        holes * (hole_size + fence_size + 2 * sizeof(BlockHeader))
+        + 2 * working_set * (max_alloc_size + sizeof(BlockHeader));
+
+    std::printf("%zu holes, %zu ops, %zu byte heaps\n\n",
+                holes, ops, heap_bytes);
+
+    run_with<bench::SingleThreadedHeap<FirstFit>>(heap_bytes, holes, ops,
+                                                  backend_filter);
+    run_with<bench::SingleThreadedHeap<NextFit>>(heap_bytes, holes, ops,
+                                                 backend_filter);
+    run_with<bench::SingleThreadedHeap<IndexedFirstFit>>(heap_bytes, holes,
+                                                         ops, backend_filter);
+
+    return 0;
+}
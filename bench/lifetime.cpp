@@ -0,0 +1,209 @@
+// Plays out a run of frames in which most allocations are freed by the end of
+// their frame, but a few survive for many frames, the way loaded assets or
+// spawned entities outlive the scratch work that created them. Each frame's
+// survivors otherwise land wherever the churn happens to be, and every one
+// splits the free space around it. Runs the same workload with and without
+// Lifetime hints, and reports fragmentation at the end of each frame, its
+// average and worst, and the largest allocation that still succeeds once
+// it's all done.
+//
+// Usage: brasstacks_memory_lifetime [--frames N] [--per-frame N]
+//                                   [--survivors N]
+
+#include "bench_helpers.hpp"
+
+#include "brasstacks/memory/Heap.hpp"
+
+#include <random>
+#include <string>
+#include <string_view>
+
+using namespace btx::memory;
+
+namespace {
+
+std::size_t constexpr min_alloc_size = 32;
+std::size_t constexpr max_alloc_size = 1024;
+
+// Survivors live for somewhere between these many frames
+std::size_t constexpr min_lifetime = 50;
+std::size_t constexpr max_lifetime = 2000;
+
+struct Survivor final {
+    void *address;
+    std::size_t expires;
+};
+
+struct Result final {
+    std::size_t ops = 0;
+    std::uint64_t total_ns = 0;
+    double mean_fragmentation = 0.0;
+    float worst_fragmentation = 0.0f;
+    std::size_t largest = 0;
+    std::size_t live_survivors = 0;
+};
+
+// =============================================================================
+std::size_t largest_alloc(Heap &heap) {
+    std::size_t low = 0;
+    std::size_t high = heap.total_size();
+
+    while(low < high) {
+        auto const mid = low + (high - low + 1) / 2;
+        void *address = heap.try_alloc(mid);
+
+        if(address != nullptr) {
+            heap.free(address);
+            low = mid;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+// =============================================================================
+Result run(std::size_t const heap_bytes, std::size_t const frames,
+           std::size_t const per_frame, std::size_t const survivors,
+           bool const hinted)
+{
+    Heap heap(heap_bytes);
+
+    std::minstd_rand rng(1);
+    std::uniform_int_distribution<std::size_t> size_dist(min_alloc_size,
+                                                         max_alloc_size);
+    std::uniform_int_distribution<std::size_t> life_dist(min_lifetime,
+                                                         max_lifetime);
+    std::uniform_int_distribution<std::size_t> pick_dist(0, per_frame - 1);
+
+    std::vector<void *> transient;
+    std::vector<Survivor> surviving;
+    transient.reserve(per_frame);
+
+    auto const lifetime = hinted ? Lifetime::long_lived
+                                 : Lifetime::short_lived;
+
+    Result result { };
+    double fragmentation_sum = 0.0;
+
+    for(std::size_t frame = 0; frame < frames; ++frame) {
+        // Survivors are allocated in among the churn, not all up front
+        std::vector<std::size_t> survivor_slots;
+        for(std::size_t i = 0; i < survivors; ++i) {
+            survivor_slots.push_back(pick_dist(rng));
+        }
+
+        auto const start = bench::Clock::now();
+
+        for(std::size_t i = 0; i < per_frame; ++i) {
+            transient.push_back(heap.alloc(size_dist(rng),
+                                           Lifetime::short_lived));
+            ++result.ops;
+
+            for(auto const slot : survivor_slots) {
+                if(slot == i) {
+                    surviving.push_back(Survivor {
+                        .address = heap.alloc(size_dist(rng), lifetime),
+                        .expires = frame + life_dist(rng),
+                    });
+                    ++result.ops;
+                }
+            }
+        }
+
+        for(void *address : transient) {
+            heap.free(address);
+            ++result.ops;
+        }
+        transient.clear();
+
+        std::erase_if(surviving, [&heap, &result, frame](auto const &entry) {
+            if(entry.expires > frame) {
+                return false;
+            }
+
+            heap.free(entry.address);
+            ++result.ops;
+            return true;
+        });
+
+        result.total_ns += bench::elapsed_ns(start, bench::Clock::now());
+
+        // Measured between frames, and left out of the timing
+        auto const fragmentation = heap.calc_fragmentation();
+        fragmentation_sum += static_cast<double>(fragmentation);
+        result.worst_fragmentation = std::max(result.worst_fragmentation,
+                                              fragmentation);
+    }
+
+    result.mean_fragmentation = fragmentation_sum
+                              / static_cast<double>(frames);
+    result.largest = largest_alloc(heap);
+    result.live_survivors = surviving.size();
+
+    for(auto const &entry : surviving) {
+        heap.free(entry.address);
+    }
+
+    return result;
+}
+
+// =============================================================================
+void report(char const *name, Result const &result) {
+    auto const ops_per_sec = static_cast<double>(result.ops) * 1.0e9
+                           / static_cast<double>(result.total_ns);
+
+    std::printf("%-12s %12.0f ops/s  frag mean %.4f worst %.4f"
+                "  largest %zu bytes  (%zu survivors live)\n",
+                name, ops_per_sec, result.mean_fragmentation,
+                static_cast<double>(result.worst_fragmentation),
+                result.largest, result.live_survivors);
+}
+
+} // namespace
+
+// =============================================================================
+int main(int argc, char **argv) {
+    std::size_t frames = 5'000;
+    std::size_t per_frame = 2'000;
+    std::size_t survivors = 4;
+
+    for(int arg = 1; arg < argc; ++arg) {
+        std::string_view const option(argv[arg]);
+        if(option == "--frames" && arg + 1 < argc) {
+            frames = std::stoull(argv[++arg]);
+        }
+        else if(option == "--per-frame" && arg + 1 < argc) {
+            per_frame = std::stoull(argv[++arg]);
+        }
+        else if(option == "--survivors" && arg + 1 < argc) {
+            survivors = std::stoull(argv[++arg]);
+        }
+        else {
+            std::fprintf(stderr, "Unknown option '%s'\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(per_frame == 0) {
+        std::fprintf(stderr, "--per-frame must be at least 1\n");
+        return 1;
+    }
+
+    // Room for a frame's churn and every survivor that could be alive at
+    // once, at their largest, with as much again to fragment into
+    auto const block_bytes = max_alloc_size + sizeof(BlockHeader);
+    auto const heap_bytes =
+        2 * (per_frame + survivors * max_lifetime) * block_bytes;
+
+    std::printf("%zu frames of %zu allocations, %zu survivors each, "
+                "%zu byte heaps\n\n",
+                frames, per_frame, survivors, heap_bytes);
+
+    report("unhinted", run(heap_bytes, frames, per_frame, survivors, false));
+    report("hinted", run(heap_bytes, frames, per_frame, survivors, true));
+
+    return 0;
+}
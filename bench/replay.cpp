@@ -0,0 +1,356 @@
+// Replays an allocation trace recorded with btx::memory::TraceRecorder against
+// every backend in bench/backends.hpp, reporting throughput, per-op latency
+// percentiles, peak RSS and final fragmentation for each.
+//
+// Usage: brasstacks_memory_replay <trace.bin> [--heap-bytes N] [--backend name]
+
+#include "brasstacks/memory/TraceRecorder.hpp"
+
+#include "backends.hpp"
+#include "bench_helpers.hpp"
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+using namespace btx::memory;
+
+namespace {
+
+// A trace record boiled down to what a replay needs. Allocations are given a
+// slot index up front, so the timed loops don't have to look anything up.
+struct ReplayOp final {
+    std::uint64_t size = 0;
+    std::uint32_t slot = 0;
+    bool is_alloc = true;
+};
+
+struct Replay final {
+    std::vector<ReplayOp> ops;
+    std::size_t slot_count = 0;
+    std::size_t peak_live_bytes = 0;
+};
+
+struct Result final {
+    bool succeeded = false;
+    std::size_t ops = 0;
+    std::uint64_t total_ns = 0;
+    bench::Percentiles alloc_ns { };
+    bench::Percentiles free_ns { };
+    std::uint64_t peak_rss_kib = 0;
+    bool has_fragmentation = false;
+    float fragmentation = 0.0f;
+    bool has_heap_latency = false;
+    bench::HeapLatency heap_latency { };
+};
+
+// =============================================================================
+Replay prepare(std::vector<TraceRecord> records) {
+    // Records from different threads are written out a ring at a time, so put
+    // them back in the order they actually happened
+    std::stable_sort(records.begin(), records.end(),
+        [](TraceRecord const &a, TraceRecord const &b) {
+            return a.timestamp < b.timestamp;
+        }
+    );
+
+    Replay replay;
+    replay.ops.reserve(records.size());
+
+    // Large blocks are keyed by address rather than offset, so they're kept
+    // apart in case the two ever coincide
+    std::unordered_map<std::uint64_t, std::uint32_t> live_slots;
+    std::unordered_map<std::uint64_t, std::uint32_t> live_large_slots;
+    std::vector<std::uint64_t> slot_sizes;
+    std::vector<std::uint32_t> free_slots;
+    std::size_t live_bytes = 0;
+
+    for(auto const &record : records) {
+        auto const large = record.op == TraceOp::alloc_large
+                        || record.op == TraceOp::free_large;
+        auto &slots = large ? live_large_slots : live_slots;
+
+        if(record.op == TraceOp::alloc || record.op == TraceOp::alloc_large) {
+            std::uint32_t slot = 0;
+            if(free_slots.empty()) {
+                slot = static_cast<std::uint32_t>(slot_sizes.size());
+                slot_sizes.push_back(0);
+            }
+            else {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            }
+
+            slot_sizes[slot] = record.size;
+            slots[record.offset] = slot;
+            live_bytes += record.size;
+            replay.peak_live_bytes = std::max(replay.peak_live_bytes,
+                                              live_bytes);
+
+            replay.ops.push_back({ record.size, slot, true });
+        }
+        else {
+            // Frees of blocks allocated before recording began are skipped
+            auto const live = slots.find(record.offset);
+            if(live == slots.end()) {
+                continue;
+            }
+
+            auto const slot = live->second;
+            slots.erase(live);
+            live_bytes -= slot_sizes[slot];
+            free_slots.push_back(slot);
+
+            replay.ops.push_back({ slot_sizes[slot], slot, false });
+        }
+    }
+
+    replay.slot_count = slot_sizes.size();
+    return replay;
+}
+
+// =============================================================================
+template<typename Backend>
+Result run(Replay const &replay, std::size_t const heap_bytes) {
+    Result result { };
+    result.ops = replay.ops.size();
+
+    std::vector<void *> slots(replay.slot_count, nullptr);
+
+    auto const release_outstanding = [&slots](Backend &backend) {
+        for(auto *&address : slots) {
+            if(address != nullptr) {
+                backend.free(address);
+                address = nullptr;
+            }
+        }
+    };
+
+    // First pass: nothing but the allocator calls, for throughput
+    {
+        Backend backend(heap_bytes);
+
+        auto const start = bench::Clock::now();
+        for(auto const &op : replay.ops) {
+            if(op.is_alloc) {
+                slots[op.slot] = backend.alloc(op.size);
+            }
+            else {
+                backend.free(slots[op.slot]);
+                slots[op.slot] = nullptr;
+            }
+        }
+        result.total_ns = bench::elapsed_ns(start, bench::Clock::now());
+
+        release_outstanding(backend);
+    }
+
+    // Second pass: time each call on its own, and touch the memory handed
+    // back so it shows up in the resident set
+    {
+        Backend backend(heap_bytes);
+
+        std::vector<std::uint64_t> alloc_samples;
+        std::vector<std::uint64_t> free_samples;
+        alloc_samples.reserve(replay.ops.size());
+        free_samples.reserve(replay.ops.size());
+
+        for(auto const &op : replay.ops) {
+            if(op.is_alloc) {
+                auto const start = bench::Clock::now();
+                slots[op.slot] = backend.alloc(op.size);
+                alloc_samples.push_back(
+                    bench::elapsed_ns(start, bench::Clock::now())
+                );
+
+                std::memset(slots[op.slot], 0, op.size);
+            }
+            else {
+                auto const start = bench::Clock::now();
+                backend.free(slots[op.slot]);
+                free_samples.push_back(
+                    bench::elapsed_ns(start, bench::Clock::now())
+                );
+
+                slots[op.slot] = nullptr;
+            }
+        }
+
+        result.alloc_ns = bench::calc_percentiles(alloc_samples);
+        result.free_ns = bench::calc_percentiles(free_samples);
+        result.peak_rss_kib = bench::peak_rss_kib();
+
+        auto const fragmentation = backend.fragmentation();
+        result.has_fragmentation = fragmentation.has_value();
+        result.fragmentation = fragmentation.value_or(0.0f);
+
+        auto const heap_latency = backend.heap_latency();
+        result.has_heap_latency = heap_latency.has_value();
+        result.heap_latency = heap_latency.value_or(bench::HeapLatency { });
+
+        release_outstanding(backend);
+    }
+
+    result.succeeded = true;
+    return result;
+}
+
+// =============================================================================
+// Runs the replay in a child process where possible, so that each backend's
+// peak RSS is its own, and so an exhausted heap doesn't take the rest of the
+// comparison down with it
+template<typename Backend>
+Result run_isolated(Replay const &replay, std::size_t const heap_bytes) {
+#if defined(__unix__) || defined(__APPLE__)
+    std::array<int, 2> pipe_fds { };
+    if(::pipe(pipe_fds.data()) != 0) {
+        return run<Backend>(replay, heap_bytes);
+    }
+
+    std::fflush(stdout);
+    auto const pid = ::fork();
+    if(pid == 0) {
+        ::close(pipe_fds[0]);
+        auto const result = run<Backend>(replay, heap_bytes);
+        [[maybe_unused]] auto const written =
+            ::write(pipe_fds[1], &result, sizeof(result));
+        ::close(pipe_fds[1]);
+        std::_Exit(0);
+    }
+
+    ::close(pipe_fds[1]);
+
+    Result result { };
+    if(pid > 0) {
+        if(::read(pipe_fds[0], &result, sizeof(result))
+           != static_cast<ssize_t>(sizeof(result)))
+        {
+            result = Result { };
+        }
+        ::waitpid(pid, nullptr, 0);
+    }
+    ::close(pipe_fds[0]);
+
+    return result;
+#else
+    return run<Backend>(replay, heap_bytes);
+#endif
+}
+
+// =============================================================================
+void print_result(std::string const &name, Result const &result) {
+    if(!result.succeeded) {
+        std::printf("%-24s  replay failed (heap too small?)\n",
+                    name.c_str());
+        return;
+    }
+
+    auto const seconds = static_cast<double>(result.total_ns) * 1.0e-9;
+    auto const ops_per_sec = seconds > 0.0
+                           ? static_cast<double>(result.ops) / seconds
+                           : 0.0;
+
+    std::printf("%-24s  %12.0f ops/s  peak rss %8llu KiB  frag ",
+                name.c_str(), ops_per_sec,
+                static_cast<unsigned long long>(result.peak_rss_kib));
+
+    if(result.has_fragmentation) {
+        std::printf("%.4f\n", static_cast<double>(result.fragmentation));
+    }
+    else {
+        std::printf("n/a\n");
+    }
+
+    bench::print_percentiles("alloc", result.alloc_ns);
+    bench::print_percentiles("free", result.free_ns);
+
+    if(result.has_heap_latency) {
+        bench::print_percentiles("heap alloc", result.heap_latency.alloc_ns);
+        bench::print_percentiles("heap free", result.heap_latency.free_ns);
+    }
+}
+
+// =============================================================================
+template<typename Backend>
+void replay_with(Replay const &replay, std::size_t const heap_bytes,
+                 std::string_view const filter)
+{
+    if(!filter.empty() && filter != Backend::name()) {
+        return;
+    }
+
+    print_result(Backend::name(), run_isolated<Backend>(replay, heap_bytes));
+}
+
+} // namespace
+
+// =============================================================================
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        std::fprintf(stderr,
+            "Usage: %s <trace.bin> [--heap-bytes N] [--backend name]\n",
+            argv[0]);
+        return 1;
+    }
+
+    char const *trace_path = argv[1];
+    std::size_t heap_bytes = 0;
+    std::string_view backend_filter;
+
+    for(int arg = 2; arg < argc; ++arg) {
+        std::string_view const option(argv[arg]);
+        if(option == "--heap-bytes" && arg + 1 < argc) {
+            heap_bytes = std::stoull(argv[++arg]);
+        }
+        else if(option == "--backend" && arg + 1 < argc) {
+            backend_filter = argv[++arg];
+        }
+        else {
+            std::fprintf(stderr, "Unknown option '%s'\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    auto records = TraceRecorder::read(trace_path);
+    if(records.empty()) {
+        std::fprintf(stderr, "No records in '%s'\n", trace_path);
+        return 1;
+    }
+
+    auto const replay = prepare(std::move(records));
+
+    // Without a size from the user, give the heap twice the trace's peak live
+    // bytes plus a header per slot as headroom for fragmentation
+    if(heap_bytes == 0) {
+        heap_bytes = 2 * replay.peak_live_bytes
+                   + replay.slot_count * sizeof(BlockHeader) * 2;
+    }
+
+    std::printf("%zu ops, %zu slots, %zu peak live bytes, %zu byte heaps\n",
+                replay.ops.size(), replay.slot_count,
+                replay.peak_live_bytes, heap_bytes);
+    std::printf("indexed fit search uses %s\n\n",
+                btx::memory::detail::fit_scan_kernel());
+
+    replay_with<bench::MallocBackend>(replay, heap_bytes, backend_filter);
+    replay_with<bench::SingleThreadedHeap<FirstFit>>(replay, heap_bytes,
+                                                     backend_filter);
+    replay_with<bench::SingleThreadedHeap<IndexedFirstFit>>(replay, heap_bytes,
+                                                            backend_filter);
+    replay_with<bench::SingleThreadedHeap<BestFit>>(replay, heap_bytes,
+                                                    backend_filter);
+    replay_with<bench::SingleThreadedHeap<NextFit>>(replay, heap_bytes,
+                                                    backend_filter);
+    replay_with<bench::SingleThreadedHeap<SegregatedFit>>(replay, heap_bytes,
+                                                          backend_filter);
+    replay_with<bench::BuddyBackend>(replay, heap_bytes, backend_filter);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,307 @@
+// Runs thread-private churn, producer/consumer and cross-thread free patterns
+// at increasing thread counts against every thread-safe backend in
+// bench/backends.hpp, reporting ops/s, scaling relative to the smallest thread
+// count, and lock contention where the backend can report it.
+//
+// Usage: brasstacks_memory_scaling [--max-threads N] [--ops N]
+
+#include "backends.hpp"
+#include "bench_helpers.hpp"
+
+#include <array>
+#include <barrier>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace {
+
+std::size_t constexpr min_alloc_size = 1 << 4;
+std::size_t constexpr max_alloc_size = 1 << 8;
+
+// Enough room for everything every pattern keeps live at once, with plenty of
+// slack left over for fragmentation
+std::size_t constexpr heap_bytes_per_thread = 4u << 20;
+
+struct RunResult final {
+    std::size_t ops = 0;
+    std::uint64_t elapsed_ns = 0;
+};
+
+// =============================================================================
+// Runs body(thread_index) on thread_count threads, and times from the moment
+// they're released until the last one finishes
+template<typename Body>
+std::uint64_t run_threads(std::size_t const thread_count, Body &&body) {
+    std::barrier start_line(static_cast<std::ptrdiff_t>(thread_count + 1));
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+
+    for(std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&start_line, &body, t] {
+            start_line.arrive_and_wait();
+            body(t);
+        });
+    }
+
+    // Take the start time before releasing the threads, since on a busy or
+    // small machine they may well finish before this thread runs again
+    auto const start = bench::Clock::now();
+    start_line.arrive_and_wait();
+
+    for(auto &thread : threads) {
+        thread.join();
+    }
+
+    return bench::elapsed_ns(start, bench::Clock::now());
+}
+
+// =============================================================================
+// Each thread allocates and frees its own blocks, replacing random members of a
+// small working set
+template<typename Backend>
+RunResult thread_private_churn(Backend &backend,
+                               std::size_t const thread_count,
+                               std::size_t const ops_per_thread)
+{
+    std::size_t constexpr working_set = 256;
+
+    auto const elapsed = run_threads(thread_count, [&](std::size_t const t) {
+        std::minstd_rand rng(static_cast<std::uint32_t>(t + 1));
+        std::uniform_int_distribution<std::size_t> size_dist(min_alloc_size,
+                                                             max_alloc_size);
+
+        std::array<void *, working_set> live { };
+
+        for(std::size_t op = 0; op < ops_per_thread / 2; ++op) {
+            auto &slot = live[rng() % working_set];
+            if(slot != nullptr) {
+                backend.free(slot);
+            }
+            slot = backend.alloc(size_dist(rng));
+        }
+
+        for(auto *address : live) {
+            if(address != nullptr) {
+                backend.free(address);
+            }
+        }
+    });
+
+    return { thread_count * ops_per_thread, elapsed };
+}
+
+// =============================================================================
+// Threads are paired off: one allocates, and hands each block to its partner
+// through a single-producer, single-consumer ring for freeing
+template<typename Backend>
+RunResult producer_consumer(Backend &backend, std::size_t const thread_count,
+                            std::size_t const ops_per_thread)
+{
+    std::size_t constexpr ring_capacity = 1024;
+
+    struct alignas(64) Ring final {
+        std::array<void *, ring_capacity> blocks { };
+        alignas(64) std::atomic<std::size_t> head { 0 };
+        alignas(64) std::atomic<std::size_t> tail { 0 };
+    };
+
+    auto const pair_count = thread_count / 2;
+    std::vector<Ring> rings(pair_count);
+
+    // Each block is one alloc on the producer and one free on the consumer,
+    // so both threads in a pair do ops_per_thread ops like the other patterns
+    auto const blocks_per_pair = ops_per_thread;
+
+    auto const elapsed = run_threads(pair_count * 2, [&](std::size_t const t) {
+        auto &ring = rings[t / 2];
+
+        if(t % 2 == 0) {
+            std::minstd_rand rng(static_cast<std::uint32_t>(t + 1));
+            std::uniform_int_distribution<std::size_t> size_dist(
+                min_alloc_size, max_alloc_size
+            );
+
+            for(std::size_t i = 0; i < blocks_per_pair; ++i) {
+                auto const head = ring.head.load(std::memory_order_relaxed);
+                while(head - ring.tail.load(std::memory_order_acquire)
+                      == ring_capacity)
+                {
+                    std::this_thread::yield();
+                }
+
+                ring.blocks[head % ring_capacity] =
+                    backend.alloc(size_dist(rng));
+                ring.head.store(head + 1, std::memory_order_release);
+            }
+        }
+        else {
+            for(std::size_t i = 0; i < blocks_per_pair; ++i) {
+                auto const tail = ring.tail.load(std::memory_order_relaxed);
+                while(ring.head.load(std::memory_order_acquire) == tail) {
+                    std::this_thread::yield();
+                }
+
+                backend.free(ring.blocks[tail % ring_capacity]);
+                ring.tail.store(tail + 1, std::memory_order_release);
+            }
+        }
+    });
+
+    return { pair_count * 2 * blocks_per_pair, elapsed };
+}
+
+// =============================================================================
+// Every thread allocates a batch, then frees the batch its neighbour just
+// allocated, so nearly every free lands on a block from another thread
+template<typename Backend>
+RunResult cross_thread_free(Backend &backend, std::size_t const thread_count,
+                            std::size_t const ops_per_thread)
+{
+    std::size_t constexpr batch_size = 256;
+    auto const rounds = std::max<std::size_t>(ops_per_thread
+                                              / (2 * batch_size), 1);
+
+    std::vector<std::array<void *, batch_size>> outboxes(thread_count);
+    std::barrier round_barrier(static_cast<std::ptrdiff_t>(thread_count));
+
+    auto const elapsed = run_threads(thread_count, [&](std::size_t const t) {
+        std::minstd_rand rng(static_cast<std::uint32_t>(t + 1));
+        std::uniform_int_distribution<std::size_t> size_dist(min_alloc_size,
+                                                             max_alloc_size);
+
+        auto &outbox = outboxes[t];
+        auto &inbox = outboxes[(t + 1) % thread_count];
+
+        for(std::size_t round = 0; round < rounds; ++round) {
+            for(auto *&block : outbox) {
+                block = backend.alloc(size_dist(rng));
+            }
+
+            round_barrier.arrive_and_wait();
+
+            for(auto *block : inbox) {
+                backend.free(block);
+            }
+
+            round_barrier.arrive_and_wait();
+        }
+    });
+
+    return { thread_count * rounds * batch_size * 2, elapsed };
+}
+
+// =============================================================================
+template<typename Backend, typename Pattern>
+void sweep(char const *pattern_name, Pattern &&pattern,
+           std::size_t const min_threads, std::size_t const max_threads,
+           std::size_t const ops_per_thread)
+{
+    std::printf("%s / %s\n", pattern_name, Backend::name().c_str());
+    std::printf("    %7s  %14s  %8s  %10s\n",
+                "threads", "ops/s", "scaling", "contended");
+
+    // Powers of two from the minimum, always finishing on the maximum
+    std::vector<std::size_t> thread_counts;
+    for(auto threads = min_threads; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    double baseline = 0.0;
+
+    for(auto const threads : thread_counts) {
+        Backend backend(heap_bytes_per_thread * threads);
+
+        auto const result = pattern(backend, threads, ops_per_thread);
+
+        auto const seconds = static_cast<double>(result.elapsed_ns) * 1.0e-9;
+        auto const ops_per_sec = static_cast<double>(result.ops) / seconds;
+
+        if(baseline == 0.0) {
+            baseline = ops_per_sec;
+        }
+
+        std::printf("    %7zu  %14.0f  %7.2fx  ",
+                    threads, ops_per_sec, ops_per_sec / baseline);
+
+        if(auto const contention = backend.contention();
+           contention.has_value() && contention->acquisitions > 0)
+        {
+            std::printf("%9.2f%%\n",
+                100.0 * static_cast<double>(contention->contended)
+                      / static_cast<double>(contention->acquisitions));
+        }
+        else {
+            std::printf("%10s\n", "n/a");
+        }
+
+        if(auto const latency = backend.heap_latency(); latency.has_value()) {
+            bench::print_percentiles("heap alloc", latency->alloc_ns);
+            bench::print_percentiles("heap free", latency->free_ns);
+        }
+    }
+
+    std::printf("\n");
+}
+
+// =============================================================================
+template<typename Backend>
+void sweep_all(std::size_t const max_threads, std::size_t const ops_per_thread)
+{
+    static_assert(Backend::thread_safe);
+
+    sweep<Backend>("thread-private churn",
+                   thread_private_churn<Backend>,
+                   1, max_threads, ops_per_thread);
+
+    // Producer/consumer needs at least one pair
+    sweep<Backend>("producer/consumer",
+                   producer_consumer<Backend>,
+                   2, std::max<std::size_t>(max_threads, 2), ops_per_thread);
+
+    sweep<Backend>("cross-thread free",
+                   cross_thread_free<Backend>,
+                   1, max_threads, ops_per_thread);
+}
+
+} // namespace
+
+// =============================================================================
+int main(int argc, char **argv) {
+    std::size_t max_threads =
+        std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    std::size_t ops_per_thread = 1'000'000;
+
+    for(int arg = 1; arg < argc; ++arg) {
+        std::string_view const option(argv[arg]);
+        if(option == "--max-threads" && arg + 1 < argc) {
+            max_threads = std::max<std::size_t>(std::stoull(argv[++arg]), 1);
+        }
+        else if(option == "--ops" && arg + 1 < argc) {
+            ops_per_thread = std::stoull(argv[++arg]);
+        }
+        else {
+            std::fprintf(stderr,
+                "Usage: %s [--max-threads N] [--ops N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("%zu ops per thread, up to %zu threads\n\n",
+                ops_per_thread, max_threads);
+
+    using namespace btx::memory;
+
+    sweep_all<bench::MallocBackend>(max_threads, ops_per_thread);
+    sweep_all<bench::LockedHeap<FirstFit, MutexLock>>(max_threads,
+                                                       ops_per_thread);
+    sweep_all<bench::LockedHeap<FirstFit, SpinLock>>(max_threads,
+                                                      ops_per_thread);
+    sweep_all<bench::LockedHeap<SegregatedFit, SpinLock>>(max_threads,
+                                                           ops_per_thread);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#ifndef BRASSTACKS_MEMORY_ALLOCATIONSAMPLER_HPP
+#define BRASSTACKS_MEMORY_ALLOCATIONSAMPLER_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace btx::memory {
+
+// Everything sampled from one call stack
+struct SampledSite final {
+    std::vector<void *> frames; // Return addresses, innermost first
+
+    std::size_t live_samples = 0; // Sampled allocations not yet freed
+    std::size_t live_bytes = 0;   // and the bytes they asked for
+
+    std::size_t total_samples = 0; // Every allocation sampled from here,
+    std::size_t total_bytes = 0;   // freed or not
+
+    // What the live samples stand for, scaled up by the chance of each being
+    // picked: an estimate of everything this stack has live
+    double estimated_count = 0.0;
+    double estimated_bytes = 0.0;
+};
+
+// Picks allocations at random, on average one for every interval bytes
+// requested, and remembers the call stack each was made from until it's
+// freed. The gaps between samples are drawn from an exponential distribution,
+// so every byte allocated is equally likely to be the one sampled, and large
+// allocations are picked more often than small ones in proportion.
+//
+// A Heap built with BTX_MEMORY_SAMPLING calls should_sample() on every
+// allocation, which is a thread-local subtraction and a compare. Only the
+// allocations it picks pay for capturing a stack and taking a lock.
+class AllocationSampler final {
+public:
+    static std::size_t constexpr default_interval = 512 * 1024;
+    static std::size_t constexpr max_frames = 32;
+
+    // Whether an allocation of this many bytes should be sampled, in which
+    // case record() must follow with its address
+    [[nodiscard]] bool should_sample(std::size_t const bytes) {
+        if(_countdown.sampler == _id && _countdown.remaining > bytes) {
+            _countdown.remaining -= bytes;
+            return false;
+        }
+
+        return _countdown_expired(bytes);
+    }
+
+    // Capture the calling stack and count the allocation against it
+    void record(void const *address, std::size_t const bytes);
+
+    // The allocation at address has been freed. Addresses that were never
+    // sampled are ignored.
+    void forget(void const *address);
+
+    // Drop every live sample, keeping each site's totals
+    void clear();
+
+    // Drop the live samples from begin up to end, keeping each site's totals.
+    // A heap that's reset uses this to leave other heaps' samples alone.
+    void forget_range(void const *begin, void const *end);
+
+    // Every site with live samples, heaviest estimated bytes first
+    [[nodiscard]] std::vector<SampledSite> sites() const;
+
+    [[nodiscard]] std::size_t live_samples() const;
+    [[nodiscard]] auto interval() const { return _interval; }
+
+    // Live samples as folded stacks, one line per site, outermost frame
+    // first, followed by the site's estimated live bytes. Flame graph tools
+    // take this as it is.
+    void write_folded(std::FILE *file) const;
+
+    // Live samples as a legacy pprof heap profile, which pprof scales up by
+    // the sampling interval itself. Where the OS offers it, the process's
+    // mappings are appended so pprof can symbolize the addresses.
+    void write_pprof(std::FILE *file) const;
+
+    // The same, written to a new file. Returns false if it can't be written.
+    [[nodiscard]] bool dump_folded(char const *path) const;
+    [[nodiscard]] bool dump_pprof(char const *path) const;
+
+    AllocationSampler() = delete;
+    ~AllocationSampler() = default;
+
+    explicit AllocationSampler(std::size_t const interval);
+
+    AllocationSampler(AllocationSampler &&other) = delete;
+    AllocationSampler(AllocationSampler const &) = delete;
+
+    AllocationSampler & operator=(AllocationSampler &&other) = delete;
+    AllocationSampler & operator=(AllocationSampler const &) = delete;
+
+private:
+    using Stack = std::array<void *, max_frames>;
+
+    struct StackHash final {
+        std::size_t operator()(Stack const &stack) const;
+    };
+
+    struct Site final {
+        std::size_t depth = 0;
+        std::size_t live_samples = 0;
+        std::size_t live_bytes = 0;
+        std::size_t total_samples = 0;
+        std::size_t total_bytes = 0;
+        double estimated_count = 0.0;
+        double estimated_bytes = 0.0;
+    };
+
+    struct Sample final {
+        Site *site;
+        std::size_t bytes;
+        double count; // How many allocations this sample stands for
+    };
+
+    using LiveMap = std::unordered_map<void const *, Sample>;
+
+    // Bytes left before this thread's next sample, for whichever sampler
+    // last drew it. Zeroed for each new thread, and no sampler has id zero.
+    struct Countdown final {
+        std::uint64_t sampler;
+        std::size_t remaining;
+    };
+
+    std::uint64_t const _id; // Unique per instance, so threads can tell a new
+                             // sampler apart from a destroyed one
+    std::size_t const _interval;
+
+    mutable std::mutex _mutex;
+    std::unordered_map<Stack, Site, StackHash> _sites;
+    LiveMap _live;
+
+    static inline thread_local Countdown _countdown;
+
+    // Takes a sample out of its site and _live. Expects _mutex to be held.
+    LiveMap::iterator _forget(LiveMap::iterator const sample);
+
+    [[nodiscard]] bool _countdown_expired(std::size_t const bytes);
+    [[nodiscard]] std::size_t _next_gap() const;
+
+    static void _write_frame(std::FILE *file, void *frame);
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_ALLOCATIONSAMPLER_HPP
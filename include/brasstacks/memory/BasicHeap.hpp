@@ -0,0 +1,2031 @@
+#ifndef BRASSTACKS_MEMORY_BASICHEAP_HPP
+#define BRASSTACKS_MEMORY_BASICHEAP_HPP
+
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/FreeList.hpp"
+#include "brasstacks/memory/HeapPolicies.hpp"
+#include "brasstacks/memory/HeapSnapshot.hpp"
+#include "brasstacks/memory/LargeBlockList.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#ifdef BTX_MEMORY_LATENCY
+    #include "brasstacks/memory/LatencyHistogram.hpp"
+#endif
+
+#ifdef BTX_MEMORY_TRACE
+    #include "brasstacks/memory/TraceRecorder.hpp"
+#endif
+
+#ifdef BTX_MEMORY_SAMPLING
+    #include "brasstacks/memory/AllocationSampler.hpp"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+
+// This allocator is designed for use on systems where pointers are powers of
+// two in size.
+#include <bit>
+static_assert(std::has_single_bit(sizeof(void *)));
+
+namespace btx::memory {
+
+namespace detail {
+
+// Reporting lives in Heap.cpp, which keeps the library's logging dependency
+// out of this header
+void report_heap_created(std::size_t const bytes);
+void report_storage_failure(std::size_t const bytes);
+void report_storage_too_small(std::size_t const bytes);
+void report_invalid_request(std::size_t const bytes);
+[[noreturn]] void report_alloc_failure(std::size_t const bytes);
+[[noreturn]] void report_invalid_free();
+[[noreturn]] void report_live_children();
+[[noreturn]] void report_address_unavailable(void const *address);
+
+} // namespace detail
+
+// Selects BasicHeap's lazily committed constructor:
+//
+//     Heap heap(16ull << 30, lazy_commit);
+struct LazyCommit final { };
+inline constexpr LazyCommit lazy_commit { };
+
+// Selects BasicHeap's fixed address constructor:
+//
+//     Heap heap(1ull << 30, AtAddress { reinterpret_cast<void *>(base) });
+struct AtAddress final {
+    void *address;
+};
+
+// How long an allocation is expected to live, for BasicHeap's hinted alloc()
+// and try_alloc()
+enum class Lifetime : std::uint8_t {
+    short_lived,
+    long_lived,
+};
+
+// Called once a heap's usage rises past one of its watermarks, with the
+// context it was registered with and the heap's current_used()
+using PressureCallback = void (*)(void *context, std::size_t const used);
+
+// Called when an alloc() is about to fail, with the context it was registered
+// with and the bytes requested. Returning true has the heap try again, so it
+// should only do so after freeing something.
+using ExhaustionHandler = bool (*)(void *context, std::size_t const req_bytes);
+
+// An address-ordered, coalescing free list heap. The search strategy is left
+// to FitPolicy, and it, locking, stats tracking and payload alignment are all
+// chosen at compile time; the ones that are switched off compile away
+// entirely. See HeapPolicies.hpp for what's available, and Heap.hpp for the
+// default.
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+class BasicHeap final {
+public:
+    using fit_policy   = FitPolicy;
+    using lock_policy  = LockPolicy;
+    using stats_policy = StatsPolicy;
+
+    static std::size_t constexpr alignment = Alignment;
+
+    static_assert(std::has_single_bit(Alignment));
+    static_assert(Alignment >= sizeof(void *));
+    static_assert(Alignment <= alignof(BlockHeader),
+                  "Payloads follow headers directly, so they can't be "
+                  "aligned more strictly than BlockHeader itself");
+
+    // Aborts if no free block is large enough, once any exhaustion handler has
+    // given up
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+
+    // Returns nullptr if no free block is large enough, leaving the heap
+    // untouched so the caller can fall back to something else
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes);
+
+    // Short-lived allocations are placed as usual, working up from the start
+    // of the heap. Long-lived ones are carved from the far end of the top
+    // chunk instead, so a survivor doesn't end up in the middle of per-frame
+    // churn, keeping the space around it from coalescing. Holes freed among
+    // long-lived blocks are refilled by later ones, and only given to
+    // short-lived requests once the top chunk can't serve them. Either kind
+    // falls back to the rest of the free list when it must.
+    [[nodiscard]] void * alloc(std::size_t const req_bytes,
+                               Lifetime const lifetime);
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes,
+                                   Lifetime const lifetime);
+
+    void free(void *address);
+
+    // Grows an allocation, moving it if need be; shrinking leaves it where it
+    // is. Large blocks are remapped rather than copied where the OS allows
+    // it. Aborts on failure.
+    [[nodiscard]] void * realloc(void *address, std::size_t const req_bytes);
+
+    // Free everything at once, without visiting any of it: the whole heap
+    // goes back to a single top chunk and any large blocks are unmapped.
+    // Current stats drop to what a new heap would show, but peaks are kept.
+    // Every pointer the heap has handed out is invalid afterward.
+    //
+    // With trim, the pages behind the freed space are handed back to the OS
+    // too, so a heap that held a big level stops holding the memory. That
+    // costs page faults as the space is used again.
+    void reset(bool const trim = false);
+
+    // A heap of the same kind, managing one block of this one, for a
+    // subsystem to allocate from in its own corner of memory. Destroying the
+    // child frees that block back here in one go, whatever was left in it.
+    // Children must be destroyed before their parent, and before it's
+    // reset(); either aborts while one is still alive. Aborts if this heap
+    // can't supply the block.
+    [[nodiscard]] std::unique_ptr<BasicHeap>
+    create_child(std::size_t const req_bytes);
+
+    // Whether address falls within this heap's storage or is one of its
+    // large blocks
+    [[nodiscard]] bool owns(void const *address) const;
+
+    // Requests larger than this skip the free list and get their own pages
+    // from the OS, which go back as soon as they're freed. Large blocks count
+    // toward the heap's stats, but not its total_size(). Zero, the default,
+    // turns this off.
+    void set_large_threshold(std::size_t const bytes) {
+        std::scoped_lock const guard(_lock);
+        _large_threshold = bytes;
+    }
+
+    [[nodiscard]] auto large_threshold() const { return _large_threshold; }
+
+    // Call back once current_used() reaches fraction of total_size(), so a
+    // cache can drop entries before the heap runs out. Each watermark fires
+    // once on the way up, and again only after usage has fallen back below
+    // it. One that's already been passed fires on the next allocation.
+    // Large blocks count toward usage, so fractions above one make sense for
+    // heaps that use them. Callbacks run on the allocating thread after the
+    // heap's lock is released, so they're free to use the heap. Returns false
+    // if max_watermarks are already registered, or if fraction is negative or
+    // not finite.
+    static std::size_t constexpr max_watermarks = 8;
+    static_assert(max_watermarks <= 32);
+
+    bool add_watermark(float const fraction, PressureCallback callback,
+                       void *context) requires StatsPolicy::enabled;
+
+    // Returns false if no watermark was registered with this callback and
+    // context
+    bool remove_watermark(PressureCallback callback, void *context)
+        requires StatsPolicy::enabled;
+
+    // Give the program one last chance to make room before alloc() or
+    // realloc() fails, as often as the handler asks for another try. Passing
+    // nullptr removes it. try_alloc() leaves failure to its caller, so never
+    // calls it.
+    void set_exhaustion_handler(ExhaustionHandler handler, void *context) {
+        std::scoped_lock const guard(_lock);
+        _exhaustion_handler = handler;
+        _exhaustion_context = context;
+    }
+
+    // Write the heap's storage, free list and stats to a file that the
+    // FromSnapshot constructor can map straight back in. Large blocks live
+    // outside the heap's storage, so a heap with any in use can't be saved.
+    [[nodiscard]] bool save(char const *path) const;
+
+    // Whether a restored heap had to be mapped somewhere other than where it
+    // was saved. If so, the free list has been fixed up to match, but any
+    // pointers the program stored inside the heap now point at the old
+    // address. Only heaps built at an AtAddress, or restored from a snapshot
+    // of one, are sure to land in the same place; otherwise only offsets
+    // survive a restore, along with the free list itself.
+    [[nodiscard]] auto relocated() const { return _relocated; }
+
+    [[nodiscard]] auto total_size() const { return _total_size; }
+
+    // How much of the heap is backed by memory the program can touch. Only
+    // less than total_size() for a lazily committed heap.
+    [[nodiscard]] std::size_t committed_bytes() const {
+        std::scoped_lock const guard(_lock);
+
+        auto const *heap_end = _raw_heap + _total_size;
+        auto const *low_end = std::min<std::uint8_t const *>(_committed_end,
+                                                             heap_end);
+        auto const *high_start = _committed_high();
+
+        return static_cast<std::size_t>(low_end - _raw_heap)
+             + static_cast<std::size_t>(heap_end - high_start);
+    }
+
+    [[nodiscard]] auto current_used() const requires StatsPolicy::enabled {
+        return _stats.current_used();
+    }
+
+    [[nodiscard]] auto current_allocs() const requires StatsPolicy::enabled {
+        return _stats.current_allocs();
+    }
+
+    [[nodiscard]] auto peak_used() const requires StatsPolicy::enabled {
+        return _stats.peak_used();
+    }
+
+    [[nodiscard]] auto peak_allocs() const requires StatsPolicy::enabled {
+        return _stats.peak_allocs();
+    }
+
+    // Like current_used() and current_allocs(), but counting what's in use
+    // inside each live child heap, and its children, rather than the one
+    // block each child occupies here
+    [[nodiscard]] std::size_t subtree_used() const
+        requires StatsPolicy::enabled;
+    [[nodiscard]] std::size_t subtree_allocs() const
+        requires StatsPolicy::enabled;
+
+    [[nodiscard]] std::size_t child_count() const;
+
+    [[nodiscard]] float calc_fragmentation() const;
+
+    // For inspecting policies that keep state, like NextFit's rover
+    [[nodiscard]] auto const & fit_state()  const { return _fit;  }
+    [[nodiscard]] auto const & lock_state() const { return _lock; }
+
+#ifdef BTX_MEMORY_LATENCY
+    // Per-call latency of alloc() and free(), in latency_ticks(). Only
+    // available when the library is built with BTX_MEMORY_LATENCY.
+    [[nodiscard]] auto const & alloc_latency() const { return _alloc_latency; }
+    [[nodiscard]] auto const & free_latency()  const { return _free_latency;  }
+
+    void reset_latency() {
+        _alloc_latency.reset();
+        _free_latency.reset();
+    }
+#endif
+
+#ifdef BTX_MEMORY_TRACE
+    // Every alloc() and free() will be appended to the recorder until it's
+    // detached by passing nullptr. Only available when the library is built
+    // with BTX_MEMORY_TRACE, so untraced builds pay nothing for it.
+    void set_trace_recorder(TraceRecorder *recorder) {
+        _trace_recorder = recorder;
+    }
+#endif
+
+#ifdef BTX_MEMORY_SAMPLING
+    // Allocations will be sampled and attributed to their call stacks until
+    // the sampler is detached by passing nullptr. Blocks sampled before then
+    // aren't reported to it when they're freed afterward. A sampler can be
+    // shared between heaps, and reset() only forgets this heap's samples.
+    // Only available when the library is built with BTX_MEMORY_SAMPLING.
+    void set_sampler(AllocationSampler *sampler) {
+        std::scoped_lock const guard(_lock);
+        _sampler = sampler;
+    }
+#endif
+
+    BasicHeap() = delete;
+    ~BasicHeap();
+
+    explicit BasicHeap(std::size_t const req_bytes);
+
+    // Only reserve address space up front, then commit it a chunk at a time
+    // as the top chunk is carved up, so even a heap of many gigabytes is
+    // constructed in microseconds and costs nothing until it's used. Memory
+    // is never decommitted once it has been used.
+    BasicHeap(std::size_t const req_bytes, LazyCommit const);
+
+    // A lazily committed heap reserved at exactly at.address, so a snapshot
+    // of it can be restored to the same place with every pointer the program
+    // stored in it still good. The address must be aligned to the OS's
+    // allocation granularity, and the heap's storage starts a SnapshotHeader's
+    // worth past it, which is what lets a snapshot's file map there whole.
+    // Aborts if anything is already mapped in the range.
+    BasicHeap(std::size_t const req_bytes, AtAddress const at);
+
+    // Manage memory that belongs to someone else: a static array, a block
+    // from another heap, a file mapping, and so on. The heap never frees it,
+    // so it must outlive the heap. Whatever's needed to align the start, and
+    // any remainder past the last whole header's worth at the end, goes
+    // unused. A span too small to hold a single block makes for a heap in
+    // which every allocation fails.
+    explicit BasicHeap(std::span<std::byte> const memory);
+
+    // Map a snapshot written by save() back in, copy-on-write, so nothing
+    // done with the heap afterward reaches the file. It lands where it was
+    // saved if that's free, and otherwise relocates unless the snapshot asks
+    // for its saved address. Aborts if the snapshot can't be used, including
+    // if it was saved by a heap with a different alignment or stats policy,
+    // or is corrupt. The fit policy is free to differ.
+    explicit BasicHeap(FromSnapshot const snapshot);
+
+    BasicHeap(BasicHeap &&other) = delete;
+    BasicHeap(BasicHeap const &) = delete;
+
+    BasicHeap & operator=(BasicHeap &&other) = delete;
+    BasicHeap & operator=(BasicHeap const &) = delete;
+
+private:
+    std::uint8_t *_storage;  // From std::malloc(), a mapped snapshot, or
+                             // nullptr if the memory was provided
+    std::uint8_t *_raw_heap; // _storage, aligned for the first payload
+    BlockHeader  *_free_head;
+    BlockHeader  *_free_tail = nullptr; // Where long-lived searches start
+
+    // The top chunk: space between the short-lived allocations growing up
+    // from the start of the heap and the long-lived ones growing down from
+    // its end, that's never been handed out or that's been freed back into
+    // it. It has a header like any other block, so the heap can still be
+    // walked end to end, but it isn't on the free list. Allocating from
+    // either end of it is a pointer bump. It's empty when _top == _top_end.
+    std::uint8_t *_top = nullptr;
+    std::uint8_t *_top_end = nullptr;
+
+    std::size_t const _total_size;
+
+    [[no_unique_address]] FitPolicy _fit;
+    [[no_unique_address]] mutable LockPolicy _lock;
+    [[no_unique_address]] StatsPolicy _stats;
+
+    LargeBlockList _large;
+    std::size_t _large_threshold = 0;
+
+    // Non-zero when _storage is a mapped snapshot rather than from malloc()
+    std::size_t _mapped_bytes = 0;
+
+    // Non-zero when _storage is reserved address space, of which everything
+    // before _committed_end can be touched. Other heaps are committed from
+    // end to end.
+    std::size_t _reserved_bytes = 0;
+    std::uint8_t *_committed_end = nullptr;
+
+    // Long-lived blocks commit a reserved heap from its far end, down to
+    // here. Unused by other heaps.
+    std::uint8_t *_committed_start = nullptr;
+    bool _relocated = false;
+
+    // Set for heaps from create_child(), which live in _parent_block and
+    // count as _parent_bytes of their parent's current_used()
+    BasicHeap *_parent = nullptr;
+    void *_parent_block = nullptr;
+    std::size_t _parent_bytes = 0;
+
+    // Live children, linked through their sibling pointers
+    BasicHeap *_first_child = nullptr;
+    BasicHeap *_next_sibling = nullptr;
+    BasicHeap *_prev_sibling = nullptr;
+
+    struct Watermark final {
+        std::size_t bytes;
+        PressureCallback callback;
+        void *context;
+        bool raised;
+    };
+
+    struct Watermarks final {
+        std::array<Watermark, max_watermarks> entries { };
+        std::size_t count = 0;
+
+        // Usage at which the lowest watermark not yet raised fires, and below
+        // which the highest raised one is lowered again. Keeping these up to
+        // date leaves a single comparison on each alloc() and free().
+        std::size_t next_raise = std::numeric_limits<std::size_t>::max();
+        std::size_t next_lower = 0;
+    };
+
+    struct NoWatermarks final { };
+
+    // Copies of the watermarks an allocation has just passed, taken while
+    // _lock is held. Once it's released, remove_watermark() is free to
+    // reshuffle the table, so the callbacks are made from these instead.
+    struct PendingPressure final {
+        std::array<Watermark, max_watermarks> entries;
+        std::size_t count = 0;
+        std::size_t used = 0;
+    };
+
+    // Watermarks are measured against the stats, so a heap without them has
+    // nothing to keep here
+    [[no_unique_address]]
+    std::conditional_t<StatsPolicy::enabled, Watermarks, NoWatermarks>
+        _watermarks;
+
+    ExhaustionHandler _exhaustion_handler = nullptr;
+    void *_exhaustion_context = nullptr;
+
+#ifdef BTX_MEMORY_TRACE
+    TraceRecorder *_trace_recorder = nullptr;
+#endif
+
+#ifdef BTX_MEMORY_SAMPLING
+    AllocationSampler *_sampler = nullptr;
+
+    // Only picks the block, under _lock. Capturing its stack is slow, so
+    // try_alloc() calls record() once the lock has been released.
+    void _sample(BlockHeader *header, std::size_t const req_bytes) {
+        if(_sampler != nullptr && _sampler->should_sample(req_bytes)) {
+            header->flags |= BlockHeader::flag_sampled;
+        }
+    }
+
+    void _unsample(BlockHeader *header) {
+        if((header->flags & BlockHeader::flag_sampled) != 0) {
+            header->flags &= ~BlockHeader::flag_sampled;
+
+            if(_sampler != nullptr) {
+                _sampler->forget(BlockHeader::payload(header));
+            }
+        }
+    }
+#endif
+
+#ifdef BTX_MEMORY_LATENCY
+    LatencyHistogram _alloc_latency;
+    LatencyHistogram _free_latency;
+#endif
+
+    static std::size_t constexpr _min_alloc_bytes = sizeof(BlockHeader);
+
+    // Lazily committed heaps grow their usable space by at least this much,
+    // which is a whole number of pages on every platform we support
+    static std::size_t constexpr _commit_chunk_bytes = 1u << 20;
+
+    BasicHeap(FromSnapshot const snapshot, SnapshotHeader const &header);
+    BasicHeap(BasicHeap &parent, void *block, std::size_t const bytes);
+
+    void _init_free_list();
+
+    [[nodiscard]] static std::uint8_t * _align_up(std::uint8_t *address);
+    [[nodiscard]] static std::size_t _usable_bytes(
+        std::span<std::byte> const memory
+    );
+
+    static std::size_t _round_bytes(std::size_t const req_bytes,
+                                    std::size_t const multiple);
+
+    void _insert_free_block(BlockHeader *header);
+    void _split_free_block(BlockHeader *header, std::size_t const bytes);
+    void _use_whole_free_block(BlockHeader *header);
+    BlockHeader * _coalesce(BlockHeader *header);
+
+    [[nodiscard]] bool _commit_to(std::uint8_t const *end);
+    [[nodiscard]] bool _commit_from(std::uint8_t const *start);
+    [[nodiscard]] std::uint8_t const * _committed_high() const;
+
+    [[nodiscard]] BlockHeader * _take_from_list(std::size_t const bytes);
+    [[nodiscard]] BlockHeader * _take_from_top(std::size_t const bytes);
+    [[nodiscard]] BlockHeader * _take_from_top_end(std::size_t const bytes);
+    [[nodiscard]] BlockHeader * _take_from_list_end(std::size_t const bytes);
+    void _take_free_block(BlockHeader *header, std::size_t const bytes);
+    void _return_to_top(BlockHeader *header);
+    void _write_top_header();
+
+    [[nodiscard]] void * _alloc(std::size_t const req_bytes,
+                                Lifetime const lifetime);
+    [[nodiscard]] void * _realloc_large(void *address,
+                                        std::size_t const req_bytes);
+
+    // The watermark bookkeeping expects _lock to be held. _raise_watermarks()
+    // copies any watermarks that have just been passed into pending, for
+    // _notify_pressure() to call back once it's been released.
+    void _raise_watermarks(PendingPressure &pending);
+    void _lower_watermarks();
+    void _update_watermark_bounds() requires StatsPolicy::enabled;
+
+    void _notify_pressure(PendingPressure &pending);
+    [[nodiscard]] bool _handle_exhaustion(std::size_t const req_bytes);
+};
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::size_t BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+subtree_used() const requires StatsPolicy::enabled {
+    std::scoped_lock const guard(_lock);
+
+    auto used = _stats.current_used();
+    for(auto const *child = _first_child; child != nullptr;
+        child = child->_next_sibling)
+    {
+        used = used - child->_parent_bytes + child->subtree_used();
+    }
+
+    return used;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::size_t BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+subtree_allocs() const requires StatsPolicy::enabled {
+    std::scoped_lock const guard(_lock);
+
+    auto allocs = _stats.current_allocs();
+    for(auto const *child = _first_child; child != nullptr;
+        child = child->_next_sibling)
+    {
+        allocs = allocs - 1 + child->subtree_allocs();
+    }
+
+    return allocs;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::size_t BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+child_count() const {
+    std::scoped_lock const guard(_lock);
+
+    std::size_t count = 0;
+    for(auto const *child = _first_child; child != nullptr;
+        child = child->_next_sibling)
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+float BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+calc_fragmentation() const {
+    std::scoped_lock const guard(_lock);
+
+    std::size_t total_free = 0;
+    std::size_t largest_free_block_size = 0;
+    BlockHeader *current_header = _free_head;
+
+    while(current_header != nullptr) {
+        if(current_header->size > largest_free_block_size) {
+            largest_free_block_size = current_header->size;
+        }
+        total_free += current_header->size;
+        current_header = current_header->next;
+    }
+
+    // The top chunk is free space too, just not on the list
+    if(_top != _top_end) {
+        auto const top_size = static_cast<std::size_t>(_top_end - _top)
+                            - sizeof(BlockHeader);
+
+        if(top_size > largest_free_block_size) {
+            largest_free_block_size = top_size;
+        }
+        total_free += top_size;
+    }
+
+    if(total_free == 0) {
+        return 0.0f;
+    }
+
+    return 1.0f - (
+        static_cast<float>(largest_free_block_size)
+        / static_cast<float>(total_free)
+    );
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+alloc(std::size_t const req_bytes) {
+    return alloc(req_bytes, Lifetime::short_lived);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+alloc(std::size_t const req_bytes, Lifetime const lifetime) {
+    void *address = try_alloc(req_bytes, lifetime);
+
+    // Let the program make room, if it can, before giving up
+    while(address == nullptr && _handle_exhaustion(req_bytes)) {
+        address = try_alloc(req_bytes, lifetime);
+    }
+
+    // We couldn't find a block of sufficient size, so the allocation has
+    // failed and the user will need to handle it how they see fit
+    if(address == nullptr) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    return address;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+try_alloc(std::size_t const req_bytes) {
+    return try_alloc(req_bytes, Lifetime::short_lived);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+try_alloc(std::size_t const req_bytes, Lifetime const lifetime) {
+#ifdef BTX_MEMORY_LATENCY
+    auto const start_ticks = latency_ticks();
+#endif
+
+    void *address = nullptr;
+    PendingPressure pending;
+
+#ifdef BTX_MEMORY_SAMPLING
+    AllocationSampler *sampler = nullptr;
+#endif
+
+    {
+        std::scoped_lock const guard(_lock);
+
+        address = _alloc(req_bytes, lifetime);
+        if(address != nullptr) {
+            _raise_watermarks(pending);
+
+#ifdef BTX_MEMORY_SAMPLING
+            if((BlockHeader::header(address)->flags
+                & BlockHeader::flag_sampled) != 0)
+            {
+                sampler = _sampler;
+            }
+#endif
+
+#ifdef BTX_MEMORY_LATENCY
+            _alloc_latency.record(latency_ticks() - start_ticks);
+#endif
+        }
+    }
+
+#ifdef BTX_MEMORY_SAMPLING
+    // Nobody else has the address yet, so there's no free to race with
+    if(sampler != nullptr) {
+        sampler->record(address, req_bytes);
+    }
+#endif
+
+    // Outside the lock, so the callbacks can free what they like
+    if(pending.count != 0) {
+        _notify_pressure(pending);
+    }
+
+    return address;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_alloc(std::size_t const req_bytes, Lifetime const lifetime) {
+    if(req_bytes <= 0) {
+        detail::report_invalid_request(req_bytes);
+    }
+
+    if(_large_threshold != 0 && req_bytes > _large_threshold) {
+        void *address = _large.alloc(req_bytes);
+        if(address == nullptr) {
+            return nullptr;
+        }
+
+        auto *header = BlockHeader::header(address);
+        _stats.on_used(header->size + sizeof(BlockHeader));
+        _stats.on_alloc();
+
+#ifdef BTX_MEMORY_SAMPLING
+        _sample(header, req_bytes);
+#endif
+
+#ifdef BTX_MEMORY_TRACE
+        if(_trace_recorder != nullptr) {
+            _trace_recorder->record(
+                TraceOp::alloc_large, req_bytes,
+                reinterpret_cast<std::uintptr_t>(address)
+            );
+        }
+#endif
+
+        return address;
+    }
+
+    std::size_t const bytes = _round_bytes(
+        std::max(req_bytes, FitPolicy::min_payload),
+        Alignment
+    );
+
+    // Freed blocks are usually reused before the top chunk is touched, which
+    // keeps placement the same as if the top chunk were just the last block
+    // on the list. But while nothing's been freed, there's no list to search
+    // and allocating is a pointer bump.
+    bool const top_first = _fit.prefers_top();
+
+    BlockHeader *current_header = nullptr;
+
+    if(lifetime == Lifetime::long_lived) {
+        current_header = _take_from_list_end(bytes);
+
+        if(current_header == nullptr) {
+            current_header = _take_from_top_end(bytes);
+        }
+    }
+
+    if(current_header == nullptr && top_first) {
+        current_header = _take_from_top(bytes);
+    }
+
+    if(current_header == nullptr) {
+        current_header = _take_from_list(bytes);
+    }
+
+    if(current_header == nullptr && !top_first) {
+        current_header = _take_from_top(bytes);
+    }
+
+    // Nothing fits, so leave it to the caller to decide what happens next
+    if(current_header == nullptr) {
+        return nullptr;
+    }
+
+    // Update the heap's metrics
+    _stats.on_used(current_header->size);
+    _stats.on_alloc();
+
+#ifdef BTX_MEMORY_SAMPLING
+    _sample(current_header, req_bytes);
+#endif
+
+#ifdef BTX_MEMORY_TRACE
+    if(_trace_recorder != nullptr) {
+        _trace_recorder->record(
+            TraceOp::alloc, req_bytes,
+            static_cast<std::uint64_t>(
+                static_cast<std::uint8_t *>(
+                    BlockHeader::payload(current_header)
+                ) - _raw_heap
+            )
+        );
+    }
+#endif
+
+    // And hand the bytes requested back to the user
+    return BlockHeader::payload(current_header);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+free(void *address) {
+#ifdef BTX_MEMORY_LATENCY
+    auto const start_ticks = latency_ticks();
+#endif
+
+    std::scoped_lock const guard(_lock);
+
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    // Grab the associated header from the user's pointer
+    BlockHeader *header_to_free = BlockHeader::header(address);
+
+#ifdef BTX_MEMORY_SAMPLING
+    _unsample(header_to_free);
+#endif
+
+#ifdef BTX_MEMORY_TRACE
+    if(_trace_recorder != nullptr) {
+        if((header_to_free->flags & BlockHeader::flag_large) != 0) {
+            _trace_recorder->record(
+                TraceOp::free_large, header_to_free->size,
+                reinterpret_cast<std::uintptr_t>(address)
+            );
+        }
+        else {
+            _trace_recorder->record(
+                TraceOp::free, header_to_free->size,
+                static_cast<std::uint64_t>(
+                    static_cast<std::uint8_t *>(address) - _raw_heap
+                )
+            );
+        }
+    }
+#endif
+
+    if((header_to_free->flags & BlockHeader::flag_large) != 0) {
+        // Large blocks hand their pages straight back, header and all
+        _stats.on_released(header_to_free->size + sizeof(BlockHeader));
+        _stats.on_free();
+
+        _large.free(address);
+    }
+    else {
+        // Update heap stats
+        _stats.on_released(header_to_free->size);
+        _stats.on_free();
+
+        auto *block_end =
+            static_cast<std::uint8_t *>(address) + header_to_free->size;
+
+        // With nothing on the free list, a block next to the top chunk can't
+        // have a free neighbour to merge with first
+        if(_free_head == nullptr
+           && (block_end == _top
+               || reinterpret_cast<std::uint8_t *>(header_to_free) == _top_end))
+        {
+            _return_to_top(header_to_free);
+        }
+        else {
+            _insert_free_block(header_to_free);
+            auto *merged = _coalesce(header_to_free);
+
+            auto *merged_start = reinterpret_cast<std::uint8_t *>(merged);
+            auto *merged_end =
+                static_cast<std::uint8_t *>(BlockHeader::payload(merged))
+                + merged->size;
+
+            if(merged_end == _top || merged_start == _top_end) {
+                _use_whole_free_block(merged);
+                _return_to_top(merged);
+            }
+        }
+    }
+
+    _lower_watermarks();
+
+#ifdef BTX_MEMORY_LATENCY
+    _free_latency.record(latency_ticks() - start_ticks);
+#endif
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+realloc(void *address, std::size_t const req_bytes) {
+    if(address == nullptr) {
+        return alloc(req_bytes);
+    }
+
+    auto *header = BlockHeader::header(address);
+
+    // Shrinking, or growing within the block's slack, leaves it where it is
+    if(req_bytes <= header->size) {
+        return address;
+    }
+
+    if((header->flags & BlockHeader::flag_large) != 0) {
+        void *new_address = _realloc_large(address, req_bytes);
+
+        while(new_address == nullptr && _handle_exhaustion(req_bytes)) {
+            new_address = _realloc_large(address, req_bytes);
+        }
+
+        if(new_address == nullptr) {
+            detail::report_alloc_failure(req_bytes);
+        }
+
+        return new_address;
+    }
+
+    // Anything else moves to a new block, which might itself be large
+    void *new_address = alloc(req_bytes);
+    std::memcpy(new_address, address, header->size);
+    free(address);
+
+    return new_address;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+reset(bool const trim) {
+    std::scoped_lock const guard(_lock);
+
+    // A live child would free its block back into the reset heap later on
+    if(_first_child != nullptr) {
+        detail::report_live_children();
+    }
+
+#ifdef BTX_MEMORY_SAMPLING
+    // The sampler may be shared with other heaps, so only forget what was
+    // sampled from this one
+    if(_sampler != nullptr) {
+        _sampler->forget_range(_raw_heap, _raw_heap + _total_size);
+        _large.for_each([this](BlockHeader *header) { _unsample(header); });
+    }
+#endif
+
+    _large.clear();
+    _stats.reset_current();
+    _lower_watermarks();
+
+    // A heap too small to hold anything has nothing to reset
+    if(_total_size == 0) {
+        return;
+    }
+
+    if(trim) {
+        // Everything past the page holding the top chunk's header
+        auto const page = vm::page_size();
+        auto const first = _round_bytes(
+            reinterpret_cast<std::uintptr_t>(_raw_heap) + sizeof(BlockHeader),
+            page
+        );
+        auto *address = reinterpret_cast<std::uint8_t *>(first);
+
+        // A lazily committed heap goes back to being mostly reserved, from
+        // both ends
+        if(_reserved_bytes != 0) {
+            auto *reserved_end = _storage + _reserved_bytes;
+            if(address < reserved_end) {
+                vm::decommit(address,
+                             static_cast<std::size_t>(reserved_end - address));
+            }
+
+            _committed_end = std::min(address, reserved_end);
+            _committed_start = reserved_end;
+        }
+        else {
+            auto const last = (reinterpret_cast<std::uintptr_t>(_committed_end)
+                               / page) * page;
+
+            if(first < last) {
+                vm::discard(address, last - first);
+            }
+        }
+    }
+
+    _init_free_list();
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+auto BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+create_child(std::size_t const req_bytes) -> std::unique_ptr<BasicHeap> {
+    void *block = alloc(req_bytes);
+
+    std::unique_ptr<BasicHeap> child(new BasicHeap(*this, block, req_bytes));
+
+    std::scoped_lock const guard(_lock);
+
+    child->_next_sibling = _first_child;
+    if(_first_child != nullptr) {
+        _first_child->_prev_sibling = child.get();
+    }
+    _first_child = child.get();
+
+    return child;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+add_watermark(float const fraction, PressureCallback callback, void *context)
+    requires StatsPolicy::enabled
+{
+    std::scoped_lock const guard(_lock);
+
+    if(_watermarks.count == max_watermarks) {
+        return false;
+    }
+
+    // NaN would compare false against every usage, and so never fire, and a
+    // negative fraction has no byte count to convert to
+    if(!std::isfinite(fraction) || fraction < 0.0f) {
+        return false;
+    }
+
+    _watermarks.entries[_watermarks.count++] = Watermark {
+        .bytes    = static_cast<std::size_t>(
+            static_cast<double>(fraction) * static_cast<double>(_total_size)
+        ),
+        .callback = callback,
+        .context  = context,
+        .raised   = false,
+    };
+
+    _update_watermark_bounds();
+    return true;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+remove_watermark(PressureCallback callback, void *context)
+    requires StatsPolicy::enabled
+{
+    std::scoped_lock const guard(_lock);
+
+    for(std::size_t index = 0; index < _watermarks.count; ++index) {
+        auto const &watermark = _watermarks.entries[index];
+        if(watermark.callback != callback || watermark.context != context) {
+            continue;
+        }
+
+        // Order doesn't matter, so the last one fills the gap
+        _watermarks.entries[index] =
+            _watermarks.entries[--_watermarks.count];
+        _update_watermark_bounds();
+        return true;
+    }
+
+    return false;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+owns(void const *address) const {
+    auto const *byte = static_cast<std::uint8_t const *>(address);
+    if(byte >= _raw_heap && byte < _raw_heap + _total_size) {
+        return true;
+    }
+
+    std::scoped_lock const guard(_lock);
+    return _large.owns(address);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(std::size_t const req_bytes) :
+    _total_size { _round_bytes(req_bytes, _min_alloc_bytes) }
+{
+    // Only ask for extra room to align into if malloc() won't already
+    // satisfy the alignment we need
+    std::size_t constexpr slack =
+        Alignment > alignof(std::max_align_t) ? Alignment : 0;
+
+    _storage = static_cast<std::uint8_t *>(std::malloc(_total_size + slack));
+
+    if(_storage == nullptr) {
+        detail::report_storage_failure(_total_size);
+    }
+
+    _raw_heap = _storage;
+    if constexpr(slack > 0) {
+        _raw_heap = _align_up(_storage);
+    }
+
+    _committed_end = _raw_heap + _total_size;
+    _init_free_list();
+    detail::report_heap_created(_total_size);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(std::size_t const req_bytes, [[maybe_unused]] LazyCommit const) :
+    _total_size { _round_bytes(req_bytes, _min_alloc_bytes) }
+{
+    _reserved_bytes = vm::page_round(_total_size);
+    _storage = static_cast<std::uint8_t *>(vm::reserve(_reserved_bytes));
+
+    if(_storage == nullptr) {
+        detail::report_storage_failure(_total_size);
+    }
+
+    // Page aligned, which is plenty for any payload alignment
+    _raw_heap = _storage;
+    _committed_end = _raw_heap;
+    _committed_start = _storage + _reserved_bytes;
+
+    // Only the top chunk's header has to exist to begin with
+    if(!_commit_to(_raw_heap + sizeof(BlockHeader))) {
+        detail::report_storage_failure(_total_size);
+    }
+
+    _init_free_list();
+    detail::report_heap_created(_total_size);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(std::size_t const req_bytes, AtAddress const at) :
+    _total_size { _round_bytes(req_bytes, _min_alloc_bytes) }
+{
+    _reserved_bytes = vm::page_round(sizeof(SnapshotHeader) + _total_size);
+    _storage = static_cast<std::uint8_t *>(
+        vm::reserve_at(at.address, _reserved_bytes)
+    );
+
+    if(_storage == nullptr) {
+        detail::report_address_unavailable(at.address);
+    }
+
+    // Leave room for a snapshot's header ahead of the storage, so the file
+    // maps back in at exactly at.address
+    _raw_heap = _storage + sizeof(SnapshotHeader);
+    _committed_end = _storage;
+    _committed_start = _storage + _reserved_bytes;
+
+    if(!_commit_to(_raw_heap + sizeof(BlockHeader))) {
+        detail::report_storage_failure(_total_size);
+    }
+
+    _init_free_list();
+    detail::report_heap_created(_total_size);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(std::span<std::byte> const memory) :
+    _storage   { nullptr },
+    _raw_heap  { _align_up(reinterpret_cast<std::uint8_t *>(memory.data())) },
+    _free_head { nullptr },
+    _total_size { _usable_bytes(memory) }
+{
+    if(_total_size == 0) {
+        detail::report_storage_too_small(memory.size());
+
+        // An empty top chunk, so every allocation fails
+        _top = _raw_heap;
+        _top_end = _raw_heap;
+        _committed_end = _raw_heap;
+        return;
+    }
+
+    _committed_end = _raw_heap + _total_size;
+    _init_free_list();
+    detail::report_heap_created(_total_size);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(BasicHeap &parent, void *block, std::size_t const bytes) :
+    BasicHeap(std::span<std::byte>(static_cast<std::byte *>(block), bytes))
+{
+    _parent = &parent;
+    _parent_block = block;
+
+    // Whatever the parent's stats were charged for the block, which for a
+    // large block includes its header
+    auto const *header = BlockHeader::header(block);
+    _parent_bytes = (header->flags & BlockHeader::flag_large) != 0
+                  ? header->size + sizeof(BlockHeader)
+                  : header->size;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(FromSnapshot const snapshot) :
+    BasicHeap(snapshot, detail::read_snapshot_header(snapshot.path))
+{ }
+
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+BasicHeap(FromSnapshot const snapshot, SnapshotHeader const &header) :
+    _total_size { static_cast<std::size_t>(header.total_size) }
+{
+    static_assert(std::is_trivially_copyable_v<StatsPolicy>);
+    static_assert(sizeof(StatsPolicy) <= sizeof(SnapshotHeader::stats));
+
+    if(header.alignment != Alignment
+       || (StatsPolicy::enabled && header.stats_size != sizeof(StatsPolicy)))
+    {
+        detail::report_snapshot_failure(snapshot.path,
+                                        "saved by a different kind of heap");
+    }
+
+    // Every offset has to land inside the image, and the top chunk's header
+    // with it, before any of them is used
+    auto const in_image = [&header](std::uint64_t const offset) {
+        return offset <= header.total_size
+            && header.total_size - offset >= sizeof(BlockHeader);
+    };
+
+    if(header.total_size < sizeof(BlockHeader)
+       || (header.free_head != SnapshotHeader::no_free_head
+           && !in_image(header.free_head))
+       || header.top > header.top_end
+       || header.top_end > header.total_size
+       || (header.top != header.top_end && !in_image(header.top)))
+    {
+        detail::report_snapshot_failure(snapshot.path, "file is corrupt");
+    }
+
+    // Ask for the image to land where it was saved, which saves relocating
+    // anything. The hint is only honoured if it's page aligned and free,
+    // which it always is for a heap built at an AtAddress.
+    auto *hint = reinterpret_cast<void *>(
+        static_cast<std::uintptr_t>(header.base) - sizeof(SnapshotHeader)
+    );
+
+    _storage = static_cast<std::uint8_t *>(
+        vm::map_file(snapshot.path, _mapped_bytes, hint,
+                     snapshot.at_saved_address)
+    );
+
+    if(_storage == nullptr) {
+        detail::report_snapshot_failure(
+            snapshot.path, snapshot.at_saved_address
+                           ? "could not map file at its saved address"
+                           : "could not map file"
+        );
+    }
+
+    if(_mapped_bytes != sizeof(SnapshotHeader) + _total_size) {
+        detail::report_snapshot_failure(snapshot.path, "file is truncated");
+    }
+
+    _raw_heap = _storage + sizeof(SnapshotHeader);
+
+    _free_head = header.free_head == SnapshotHeader::no_free_head
+               ? nullptr
+               : reinterpret_cast<BlockHeader *>(_raw_heap + header.free_head);
+
+    _top = _raw_heap + header.top;
+    _top_end = _raw_heap + header.top_end;
+    _committed_end = _raw_heap + _total_size;
+
+    // Only free blocks hold links, so they're all that need fixing up, and
+    // relative links need nothing at all
+    auto const old_base = static_cast<std::uintptr_t>(header.base);
+    auto const new_base = reinterpret_cast<std::uintptr_t>(_raw_heap);
+
+    _relocated = new_base != old_base;
+
+#ifndef BTX_MEMORY_RELATIVE_LINKS
+    auto const relocate = [old_base, new_base](BlockHeader *&link) {
+        if(link != nullptr) {
+            link = reinterpret_cast<BlockHeader *>(
+                reinterpret_cast<std::uintptr_t>(link) - old_base + new_base
+            );
+        }
+    };
+#endif
+
+    // Each free block has to sit wholly inside the image, past the one
+    // before it, or the walk could go anywhere, or around forever
+    auto const *image_end = _raw_heap + _total_size;
+
+    for(auto *current_header = _free_head; current_header != nullptr;
+        current_header = current_header->next)
+    {
+        auto const *start = reinterpret_cast<std::uint8_t *>(current_header);
+        auto const *previous = reinterpret_cast<std::uint8_t *>(_free_tail);
+
+        if(start < _raw_heap || start <= previous
+           || static_cast<std::size_t>(image_end - start) < sizeof(BlockHeader)
+           || static_cast<std::size_t>(image_end - start)
+              - sizeof(BlockHeader) < current_header->size)
+        {
+            detail::report_snapshot_failure(snapshot.path, "file is corrupt");
+        }
+
+#ifndef BTX_MEMORY_RELATIVE_LINKS
+        if(_relocated) {
+            relocate(current_header->next);
+            relocate(current_header->prev);
+        }
+#endif
+
+        _free_tail = current_header;
+    }
+
+    if constexpr(StatsPolicy::enabled) {
+        std::memcpy(&_stats, header.stats.data(), sizeof(StatsPolicy));
+    }
+
+    _fit.init(_free_head, _total_size);
+
+    detail::report_heap_created(_total_size);
+}
+
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::~BasicHeap() {
+    if(_first_child != nullptr) {
+        detail::report_live_children();
+    }
+
+    if(_parent != nullptr) {
+        {
+            std::scoped_lock const guard(_parent->_lock);
+
+            if(_prev_sibling != nullptr) {
+                _prev_sibling->_next_sibling = _next_sibling;
+            }
+            else {
+                _parent->_first_child = _next_sibling;
+            }
+
+            if(_next_sibling != nullptr) {
+                _next_sibling->_prev_sibling = _prev_sibling;
+            }
+        }
+
+        // Everything else the child holds goes with the block, but its large
+        // blocks are its own and are unmapped along with _large
+        _parent->free(_parent_block);
+        return;
+    }
+
+    if(_mapped_bytes != 0) {
+        vm::unmap_file(_storage, _mapped_bytes);
+    }
+    else if(_reserved_bytes != 0) {
+        vm::unmap(_storage, _reserved_bytes);
+    }
+    else {
+        std::free(_storage);
+    }
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+save(char const *path) const {
+    std::scoped_lock const guard(_lock);
+
+    if(_large.count() != 0) {
+        detail::report_snapshot_error(path, "large blocks are still in use");
+        return false;
+    }
+
+    SnapshotHeader header { };
+    header.header_size = sizeof(BlockHeader);
+    header.pointer_size = sizeof(void *);
+    header.alignment = Alignment;
+    header.base = reinterpret_cast<std::uintptr_t>(_raw_heap);
+    header.total_size = _total_size;
+
+    header.free_head = _free_head == nullptr
+                     ? SnapshotHeader::no_free_head
+                     : static_cast<std::uint64_t>(
+                           reinterpret_cast<std::uint8_t *>(_free_head)
+                           - _raw_heap
+                       );
+
+    header.top = static_cast<std::uint64_t>(_top - _raw_heap);
+    header.top_end = static_cast<std::uint64_t>(_top_end - _raw_heap);
+
+    if constexpr(StatsPolicy::enabled) {
+        header.stats_size = sizeof(StatsPolicy);
+        std::memcpy(header.stats.data(), &_stats, sizeof(StatsPolicy));
+    }
+
+    std::FILE *file = std::fopen(path, "wb");
+    if(file == nullptr) {
+        detail::report_snapshot_error(path, "could not open file");
+        return false;
+    }
+
+    // Anything not yet committed can't be read, and has never been written,
+    // so it goes into the file as zeroes
+    auto const *heap_end = _raw_heap + _total_size;
+    auto const *high_start = _committed_high();
+    auto const low = std::min(
+        static_cast<std::size_t>(_committed_end - _raw_heap), _total_size
+    );
+    auto const high = static_cast<std::size_t>(heap_end - high_start);
+
+    bool written =
+        std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(_raw_heap, 1, low, file) == low;
+
+    std::array<std::uint8_t, 4096> const zeroes { };
+    for(auto remaining = _total_size - low - high;
+        written && remaining > 0;)
+    {
+        auto const chunk = std::min(remaining, zeroes.size());
+        written = std::fwrite(zeroes.data(), 1, chunk, file) == chunk;
+        remaining -= chunk;
+    }
+
+    written = written && std::fwrite(high_start, 1, high, file) == high;
+
+    written = std::fclose(file) == 0 && written;
+
+    if(!written) {
+        detail::report_snapshot_error(path, "could not write file");
+    }
+
+    return written;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_init_free_list() {
+    // Everything starts out in the top chunk, so the free list starts empty
+    _free_head = nullptr;
+    _free_tail = nullptr;
+    _top = _raw_heap;
+    _top_end = _raw_heap + _total_size;
+    _write_top_header();
+
+    // The top chunk is accounted for as a block like any other, so its header
+    // is the first thing in use
+    _stats.on_used(sizeof(BlockHeader));
+    _fit.init(_free_head, _total_size);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::uint8_t * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_align_up(std::uint8_t *address) {
+    auto const misalignment =
+        reinterpret_cast<std::uintptr_t>(address) % Alignment;
+
+    return misalignment == 0 ? address : address + (Alignment - misalignment);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::size_t BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_usable_bytes(std::span<std::byte> const memory) {
+    auto *start = reinterpret_cast<std::uint8_t *>(memory.data());
+    auto const skipped = static_cast<std::size_t>(_align_up(start) - start);
+
+    if(memory.size() < skipped) {
+        return 0;
+    }
+
+    auto const usable = ((memory.size() - skipped) / _min_alloc_bytes)
+                      * _min_alloc_bytes;
+
+    // There has to be room for one header and the smallest block after it
+    return usable >= sizeof(BlockHeader) + _min_alloc_bytes ? usable : 0;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::size_t BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_round_bytes(std::size_t const req_bytes, std::size_t const multiple) {
+    // All we're doing here is helping to keep the math and bookkeeping simpler
+    return ((req_bytes + multiple - 1) / multiple) * multiple;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_insert_free_block(BlockHeader *header) {
+    free_list::insert(_free_head, _free_tail, header);
+    _fit.on_insert(header);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_split_free_block(BlockHeader *header, std::size_t const bytes) {
+    // Reinterpret the space just beyond what's requested as a new free block
+    auto *new_free_header = reinterpret_cast<BlockHeader *>(
+        reinterpret_cast<std::uint8_t *>(header)
+        + sizeof(BlockHeader)
+        + bytes
+    );
+
+    // The heap's used size increases for each header, whether free or used
+    _stats.on_used(sizeof(BlockHeader));
+
+    // The new block's size is set to what's left of the original block
+    new_free_header->size = header->size - sizeof(BlockHeader) - bytes;
+    new_free_header->flags = 0;
+
+    // The fit policy sees the hand-off while the original header still has
+    // its pre-split size
+    _fit.on_replace(header, new_free_header);
+
+    // And the allocation we'll return is shrunk proportionately
+    header->size -= new_free_header->size + sizeof(BlockHeader);
+
+    // Then the remainder takes its place on the free list
+    free_list::replace(_free_head, _free_tail, header, new_free_header);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_use_whole_free_block(BlockHeader *header) {
+    _fit.on_remove(header);
+    free_list::unlink(_free_head, _free_tail, header);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BlockHeader * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_coalesce(BlockHeader *header) {
+    // If the next free block starts where this one's payload ends, the two
+    // are contiguous and can be merged
+    BlockHeader *next_header = header->next;
+    if(next_header != nullptr && free_list::adjacent(header, next_header)) {
+        auto const old_size = header->size;
+
+        _fit.on_remove(next_header);
+        free_list::absorb_next(_free_head, _free_tail, header);
+        _fit.on_resize(header, old_size);
+
+        // Since two blocks merged, there's one less header being used
+        _stats.on_released(sizeof(BlockHeader));
+    }
+
+    // The same again, with this block being absorbed by the previous one
+    BlockHeader *prev_header = header->prev;
+    if(prev_header != nullptr && free_list::adjacent(prev_header, header)) {
+        auto const old_size = prev_header->size;
+
+        _fit.on_remove(header);
+        free_list::absorb_next(_free_head, _free_tail, prev_header);
+        _fit.on_resize(prev_header, old_size);
+
+        _stats.on_released(sizeof(BlockHeader));
+
+        return prev_header;
+    }
+
+    return header;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_commit_to(std::uint8_t const *end) {
+    if(end <= _committed_end) {
+        return true;
+    }
+
+    // Every other kind of heap is committed from end to end already
+    if(_reserved_bytes == 0) {
+        return false;
+    }
+
+    // Commit whole chunks at a time, so a run of small allocations doesn't
+    // make a system call each
+    auto const wanted = _round_bytes(static_cast<std::size_t>(end - _storage),
+                                     _commit_chunk_bytes);
+    auto const new_committed = std::min(wanted, _reserved_bytes);
+    auto const old_committed =
+        static_cast<std::size_t>(_committed_end - _storage);
+
+    if(!vm::commit(_committed_end, new_committed - old_committed)) {
+        return false;
+    }
+
+    _committed_end = _storage + new_committed;
+    return true;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_commit_from(std::uint8_t const *start) {
+    if(_reserved_bytes == 0 || start >= _committed_start) {
+        return true;
+    }
+
+    // Whole chunks, counted back from the end of the reservation, but
+    // nothing below _committed_end, which is usable already
+    auto *reserved_end = _storage + _reserved_bytes;
+    auto const wanted = _round_bytes(
+        static_cast<std::size_t>(reserved_end - start), _commit_chunk_bytes
+    );
+
+    auto *new_start = wanted >= _reserved_bytes ? _storage
+                                                : reserved_end - wanted;
+    new_start = std::max(new_start, _committed_end);
+
+    if(new_start < _committed_start
+       && !vm::commit(new_start,
+                      static_cast<std::size_t>(_committed_start - new_start)))
+    {
+        return false;
+    }
+
+    _committed_start = new_start;
+    return true;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+std::uint8_t const * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_committed_high() const {
+    // Where the far end's committed pages start, not counting any that the
+    // near end has since grown into. Only short of the heap's end for a
+    // lazily committed heap holding long-lived blocks.
+    auto const *heap_end = _raw_heap + _total_size;
+    if(_reserved_bytes == 0) {
+        return heap_end;
+    }
+
+    auto const *low_end = std::min<std::uint8_t const *>(_committed_end,
+                                                         heap_end);
+    return std::clamp<std::uint8_t const *>(_committed_start, low_end,
+                                            heap_end);
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BlockHeader * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_take_from_list(std::size_t const bytes) {
+    if(_free_head == nullptr) {
+        return nullptr;
+    }
+
+    // Find a free block with sufficient space available
+    auto *header = _fit.find(_free_head, bytes);
+    if(header == nullptr) {
+        return nullptr;
+    }
+
+    // Holes among the long-lived blocks are kept for more of their kind,
+    // unless the top chunk can't take the request instead
+    if(reinterpret_cast<std::uint8_t *>(header) >= _top_end && _top != _top_end
+       && static_cast<std::size_t>(_top_end - _top) - sizeof(BlockHeader)
+          >= bytes)
+    {
+        return nullptr;
+    }
+
+    _take_free_block(header, bytes);
+    return header;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BlockHeader * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_take_from_list_end(std::size_t const bytes) {
+    // Only the blocks freed past the top chunk, the highest first, so
+    // long-lived blocks refill the holes left among their own kind before
+    // the top chunk shrinks any further
+    for(auto *header = _free_tail;
+        header != nullptr
+        && reinterpret_cast<std::uint8_t *>(header) >= _top_end;
+        header = header->prev)
+    {
+        if(detail::block_fits(header, bytes)) {
+            _take_free_block(header, bytes);
+            return header;
+        }
+    }
+
+    return nullptr;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_take_free_block(BlockHeader *header, std::size_t const bytes) {
+    // The most likely case is the block we've found is bigger than what we've
+    // asked for, so we need to split it. This implies the creation of a new
+    // header for the new allocation as well. But if splitting the block would
+    // result in less than 32 bytes of free space, or the block fits the
+    // request exactly, we just use the whole thing.
+    std::size_t const size_of_new_block = bytes + sizeof(BlockHeader);
+    if(header->size >= size_of_new_block
+       && header->size - size_of_new_block >= _min_alloc_bytes)
+    {
+        _split_free_block(header, bytes);
+    }
+    else {
+        _use_whole_free_block(header);
+    }
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BlockHeader * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_take_from_top(std::size_t const bytes) {
+    if(_top == _top_end) {
+        return nullptr;
+    }
+
+    auto const top_size = static_cast<std::size_t>(_top_end - _top)
+                        - sizeof(BlockHeader);
+    if(top_size < bytes) {
+        return nullptr;
+    }
+
+    // The same rule as splitting a free block: only leave a top chunk behind
+    // if there's room for at least the smallest block in it
+    bool const split = top_size - bytes >= sizeof(BlockHeader)
+                                         + _min_alloc_bytes;
+
+    // Everything up to the next top chunk's header has to be usable, which
+    // is only ever in question for a lazily committed heap
+    auto const *needed = split ? _top + 2 * sizeof(BlockHeader) + bytes
+                               : _top_end;
+    if(needed > _committed_end && !_commit_to(needed)) {
+        return nullptr;
+    }
+
+    // The top chunk's header becomes the new block's
+    auto *header = reinterpret_cast<BlockHeader *>(_top);
+
+    if(split) {
+        header->size = bytes;
+        _top += sizeof(BlockHeader) + bytes;
+        _write_top_header();
+
+        // The top chunk's header moved along, and the new block kept the old
+        _stats.on_used(sizeof(BlockHeader));
+    }
+    else {
+        _top = _top_end;
+    }
+
+    _fit.on_top_alloc();
+
+    return header;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+BlockHeader * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_take_from_top_end(std::size_t const bytes) {
+    if(_top == _top_end) {
+        return nullptr;
+    }
+
+    auto const top_size = static_cast<std::size_t>(_top_end - _top)
+                        - sizeof(BlockHeader);
+    if(top_size < bytes) {
+        return nullptr;
+    }
+
+    bool const split = top_size - bytes >= sizeof(BlockHeader)
+                                         + _min_alloc_bytes;
+
+    // Without a split this is no different to taking from the near end
+    if(!split) {
+        if(!_commit_to(_top_end)) {
+            return nullptr;
+        }
+
+        auto *header = reinterpret_cast<BlockHeader *>(_top);
+        _top = _top_end;
+
+        return header;
+    }
+
+    auto *block = _top_end - sizeof(BlockHeader) - bytes;
+    if(!_commit_from(block)) {
+        return nullptr;
+    }
+
+    auto *header = reinterpret_cast<BlockHeader *>(block);
+    header->size = bytes;
+    header->next = nullptr;
+    header->prev = nullptr;
+    header->flags = 0;
+
+    _top_end = block;
+    _write_top_header();
+
+    // The new block brings a header of its own
+    _stats.on_used(sizeof(BlockHeader));
+
+    return header;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_return_to_top(BlockHeader *header) {
+    // If the top chunk still exists, its header and this block's become one
+    if(_top != _top_end) {
+        _stats.on_released(sizeof(BlockHeader));
+    }
+
+    auto *start = reinterpret_cast<std::uint8_t *>(header);
+    auto *end = static_cast<std::uint8_t *>(BlockHeader::payload(header))
+              + header->size;
+
+    // The block sits against one end of the top chunk or the other. If the
+    // top chunk was empty, both ends were in the same place.
+    if(end == _top) {
+        _top = start;
+    }
+    else {
+        _top_end = end;
+    }
+
+    _write_top_header();
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_write_top_header() {
+    auto *header = reinterpret_cast<BlockHeader *>(_top);
+
+    header->size = static_cast<std::size_t>(_top_end - _top)
+                 - sizeof(BlockHeader);
+    header->next = nullptr;
+    header->prev = nullptr;
+    header->flags = 0;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void * BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_realloc_large(void *address, std::size_t const req_bytes) {
+    void *new_address = nullptr;
+    PendingPressure pending;
+
+    {
+        std::scoped_lock const guard(_lock);
+
+        auto *header = BlockHeader::header(address);
+        auto const old_size = header->size;
+
+#ifdef BTX_MEMORY_SAMPLING
+        // The sample would be left pointing at the old address
+        _unsample(header);
+#endif
+
+        // On failure the block stays where it was, so it can be tried again
+        new_address = _large.realloc(address, req_bytes);
+        if(new_address == nullptr) {
+            return nullptr;
+        }
+
+        _stats.on_used(BlockHeader::header(new_address)->size - old_size);
+        _raise_watermarks(pending);
+
+#ifdef BTX_MEMORY_TRACE
+        // Traced as a free and a fresh alloc, as a move within the heap is
+        if(_trace_recorder != nullptr) {
+            _trace_recorder->record(TraceOp::free_large, old_size,
+                                    reinterpret_cast<std::uintptr_t>(address));
+            _trace_recorder->record(
+                TraceOp::alloc_large, req_bytes,
+                reinterpret_cast<std::uintptr_t>(new_address)
+            );
+        }
+#endif
+    }
+
+    if(pending.count != 0) {
+        _notify_pressure(pending);
+    }
+
+    return new_address;
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_raise_watermarks(PendingPressure &pending) {
+    if constexpr(StatsPolicy::enabled) {
+        auto const used = _stats.current_used();
+        if(used < _watermarks.next_raise) {
+            return;
+        }
+
+        pending.used = used;
+
+        for(std::size_t index = 0; index < _watermarks.count; ++index) {
+            auto &watermark = _watermarks.entries[index];
+            if(!watermark.raised && used >= watermark.bytes) {
+                watermark.raised = true;
+                pending.entries[pending.count++] = watermark;
+            }
+        }
+
+        _update_watermark_bounds();
+    }
+    else {
+        (void)pending;
+    }
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_lower_watermarks() {
+    if constexpr(StatsPolicy::enabled) {
+        auto const used = _stats.current_used();
+        if(used >= _watermarks.next_lower) {
+            return;
+        }
+
+        for(std::size_t index = 0; index < _watermarks.count; ++index) {
+            auto &watermark = _watermarks.entries[index];
+            if(watermark.raised && used < watermark.bytes) {
+                watermark.raised = false;
+            }
+        }
+
+        _update_watermark_bounds();
+    }
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_update_watermark_bounds() requires StatsPolicy::enabled {
+    auto &watermarks = _watermarks;
+    watermarks.next_raise = std::numeric_limits<std::size_t>::max();
+    watermarks.next_lower = 0;
+
+    for(std::size_t index = 0; index < watermarks.count; ++index) {
+        auto const &watermark = watermarks.entries[index];
+
+        if(watermark.raised) {
+            watermarks.next_lower = std::max(watermarks.next_lower,
+                                             watermark.bytes);
+        }
+        else {
+            watermarks.next_raise = std::min(watermarks.next_raise,
+                                             watermark.bytes);
+        }
+    }
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+void BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_notify_pressure(PendingPressure &pending) {
+    auto &entries = pending.entries;
+    auto const count = pending.count;
+
+    // Lowest first, so the gentlest response gets its chance first. There
+    // are never more than max_watermarks, so an insertion sort does.
+    for(std::size_t index = 1; index < count; ++index) {
+        auto const watermark = entries[index];
+
+        auto slot = index;
+        while(slot > 0 && entries[slot - 1].bytes > watermark.bytes) {
+            entries[slot] = entries[slot - 1];
+            --slot;
+        }
+
+        entries[slot] = watermark;
+    }
+
+    for(std::size_t index = 0; index < count; ++index) {
+        entries[index].callback(entries[index].context, pending.used);
+    }
+}
+
+// =============================================================================
+template<typename FitPolicy, typename LockPolicy, typename StatsPolicy,
+         std::size_t Alignment>
+bool BasicHeap<FitPolicy, LockPolicy, StatsPolicy, Alignment>::
+_handle_exhaustion(std::size_t const req_bytes) {
+    ExhaustionHandler handler = nullptr;
+    void *context = nullptr;
+
+    {
+        std::scoped_lock const guard(_lock);
+        handler = _exhaustion_handler;
+        context = _exhaustion_context;
+    }
+
+    return handler != nullptr && handler(context, req_bytes);
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_BASICHEAP_HPP
\ No newline at end of file
@@ -3,10 +3,31 @@
 
 #include <cstddef>
 
+#ifdef BTX_MEMORY_RELATIVE_LINKS
+    #include "brasstacks/memory/RelativeLink.hpp"
+#endif
+
 namespace btx::memory {
 
+struct BlockHeader;
+
+// With BTX_MEMORY_RELATIVE_LINKS, every link between blocks is position
+// independent, so a heap's storage can be mapped anywhere without fixing up
+// its free list. Otherwise links are plain pointers.
+#ifdef BTX_MEMORY_RELATIVE_LINKS
+using BlockLink = RelativeLink<BlockHeader>;
+#else
+using BlockLink = BlockHeader *;
+#endif
+
 struct alignas(32) BlockHeader final {
 public:
+    // The block has its own pages, mapped straight from the OS
+    static std::size_t constexpr flag_large = 1u << 0;
+
+    // An AllocationSampler picked the block, and wants to hear when it's freed
+    static std::size_t constexpr flag_sampled = 1u << 1;
+
     // Convenience functions for common casting and pointer math
     [[nodiscard]] static inline BlockHeader * header(void *address) {
         return reinterpret_cast<BlockHeader *>(address) - 1;
@@ -31,8 +52,10 @@ public:
                           // for user allocation. Said another way, it's the
                           // size of the whole block, minus sizeof(BlockHeader).
 
-    BlockHeader *next = nullptr;
-    BlockHeader *prev = nullptr;
+    BlockLink next = nullptr;
+    BlockLink prev = nullptr;
+
+    std::size_t flags = 0;
 };
 
 } // namespace btx::memory
@@ -0,0 +1,345 @@
+#ifndef BRASSTACKS_MEMORY_BUDDYHEAP_HPP
+#define BRASSTACKS_MEMORY_BUDDYHEAP_HPP
+
+#include "brasstacks/memory/BasicHeap.hpp"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+namespace btx::memory {
+
+// A binary buddy allocator. Every block is a power of two in size and aligned
+// to its own size within the heap, so a block's buddy is found by flipping a
+// single bit of its offset. Freeing merges buddies upward in at most one step
+// per order, without walking any list, and allocation takes the smallest
+// non-empty order and splits it down.
+//
+// Blocks carry no header. Instead a side table keeps one byte per smallest
+// possible block recording the order of whichever block starts there, and
+// whether it's free, so power-of-two requests fit exactly. A heap whose size
+// isn't a power of two starts out as a run of power-of-two blocks, largest
+// first.
+template<typename LockPolicy, typename StatsPolicy>
+class BasicBuddyHeap final {
+public:
+    using lock_policy  = LockPolicy;
+    using stats_policy = StatsPolicy;
+
+    // The smallest block, which is also the alignment of every payload
+    static std::size_t constexpr min_block_bytes = 32;
+
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes);
+
+    void free(void *address);
+
+    [[nodiscard]] bool owns(void const *address) const {
+        auto const *byte = static_cast<std::uint8_t const *>(address);
+        return byte >= _raw_heap && byte < _raw_heap + _total_size;
+    }
+
+    // The size of the block that would serve a request
+    [[nodiscard]] static std::size_t block_size(std::size_t const req_bytes) {
+        return std::size_t { 1 } << _order(req_bytes);
+    }
+
+    [[nodiscard]] auto total_size() const { return _total_size; }
+
+    [[nodiscard]] auto current_used() const requires StatsPolicy::enabled {
+        return _stats.current_used();
+    }
+
+    [[nodiscard]] auto current_allocs() const requires StatsPolicy::enabled {
+        return _stats.current_allocs();
+    }
+
+    [[nodiscard]] auto peak_used() const requires StatsPolicy::enabled {
+        return _stats.peak_used();
+    }
+
+    [[nodiscard]] auto peak_allocs() const requires StatsPolicy::enabled {
+        return _stats.peak_allocs();
+    }
+
+    [[nodiscard]] float calc_fragmentation() const;
+
+    BasicBuddyHeap() = delete;
+    ~BasicBuddyHeap();
+
+    // The size is rounded down to a multiple of min_block_bytes
+    explicit BasicBuddyHeap(std::size_t const req_bytes);
+
+    BasicBuddyHeap(BasicBuddyHeap &&other) = delete;
+    BasicBuddyHeap(BasicBuddyHeap const &) = delete;
+
+    BasicBuddyHeap & operator=(BasicBuddyHeap &&other) = delete;
+    BasicBuddyHeap & operator=(BasicBuddyHeap const &) = delete;
+
+private:
+    // Free blocks link to one another through their own payloads
+    struct FreeBlock final {
+        FreeBlock *next;
+        FreeBlock *prev;
+    };
+
+    static std::size_t constexpr _min_order =
+        static_cast<std::size_t>(std::countr_zero(min_block_bytes));
+
+    static std::size_t constexpr _order_count = 64;
+
+    // Each side table entry is a block's order, plus this bit while it's free
+    static std::uint8_t constexpr _free_bit = 0x80;
+
+    std::uint8_t *_storage;  // As returned by std::malloc()
+    std::uint8_t *_raw_heap; // _storage, aligned to min_block_bytes
+    std::uint8_t *_orders;   // One entry per min_block_bytes of heap
+
+    std::size_t const _total_size;
+
+    std::array<FreeBlock *, _order_count> _free_lists { };
+    std::uint64_t _nonempty = 0;
+
+    [[no_unique_address]] mutable LockPolicy _lock;
+    [[no_unique_address]] StatsPolicy _stats;
+
+    [[nodiscard]] static std::size_t _order(std::size_t const bytes) {
+        auto const order = static_cast<std::size_t>(
+            std::bit_width(bytes - 1)
+        );
+        return order < _min_order ? _min_order : order;
+    }
+
+    [[nodiscard]] std::uint8_t & _entry(std::size_t const offset) {
+        return _orders[offset >> _min_order];
+    }
+
+    void _push(std::size_t const offset, std::size_t const order);
+    void _remove(std::size_t const offset, std::size_t const order);
+};
+
+using BuddyHeap = BasicBuddyHeap<NoLock, HeapStats>;
+
+extern template class BasicBuddyHeap<NoLock, HeapStats>;
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+BasicBuddyHeap<LockPolicy, StatsPolicy>::
+BasicBuddyHeap(std::size_t const req_bytes) :
+    _total_size { (req_bytes / min_block_bytes) * min_block_bytes }
+{
+    auto const entries = _total_size / min_block_bytes;
+
+    // The side table lives just past the heap itself, in the same allocation
+    _storage = static_cast<std::uint8_t *>(
+        std::malloc(_total_size + min_block_bytes + entries)
+    );
+
+    if(_storage == nullptr) {
+        detail::report_storage_failure(_total_size);
+    }
+
+    _raw_heap = _storage;
+    auto const misalignment =
+        reinterpret_cast<std::uintptr_t>(_storage) % min_block_bytes;
+    if(misalignment != 0) {
+        _raw_heap += min_block_bytes - misalignment;
+    }
+
+    _orders = _raw_heap + _total_size;
+
+    // Carve the heap into the largest power-of-two blocks that fit, in
+    // decreasing order, so each one is aligned to its own size
+    std::size_t offset = 0;
+    while(offset < _total_size) {
+        auto const order = static_cast<std::size_t>(
+            std::bit_width(_total_size - offset)
+        ) - 1;
+
+        _push(offset, order);
+        offset += std::size_t { 1 } << order;
+    }
+
+    detail::report_heap_created(_total_size);
+}
+
+template<typename LockPolicy, typename StatsPolicy>
+BasicBuddyHeap<LockPolicy, StatsPolicy>::~BasicBuddyHeap() {
+    std::free(_storage);
+}
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+void * BasicBuddyHeap<LockPolicy, StatsPolicy>::
+alloc(std::size_t const req_bytes) {
+    void *address = try_alloc(req_bytes);
+
+    if(address == nullptr) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    return address;
+}
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+void * BasicBuddyHeap<LockPolicy, StatsPolicy>::
+try_alloc(std::size_t const req_bytes) {
+    if(req_bytes == 0) {
+        detail::report_invalid_request(req_bytes);
+        return nullptr;
+    }
+
+    auto const order = _order(req_bytes);
+    if(order >= _order_count) {
+        return nullptr;
+    }
+
+    std::scoped_lock const guard(_lock);
+
+    // The smallest order at or above the request with a free block
+    auto const candidates = _nonempty & (~std::uint64_t { 0 } << order);
+    if(candidates == 0) {
+        return nullptr;
+    }
+
+    auto block_order = static_cast<std::size_t>(std::countr_zero(candidates));
+    auto const offset = static_cast<std::size_t>(
+        reinterpret_cast<std::uint8_t *>(_free_lists[block_order]) - _raw_heap
+    );
+
+    _remove(offset, block_order);
+
+    // Split it down, freeing the upper half each time
+    while(block_order > order) {
+        --block_order;
+        _push(offset + (std::size_t { 1 } << block_order), block_order);
+    }
+
+    _entry(offset) = static_cast<std::uint8_t>(order);
+
+    _stats.on_used(std::size_t { 1 } << order);
+    _stats.on_alloc();
+
+    return _raw_heap + offset;
+}
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+void BasicBuddyHeap<LockPolicy, StatsPolicy>::free(void *address) {
+    std::scoped_lock const guard(_lock);
+
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    auto offset = static_cast<std::size_t>(
+        static_cast<std::uint8_t *>(address) - _raw_heap
+    );
+
+    auto const entry = _entry(offset);
+    if((entry & _free_bit) != 0) {
+        detail::report_invalid_free();
+    }
+
+    auto order = static_cast<std::size_t>(entry);
+
+    _stats.on_released(std::size_t { 1 } << order);
+    _stats.on_free();
+
+    // Merge with the buddy for as long as it's free and whole. A buddy that's
+    // been split has a smaller order recorded at its offset, and one that
+    // would run past the end of the heap doesn't exist.
+    while(order + 1 < _order_count) {
+        auto const block_size = std::size_t { 1 } << order;
+        auto const buddy = offset ^ block_size;
+
+        if(buddy + block_size > _total_size
+           || _entry(buddy) != (_free_bit | order))
+        {
+            break;
+        }
+
+        _remove(buddy, order);
+        offset &= ~block_size;
+        ++order;
+    }
+
+    _push(offset, order);
+}
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+float BasicBuddyHeap<LockPolicy, StatsPolicy>::calc_fragmentation() const {
+    std::scoped_lock const guard(_lock);
+
+    std::size_t total_free = 0;
+    for(std::size_t order = 0; order < _order_count; ++order) {
+        for(auto *block = _free_lists[order]; block != nullptr;
+            block = block->next)
+        {
+            total_free += std::size_t { 1 } << order;
+        }
+    }
+
+    if(total_free == 0) {
+        return 0.0f;
+    }
+
+    auto const largest_free_block_size =
+        std::size_t { 1 } << (std::bit_width(_nonempty) - 1);
+
+    return 1.0f - (
+        static_cast<float>(largest_free_block_size)
+        / static_cast<float>(total_free)
+    );
+}
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+void BasicBuddyHeap<LockPolicy, StatsPolicy>::
+_push(std::size_t const offset, std::size_t const order) {
+    auto *block = reinterpret_cast<FreeBlock *>(_raw_heap + offset);
+
+    block->prev = nullptr;
+    block->next = _free_lists[order];
+
+    if(block->next != nullptr) {
+        block->next->prev = block;
+    }
+
+    _free_lists[order] = block;
+    _nonempty |= std::uint64_t { 1 } << order;
+
+    _entry(offset) = static_cast<std::uint8_t>(_free_bit | order);
+}
+
+// =============================================================================
+template<typename LockPolicy, typename StatsPolicy>
+void BasicBuddyHeap<LockPolicy, StatsPolicy>::
+_remove(std::size_t const offset, std::size_t const order) {
+    auto *block = reinterpret_cast<FreeBlock *>(_raw_heap + offset);
+
+    if(block->next != nullptr) {
+        block->next->prev = block->prev;
+    }
+
+    if(block->prev != nullptr) {
+        block->prev->next = block->next;
+    }
+    else {
+        _free_lists[order] = block->next;
+    }
+
+    if(_free_lists[order] == nullptr) {
+        _nonempty &= ~(std::uint64_t { 1 } << order);
+    }
+
+    _entry(offset) = static_cast<std::uint8_t>(order);
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_BUDDYHEAP_HPP
@@ -0,0 +1,323 @@
+#ifndef BRASSTACKS_MEMORY_FRAMEPOOL_HPP
+#define BRASSTACKS_MEMORY_FRAMEPOOL_HPP
+
+#include "brasstacks/memory/Heap.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace btx::memory {
+
+// Fixed-size blocks for coroutine frames, carved from a heap in chunks. Every
+// coroutine type has one frame size, so each size gets its own free list, and
+// alloc() and free() are a push or pop on that list once the first chunk for
+// a size is in place. Frames of the same type are handed out next to each
+// other, and reuse is last in, first out, so a hot coroutine keeps landing in
+// the same cache lines.
+//
+// Frames larger than max_pooled go straight to the heap. Chunks are only
+// returned to the heap when the pool is destroyed.
+template<typename HeapType>
+class BasicFramePool final {
+public:
+    static std::size_t constexpr granularity =
+        __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    static std::size_t constexpr max_pooled = 2048;
+
+    // Aborts if the heap can't supply another chunk
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+
+    // bytes must match what was passed to alloc()
+    void free(void *address, std::size_t const bytes);
+
+    [[nodiscard]] auto live_frames() const {
+        std::scoped_lock const guard(_lock);
+        return _live_frames;
+    }
+
+    [[nodiscard]] auto chunk_count() const {
+        std::scoped_lock const guard(_lock);
+        return _chunk_count;
+    }
+
+    // The pool coroutines on this thread fall back to when they aren't
+    // handed one explicitly, for as long as this object is in scope
+    class ScopedDefault final {
+    public:
+        explicit ScopedDefault(BasicFramePool &pool) :
+            _previous { _thread_default }
+        {
+            _thread_default = &pool;
+        }
+
+        ~ScopedDefault() { _thread_default = _previous; }
+
+        ScopedDefault(ScopedDefault &&other) = delete;
+        ScopedDefault(ScopedDefault const &) = delete;
+
+        ScopedDefault & operator=(ScopedDefault &&other) = delete;
+        ScopedDefault & operator=(ScopedDefault const &) = delete;
+
+    private:
+        BasicFramePool *_previous;
+    };
+
+    [[nodiscard]] static auto * thread_default() { return _thread_default; }
+
+    BasicFramePool() = delete;
+    ~BasicFramePool();
+
+    // The heap must outlive the pool
+    explicit BasicFramePool(HeapType &heap);
+
+    BasicFramePool(BasicFramePool &&other) = delete;
+    BasicFramePool(BasicFramePool const &) = delete;
+
+    BasicFramePool & operator=(BasicFramePool &&other) = delete;
+    BasicFramePool & operator=(BasicFramePool const &) = delete;
+
+private:
+    struct FreeFrame final {
+        FreeFrame *next;
+    };
+
+    // Sits at the start of each chunk's heap allocation, ahead of its frames
+    struct Chunk final {
+        Chunk *next;
+    };
+
+    static std::size_t constexpr _class_count = max_pooled / granularity;
+
+    // Aim for this many bytes of frames per chunk, but never fewer than
+    // _min_chunk_frames frames
+    static std::size_t constexpr _chunk_target = 4096;
+    static std::size_t constexpr _min_chunk_frames = 4;
+
+    HeapType &_heap;
+
+    std::array<FreeFrame *, _class_count> _free { };
+    Chunk *_chunks = nullptr;
+
+    std::size_t _live_frames = 0;
+    std::size_t _chunk_count = 0;
+
+    mutable typename HeapType::lock_policy _lock;
+
+    static inline thread_local BasicFramePool *_thread_default = nullptr;
+
+    [[nodiscard]] static std::size_t _class_index(std::size_t const bytes) {
+        return (bytes + granularity - 1) / granularity - 1;
+    }
+
+    [[nodiscard]] static std::uint8_t * _align_up(std::uint8_t *address) {
+        auto const value = reinterpret_cast<std::uintptr_t>(address);
+        auto const mask = static_cast<std::uintptr_t>(granularity - 1);
+        return reinterpret_cast<std::uint8_t *>((value + mask) & ~mask);
+    }
+
+    [[nodiscard]] bool _carve(std::size_t const class_index);
+
+    [[nodiscard]] void * _alloc_unpooled(std::size_t const bytes);
+    void _free_unpooled(void *address);
+};
+
+using FramePool = BasicFramePool<Heap>;
+
+// Inherit from this in a coroutine's promise_type to put its frames in a
+// pool. The pool is the one passed as the coroutine's leading arguments,
+// std::allocator_arg followed by the pool, as std::generator does it, or
+// else the thread's default pool. With neither, frames come from global new.
+template<typename PoolType>
+class BasicPooledFrame {
+public:
+    static void * operator new(std::size_t const bytes) {
+        return _alloc(bytes, PoolType::thread_default());
+    }
+
+    template<typename... Args>
+    static void * operator new(std::size_t const bytes, std::allocator_arg_t,
+                               PoolType &pool, Args const &...)
+    {
+        return _alloc(bytes, &pool);
+    }
+
+    // Member coroutines see the object they were called on first
+    template<typename Self, typename... Args>
+    static void * operator new(std::size_t const bytes, Self const &,
+                               std::allocator_arg_t, PoolType &pool,
+                               Args const &...)
+    {
+        return _alloc(bytes, &pool);
+    }
+
+    static void operator delete(void *frame, std::size_t const bytes) {
+        auto *prefix = static_cast<Prefix *>(frame) - 1;
+        auto *pool = prefix->pool;
+
+        if(pool == nullptr) {
+            ::operator delete(prefix, bytes + sizeof(Prefix));
+        }
+        else {
+            pool->free(prefix, bytes + sizeof(Prefix));
+        }
+    }
+
+private:
+    // Remembers where the frame came from, since delete isn't told. Padded
+    // so the frame itself stays aligned.
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Prefix final {
+        PoolType *pool;
+    };
+
+    [[nodiscard]] static void * _alloc(std::size_t const bytes,
+                                       PoolType *pool)
+    {
+        auto const total = bytes + sizeof(Prefix);
+
+        auto *prefix = static_cast<Prefix *>(
+            pool == nullptr ? ::operator new(total) : pool->alloc(total)
+        );
+        prefix->pool = pool;
+
+        return prefix + 1;
+    }
+};
+
+using PooledFrame = BasicPooledFrame<FramePool>;
+
+// =============================================================================
+template<typename HeapType>
+BasicFramePool<HeapType>::BasicFramePool(HeapType &heap) :
+    _heap { heap }
+{ }
+
+// =============================================================================
+template<typename HeapType>
+BasicFramePool<HeapType>::~BasicFramePool() {
+    while(_chunks != nullptr) {
+        auto *next = _chunks->next;
+        _heap.free(_chunks);
+        _chunks = next;
+    }
+}
+
+// =============================================================================
+template<typename HeapType>
+void * BasicFramePool<HeapType>::alloc(std::size_t const req_bytes) {
+    if(req_bytes == 0 || req_bytes > max_pooled) {
+        return _alloc_unpooled(req_bytes);
+    }
+
+    auto const class_index = _class_index(req_bytes);
+
+    std::scoped_lock const guard(_lock);
+
+    if(_free[class_index] == nullptr && !_carve(class_index)) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    auto *frame = _free[class_index];
+    _free[class_index] = frame->next;
+    ++_live_frames;
+
+    return frame;
+}
+
+// =============================================================================
+template<typename HeapType>
+void BasicFramePool<HeapType>::free(void *address, std::size_t const bytes) {
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    if(bytes == 0 || bytes > max_pooled) {
+        _free_unpooled(address);
+        return;
+    }
+
+    auto const class_index = _class_index(bytes);
+
+    std::scoped_lock const guard(_lock);
+
+    auto *frame = static_cast<FreeFrame *>(address);
+    frame->next = _free[class_index];
+    _free[class_index] = frame;
+    --_live_frames;
+}
+
+// =============================================================================
+template<typename HeapType>
+bool BasicFramePool<HeapType>::_carve(std::size_t const class_index) {
+    auto const frame_bytes = (class_index + 1) * granularity;
+
+    auto frame_count = _chunk_target / frame_bytes;
+    if(frame_count < _min_chunk_frames) {
+        frame_count = _min_chunk_frames;
+    }
+
+    // The heap may align less strictly than frames need, so leave room to
+    // line the first frame up
+    auto const chunk_bytes = sizeof(Chunk) + granularity - 1
+                           + frame_count * frame_bytes;
+
+    auto *raw = static_cast<std::uint8_t *>(_heap.try_alloc(chunk_bytes));
+    if(raw == nullptr) {
+        return false;
+    }
+
+    auto *chunk = reinterpret_cast<Chunk *>(raw);
+    chunk->next = _chunks;
+    _chunks = chunk;
+    ++_chunk_count;
+
+    // Thread the frames onto the free list so they're handed out in address
+    // order
+    auto *first = _align_up(raw + sizeof(Chunk));
+    for(std::size_t index = frame_count; index > 0; --index) {
+        auto *frame = reinterpret_cast<FreeFrame *>(
+            first + (index - 1) * frame_bytes
+        );
+        frame->next = _free[class_index];
+        _free[class_index] = frame;
+    }
+
+    return true;
+}
+
+// =============================================================================
+template<typename HeapType>
+void * BasicFramePool<HeapType>::_alloc_unpooled(std::size_t const bytes) {
+    // Stash the heap's own pointer just ahead of the aligned frame
+    auto *raw = static_cast<std::uint8_t *>(
+        _heap.alloc(bytes + sizeof(void *) + granularity - 1)
+    );
+
+    auto *frame = _align_up(raw + sizeof(void *));
+    std::memcpy(frame - sizeof(void *), &raw, sizeof(void *));
+
+    std::scoped_lock const guard(_lock);
+    ++_live_frames;
+
+    return frame;
+}
+
+// =============================================================================
+template<typename HeapType>
+void BasicFramePool<HeapType>::_free_unpooled(void *address) {
+    void *raw = nullptr;
+    std::memcpy(&raw, static_cast<std::uint8_t *>(address) - sizeof(void *),
+                sizeof(void *));
+
+    _heap.free(raw);
+
+    std::scoped_lock const guard(_lock);
+    --_live_frames;
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_FRAMEPOOL_HPP
@@ -0,0 +1,119 @@
+#ifndef BRASSTACKS_MEMORY_FREELIST_HPP
+#define BRASSTACKS_MEMORY_FREELIST_HPP
+
+#include <cstdint>
+
+// The address-ordered, doubly linked free list that BasicHeap and SharedHeap
+// both keep. Block is any header with size, next and prev, where size counts
+// the payload after the header. The links, and the list's head and tail, can
+// be plain pointers or RelativeLinks; they're only ever read and assigned as
+// pointers.
+//
+// Only the links are touched here. Callers keep their own stats, and tell
+// their fit policy about each change in whatever order it expects.
+namespace btx::memory::free_list {
+
+// Whether next starts right where header's payload ends
+template<typename Block>
+[[nodiscard]] bool adjacent(Block const *header, Block const *next) {
+    return reinterpret_cast<std::uint8_t const *>(header + 1) + header->size
+        == reinterpret_cast<std::uint8_t const *>(next);
+}
+
+// Link header in after the last block with a lower address, which keeps the
+// list sorted
+template<typename Block, typename End>
+void insert(End &head, End &tail, Block *header) {
+    Block *current_header = head;
+
+    if(current_header == nullptr || header < current_header) {
+        header->next = current_header;
+        header->prev = nullptr;
+
+        if(current_header != nullptr) {
+            current_header->prev = header;
+        }
+        else {
+            tail = header;
+        }
+
+        head = header;
+        return;
+    }
+
+    while(current_header->next != nullptr && current_header->next < header) {
+        current_header = current_header->next;
+    }
+
+    header->next = current_header->next;
+    header->prev = current_header;
+
+    if(header->next != nullptr) {
+        header->next->prev = header;
+    }
+    else {
+        tail = header;
+    }
+
+    current_header->next = header;
+}
+
+// Take header off the list, leaving its own links cleared
+template<typename Block, typename End>
+void unlink(End &head, End &tail, Block *header) {
+    if(header->next != nullptr) {
+        header->next->prev = header->prev;
+    }
+    else {
+        tail = header->prev;
+    }
+
+    if(header->prev != nullptr) {
+        header->prev->next = header->next;
+    }
+    else {
+        head = header->next;
+    }
+
+    header->next = nullptr;
+    header->prev = nullptr;
+}
+
+// Put new_header in old_header's place, between the same neighbours. A split
+// does this with what's left over once the front of a block is handed out.
+template<typename Block, typename End>
+void replace(End &head, End &tail, Block *old_header, Block *new_header) {
+    new_header->next = old_header->next;
+    new_header->prev = old_header->prev;
+
+    if(new_header->next != nullptr) {
+        new_header->next->prev = new_header;
+    }
+    else {
+        tail = new_header;
+    }
+
+    if(new_header->prev != nullptr) {
+        new_header->prev->next = new_header;
+    }
+    else {
+        head = new_header;
+    }
+
+    old_header->next = nullptr;
+    old_header->prev = nullptr;
+}
+
+// Grow header over the block that follows it on the list, which must be
+// adjacent, header and all
+template<typename Block, typename End>
+void absorb_next(End &head, End &tail, Block *header) {
+    Block *next_header = header->next;
+
+    header->size += sizeof(Block) + next_header->size;
+    unlink(head, tail, next_header);
+}
+
+} // namespace btx::memory::free_list
+
+#endif // BRASSTACKS_MEMORY_FREELIST_HPP
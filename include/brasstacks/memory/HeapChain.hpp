@@ -0,0 +1,130 @@
+#ifndef BRASSTACKS_MEMORY_HEAPCHAIN_HPP
+#define BRASSTACKS_MEMORY_HEAPCHAIN_HPP
+
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/LargeBlockList.hpp"
+
+#include <mutex>
+#include <vector>
+
+namespace btx::memory {
+
+// Tries each of a list of heaps in turn, so a small, hot primary heap can stay
+// dense and cache-resident while rare spikes spill into larger secondary
+// heaps. Anything none of them can satisfy gets its own pages straight from
+// the OS, which are handed back as soon as that allocation is freed.
+//
+// The chain doesn't own its heaps, and they must outlive it. Heaps are tried
+// in the order they were added, and should all be added before the chain is
+// shared between threads.
+template<typename HeapType>
+class BasicHeapChain final {
+public:
+    void add(HeapType &heap) { _heaps.push_back(&heap); }
+
+    // Only fails if the OS refuses to map more pages, in which case alloc()
+    // aborts and try_alloc() returns nullptr
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes);
+
+    void free(void *address);
+
+    [[nodiscard]] auto heap_count() const { return _heaps.size(); }
+
+    // Bytes currently mapped for overflow allocations, headers included, and
+    // how many allocations those mappings hold
+    [[nodiscard]] auto overflow_used() const {
+        std::scoped_lock const guard(_overflow_lock);
+        return _overflow.used();
+    }
+
+    [[nodiscard]] auto overflow_allocs() const {
+        std::scoped_lock const guard(_overflow_lock);
+        return _overflow.count();
+    }
+
+    BasicHeapChain() = default;
+    ~BasicHeapChain() = default;
+
+    // With overflow turned off, try_alloc() fails once every heap is full
+    explicit BasicHeapChain(HeapType &primary, bool const overflow = true);
+
+    BasicHeapChain(BasicHeapChain &&other) = delete;
+    BasicHeapChain(BasicHeapChain const &) = delete;
+
+    BasicHeapChain & operator=(BasicHeapChain &&other) = delete;
+    BasicHeapChain & operator=(BasicHeapChain const &) = delete;
+
+private:
+    std::vector<HeapType *> _heaps;
+
+    bool _overflow_enabled = true;
+
+    // Releases whatever's left when the chain is destroyed
+    LargeBlockList _overflow;
+    mutable typename HeapType::lock_policy _overflow_lock;
+};
+
+using HeapChain = BasicHeapChain<Heap>;
+
+// =============================================================================
+template<typename HeapType>
+BasicHeapChain<HeapType>::BasicHeapChain(HeapType &primary,
+                                         bool const overflow) :
+    _overflow_enabled { overflow }
+{
+    add(primary);
+}
+
+// =============================================================================
+template<typename HeapType>
+void * BasicHeapChain<HeapType>::alloc(std::size_t const req_bytes) {
+    void *address = try_alloc(req_bytes);
+
+    if(address == nullptr) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    return address;
+}
+
+// =============================================================================
+template<typename HeapType>
+void * BasicHeapChain<HeapType>::try_alloc(std::size_t const req_bytes) {
+    for(auto *heap : _heaps) {
+        void *address = heap->try_alloc(req_bytes);
+        if(address != nullptr) {
+            return address;
+        }
+    }
+
+    if(!_overflow_enabled) {
+        return nullptr;
+    }
+
+    std::scoped_lock const guard(_overflow_lock);
+    return _overflow.alloc(req_bytes);
+}
+
+// =============================================================================
+template<typename HeapType>
+void BasicHeapChain<HeapType>::free(void *address) {
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    for(auto *heap : _heaps) {
+        if(heap->owns(address)) {
+            heap->free(address);
+            return;
+        }
+    }
+
+    // If none of the heaps claim it, it must be an overflow allocation
+    std::scoped_lock const guard(_overflow_lock);
+    _overflow.free(address);
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_HEAPCHAIN_HPP
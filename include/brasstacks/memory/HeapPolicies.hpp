@@ -0,0 +1,600 @@
+#ifndef BRASSTACKS_MEMORY_HEAPPOLICIES_HPP
+#define BRASSTACKS_MEMORY_HEAPPOLICIES_HPP
+
+#include "brasstacks/memory/BlockHeader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+#endif
+
+namespace btx::memory {
+
+// =============================================================================
+// Fit policies
+//
+// A fit policy decides which free block satisfies an allocation. BasicHeap
+// owns the address-ordered free list and calls back into the policy every
+// time that list changes, so policies that keep their own view of the free
+// blocks can stay in sync:
+//
+//   init(free_head, bytes) the list was (re)built from scratch, for a heap
+//                          of bytes in total
+//   on_insert(header)      header was just linked into the list
+//   on_remove(header)      header is about to be unlinked, links still valid
+//   on_replace(old, new)   a split moved old's remaining space to new
+//   on_resize(header, old) header grew in place from old bytes
+//   on_top_alloc()         an allocation was bumped off the top chunk
+//
+// The top chunk is the never-used space at the end of the heap. It isn't on
+// the free list, and is normally only tried once nothing on the list fits,
+// unless prefers_top() says otherwise.
+//
+// Every hook but init() runs in the middle of an alloc() or free(), so none of
+// them may allocate or throw. Anything that needs room for every free block
+// sizes it in init().
+//
+// min_payload is the smallest payload the policy needs in every free block.
+// =============================================================================
+
+namespace detail {
+
+// A block can satisfy a request if it fits exactly, or if there's room to
+// carve a new header out of whatever's left over
+[[nodiscard]] inline bool block_fits(BlockHeader const *header,
+                                     std::size_t const bytes)
+{
+    return header->size == bytes
+        || header->size >= bytes + sizeof(BlockHeader);
+}
+
+inline void cpu_relax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// The index of the first size that's either exactly exact or at least split,
+// or count if there isn't one. Uses the widest vector instructions the CPU
+// running it supports, chosen on first use. See FitScan.cpp.
+[[nodiscard]] std::size_t find_fit_index(std::uint32_t const *sizes,
+                                         std::size_t const count,
+                                         std::uint32_t const exact,
+                                         std::uint32_t const split);
+
+// The same search, one element at a time
+[[nodiscard]] std::size_t find_fit_index_scalar(std::uint32_t const *sizes,
+                                                std::size_t const count,
+                                                std::uint32_t const exact,
+                                                std::uint32_t const split);
+
+// Which of the above find_fit_index() settled on: "avx2", "sse4.1" or
+// "scalar"
+[[nodiscard]] char const * fit_scan_kernel();
+
+} // namespace detail
+
+// Take the lowest-addressed block that fits
+class FirstFit final {
+public:
+    static constexpr char const *name = "first-fit";
+    static std::size_t constexpr min_payload = 0;
+
+    [[nodiscard]] static BlockHeader * find(BlockHeader *free_head,
+                                            std::size_t const bytes)
+    {
+        auto *current_header = free_head;
+        while(current_header != nullptr) {
+            if(detail::block_fits(current_header, bytes)) {
+                break;
+            }
+            current_header = current_header->next;
+        }
+
+        return current_header;
+    }
+
+    static void init([[maybe_unused]] BlockHeader *free_head,
+                     [[maybe_unused]] std::size_t const heap_bytes) { }
+    static void on_insert([[maybe_unused]] BlockHeader *header) { }
+    static void on_remove([[maybe_unused]] BlockHeader *header) { }
+    static void on_replace([[maybe_unused]] BlockHeader *old_header,
+                           [[maybe_unused]] BlockHeader *new_header) { }
+    static void on_resize([[maybe_unused]] BlockHeader *header,
+                          [[maybe_unused]] std::size_t const old_size) { }
+
+    static bool prefers_top() { return false; }
+    static void on_top_alloc() { }
+};
+
+// First-fit, but searching a packed, address-ordered copy of the free blocks'
+// sizes instead of chasing the list. The sizes are clamped to 32 bits so
+// eight fit in an AVX2 register, which is harmless for any request small
+// enough to be told apart from the clamp; larger requests walk the list.
+//
+// The copy is held in arrays big enough for the most free blocks the heap
+// could ever have, allocated once by init(). The OS only backs the pages
+// that get used, so a large heap with few free blocks costs little more.
+class IndexedFirstFit final {
+public:
+    static constexpr char const *name = "indexed-first-fit";
+    static std::size_t constexpr min_payload = 0;
+
+    [[nodiscard]] BlockHeader * find(BlockHeader *free_head,
+                                     std::size_t const bytes) const
+    {
+        if(bytes + sizeof(BlockHeader) > _size_limit) {
+            return FirstFit::find(free_head, bytes);
+        }
+
+        auto const index = detail::find_fit_index(
+            _sizes.get(), _count,
+            static_cast<std::uint32_t>(bytes),
+            static_cast<std::uint32_t>(bytes + sizeof(BlockHeader))
+        );
+
+        return index < _count ? _headers[index] : nullptr;
+    }
+
+    // Free blocks never sit side by side, so each one and the block in use
+    // after it take at least two headers' worth of the heap, and the last
+    // may be followed by nothing at all
+    void init(BlockHeader *free_head, std::size_t const heap_bytes) {
+        auto const capacity = heap_bytes / (2 * sizeof(BlockHeader)) + 1;
+        if(capacity > _capacity) {
+            _sizes = std::make_unique_for_overwrite<std::uint32_t[]>(capacity);
+            _headers =
+                std::make_unique_for_overwrite<BlockHeader *[]>(capacity);
+            _capacity = capacity;
+        }
+
+        _count = 0;
+        for(auto *current_header = free_head; current_header != nullptr;
+            current_header = current_header->next)
+        {
+            _sizes[_count] = _clamp(current_header->size);
+            _headers[_count] = current_header;
+            ++_count;
+        }
+    }
+
+    void on_insert(BlockHeader *header) noexcept {
+        auto const index = _index(header);
+
+        std::copy_backward(_headers.get() + index, _headers.get() + _count,
+                           _headers.get() + _count + 1);
+        std::copy_backward(_sizes.get() + index, _sizes.get() + _count,
+                           _sizes.get() + _count + 1);
+
+        _headers[index] = header;
+        _sizes[index] = _clamp(header->size);
+        ++_count;
+    }
+
+    void on_remove(BlockHeader *header) noexcept {
+        auto const index = _index(header);
+
+        std::copy(_headers.get() + index + 1, _headers.get() + _count,
+                  _headers.get() + index);
+        std::copy(_sizes.get() + index + 1, _sizes.get() + _count,
+                  _sizes.get() + index);
+        --_count;
+    }
+
+    // A split's remainder sits between the same neighbours as the original
+    void on_replace(BlockHeader *old_header, BlockHeader *new_header) noexcept
+    {
+        auto const index = _index(old_header);
+
+        _headers[index] = new_header;
+        _sizes[index] = _clamp(new_header->size);
+    }
+
+    void on_resize(BlockHeader *header,
+                   [[maybe_unused]] std::size_t const old_size) noexcept
+    {
+        _sizes[_index(header)] = _clamp(header->size);
+    }
+
+    static bool prefers_top() { return false; }
+    static void on_top_alloc() { }
+
+private:
+    static std::size_t constexpr _size_limit =
+        std::numeric_limits<std::uint32_t>::max();
+
+    std::unique_ptr<std::uint32_t[]> _sizes;
+    std::unique_ptr<BlockHeader *[]> _headers;
+    std::size_t _count = 0;
+    std::size_t _capacity = 0;
+
+    [[nodiscard]] static std::uint32_t _clamp(std::size_t const size) {
+        return static_cast<std::uint32_t>(std::min(size, _size_limit));
+    }
+
+    [[nodiscard]] std::size_t _index(BlockHeader *header) const {
+        return static_cast<std::size_t>(
+            std::lower_bound(_headers.get(), _headers.get() + _count, header)
+            - _headers.get()
+        );
+    }
+};
+
+// Take the smallest block that fits, stopping early on an exact match
+class BestFit final {
+public:
+    static constexpr char const *name = "best-fit";
+    static std::size_t constexpr min_payload = 0;
+
+    [[nodiscard]] static BlockHeader * find(BlockHeader *free_head,
+                                            std::size_t const bytes)
+    {
+        BlockHeader *best_header = nullptr;
+
+        for(auto *current_header = free_head; current_header != nullptr;
+            current_header = current_header->next)
+        {
+            if(!detail::block_fits(current_header, bytes)) {
+                continue;
+            }
+
+            if(current_header->size == bytes) {
+                return current_header;
+            }
+
+            if(best_header == nullptr
+               || current_header->size < best_header->size)
+            {
+                best_header = current_header;
+            }
+        }
+
+        return best_header;
+    }
+
+    static void init([[maybe_unused]] BlockHeader *free_head,
+                     [[maybe_unused]] std::size_t const heap_bytes) { }
+    static void on_insert([[maybe_unused]] BlockHeader *header) { }
+    static void on_remove([[maybe_unused]] BlockHeader *header) { }
+    static void on_replace([[maybe_unused]] BlockHeader *old_header,
+                           [[maybe_unused]] BlockHeader *new_header) { }
+    static void on_resize([[maybe_unused]] BlockHeader *header,
+                          [[maybe_unused]] std::size_t const old_size) { }
+
+    static bool prefers_top() { return false; }
+    static void on_top_alloc() { }
+};
+
+// First-fit, but resume searching from wherever the last search succeeded
+// rather than from the head of the list, wrapping around at the end
+class NextFit final {
+public:
+    static constexpr char const *name = "next-fit";
+    static std::size_t constexpr min_payload = 0;
+
+    [[nodiscard]] BlockHeader * find(BlockHeader *free_head,
+                                     std::size_t const bytes)
+    {
+        auto *start = _rover != nullptr ? _rover : free_head;
+
+        for(auto *current_header = start; current_header != nullptr;
+            current_header = current_header->next)
+        {
+            if(detail::block_fits(current_header, bytes)) {
+                _rover = current_header;
+                _at_top = false;
+                return current_header;
+            }
+        }
+
+        for(auto *current_header = free_head; current_header != start;
+            current_header = current_header->next)
+        {
+            if(detail::block_fits(current_header, bytes)) {
+                _rover = current_header;
+                _at_top = false;
+                return current_header;
+            }
+        }
+
+        return nullptr;
+    }
+
+    [[nodiscard]] BlockHeader * rover() const { return _rover; }
+
+    // Whether the last search succeeded in the heap's top chunk, which is
+    // where the next one starts
+    [[nodiscard]] bool prefers_top() const { return _at_top; }
+
+    void init([[maybe_unused]] BlockHeader *free_head,
+              [[maybe_unused]] std::size_t const heap_bytes)
+    {
+        _rover = nullptr;
+        _at_top = false;
+    }
+
+    static void on_insert([[maybe_unused]] BlockHeader *header) { }
+
+    void on_remove(BlockHeader *header) {
+        // Carry on from the block that followed, or from the head if the
+        // rover was at the end of the list
+        if(_rover == header) {
+            _rover = header->next;
+        }
+    }
+
+    void on_replace(BlockHeader *old_header, BlockHeader *new_header) {
+        if(_rover == old_header) {
+            _rover = new_header;
+        }
+    }
+
+    static void on_resize([[maybe_unused]] BlockHeader *header,
+                          [[maybe_unused]] std::size_t const old_size) { }
+
+    void on_top_alloc() {
+        _rover = nullptr;
+        _at_top = true;
+    }
+
+private:
+    BlockHeader *_rover = nullptr;
+    bool _at_top = false;
+};
+
+// Free blocks are also kept in one bin per power of two, with the bin links
+// living in the free blocks' own payloads. Searches start in the request's own
+// bin and move up through non-empty bins, so most of the list is never touched.
+class SegregatedFit final {
+public:
+    static constexpr char const *name = "segregated-fit";
+
+private:
+    struct BinLinks final {
+        BlockLink next;
+        BlockLink prev;
+    };
+
+public:
+    static std::size_t constexpr min_payload = sizeof(BinLinks);
+
+    [[nodiscard]] BlockHeader * find([[maybe_unused]] BlockHeader *free_head,
+                                     std::size_t const bytes) const
+    {
+        // Skip straight past any empty bins smaller than the request
+        auto candidates = _occupied & (~std::uint64_t { 0 } << _bin(bytes));
+
+        while(candidates != 0) {
+            auto const bin =
+                static_cast<std::size_t>(std::countr_zero(candidates));
+
+            for(auto *current_header = _bins[bin]; current_header != nullptr;
+                current_header = _links(current_header).next)
+            {
+                if(detail::block_fits(current_header, bytes)) {
+                    return current_header;
+                }
+            }
+
+            candidates &= candidates - 1;
+        }
+
+        return nullptr;
+    }
+
+    void init(BlockHeader *free_head,
+              [[maybe_unused]] std::size_t const heap_bytes)
+    {
+        _bins.fill(nullptr);
+        _occupied = 0;
+
+        for(auto *current_header = free_head; current_header != nullptr;
+            current_header = current_header->next)
+        {
+            on_insert(current_header);
+        }
+    }
+
+    void on_insert(BlockHeader *header) {
+        // Blocks too small to carry their own links are left out; the heap
+        // rounds requests up so these can't satisfy anything anyway
+        if(header->size < min_payload) {
+            return;
+        }
+
+        auto const bin = _bin(header->size);
+        auto &links = _links(header);
+
+        links.prev = nullptr;
+        links.next = _bins[bin];
+
+        if(links.next != nullptr) {
+            _links(links.next).prev = header;
+        }
+
+        _bins[bin] = header;
+        _occupied |= std::uint64_t { 1 } << bin;
+    }
+
+    void on_remove(BlockHeader *header) {
+        _unbin(header, header->size);
+    }
+
+    void on_replace(BlockHeader *old_header, BlockHeader *new_header) {
+        on_remove(old_header);
+        on_insert(new_header);
+    }
+
+    void on_resize(BlockHeader *header, std::size_t const old_size) {
+        _unbin(header, old_size);
+        on_insert(header);
+    }
+
+    static bool prefers_top() { return false; }
+    static void on_top_alloc() { }
+
+private:
+    std::array<BlockHeader *, 64> _bins { };
+    std::uint64_t _occupied = 0;
+
+    [[nodiscard]] static std::size_t _bin(std::size_t const bytes) {
+        return bytes == 0
+             ? 0
+             : static_cast<std::size_t>(std::bit_width(bytes)) - 1;
+    }
+
+    [[nodiscard]] static BinLinks & _links(BlockHeader *header) {
+        return *static_cast<BinLinks *>(BlockHeader::payload(header));
+    }
+
+    void _unbin(BlockHeader *header, std::size_t const size) {
+        if(size < min_payload) {
+            return;
+        }
+
+        auto const bin = _bin(size);
+        auto &links = _links(header);
+
+        if(links.next != nullptr) {
+            _links(links.next).prev = links.prev;
+        }
+
+        if(links.prev != nullptr) {
+            _links(links.prev).next = links.next;
+        }
+        else {
+            _bins[bin] = links.next;
+        }
+
+        if(_bins[bin] == nullptr) {
+            _occupied &= ~(std::uint64_t { 1 } << bin);
+        }
+    }
+};
+
+// =============================================================================
+// Lock policies
+//
+// Anything with lock(), try_lock() and unlock() will do. BasicHeap takes the
+// lock for the duration of every alloc(), free() and free list walk.
+// =============================================================================
+
+// Single-threaded heaps pay nothing
+class NoLock final {
+public:
+    static constexpr char const *name = "unlocked";
+
+    static void lock() { }
+    static bool try_lock() { return true; }
+    static void unlock() { }
+};
+
+class MutexLock final {
+public:
+    static constexpr char const *name = "mutex";
+
+    void lock() { _mutex.lock(); }
+    bool try_lock() { return _mutex.try_lock(); }
+    void unlock() { _mutex.unlock(); }
+
+private:
+    std::mutex _mutex;
+};
+
+// Test-and-test-and-set, for heaps whose critical sections are short enough
+// that sleeping would cost more than spinning
+class SpinLock final {
+public:
+    static constexpr char const *name = "spin";
+
+    void lock() {
+        while(_locked.exchange(true, std::memory_order_acquire)) {
+            while(_locked.load(std::memory_order_relaxed)) {
+                detail::cpu_relax();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !_locked.load(std::memory_order_relaxed)
+            && !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { _locked.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool> _locked { false };
+};
+
+// =============================================================================
+// Stats policies
+//
+// BasicHeap reports every change in bytes used and live allocation count.
+// With NoStats these calls are empty, and the heap's stats accessors are
+// unavailable.
+// =============================================================================
+
+class HeapStats final {
+public:
+    static constexpr bool enabled = true;
+
+    void on_used(std::size_t const bytes) {
+        _current_used += bytes;
+        if(_current_used > _peak_used) {
+            _peak_used = _current_used;
+        }
+    }
+
+    void on_released(std::size_t const bytes) { _current_used -= bytes; }
+
+    void on_alloc() {
+        _current_allocs += 1;
+        if(_current_allocs > _peak_allocs) {
+            _peak_allocs = _current_allocs;
+        }
+    }
+
+    void on_free() { _current_allocs -= 1; }
+
+    // Forget everything that's live, but remember the peaks
+    void reset_current() {
+        _current_used = 0;
+        _current_allocs = 0;
+    }
+
+    [[nodiscard]] auto current_used()   const { return _current_used;   }
+    [[nodiscard]] auto current_allocs() const { return _current_allocs; }
+    [[nodiscard]] auto peak_used()      const { return _peak_used;      }
+    [[nodiscard]] auto peak_allocs()    const { return _peak_allocs;    }
+
+private:
+    std::size_t _current_used = 0;
+    std::size_t _current_allocs = 0;
+    std::size_t _peak_used = 0;
+    std::size_t _peak_allocs = 0;
+};
+
+class NoStats final {
+public:
+    static constexpr bool enabled = false;
+
+    static void on_used([[maybe_unused]] std::size_t const bytes) { }
+    static void on_released([[maybe_unused]] std::size_t const bytes) { }
+    static void on_alloc() { }
+    static void on_free() { }
+    static void reset_current() { }
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_HEAPPOLICIES_HPP
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef BRASSTACKS_MEMORY_HEAPSNAPSHOT_HPP
+#define BRASSTACKS_MEMORY_HEAPSNAPSHOT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace btx::memory {
+
+// Selects BasicHeap's snapshot-restoring constructor:
+//
+//     Heap heap(FromSnapshot { "world.heap" });
+//     Heap fixed(FromSnapshot { "world.heap", true });
+struct FromSnapshot final {
+    char const *path;
+
+    // Abort rather than relocate if the file can't be mapped back exactly
+    // where the heap was saved
+    bool at_saved_address = false;
+};
+
+// A snapshot file is this header followed by an image of the heap's storage,
+// which starts at a multiple of the header's own alignment so the image can
+// be mapped straight back in
+struct alignas(64) SnapshotHeader final {
+    // How the free list's links were stored, which a restoring build must
+    // share: see BTX_MEMORY_RELATIVE_LINKS in BlockHeader.hpp
+    static std::uint32_t constexpr pointer_links = 1;
+    static std::uint32_t constexpr relative_links = 2;
+
+    std::array<char, 8> magic { 'B', 'T', 'X', 'H', 'E', 'A', 'P', '\0' };
+    std::uint32_t version = 4;
+    std::uint32_t header_size = 0;  // sizeof(BlockHeader)
+    std::uint32_t pointer_size = 0; // sizeof(void *)
+#ifdef BTX_MEMORY_RELATIVE_LINKS
+    std::uint32_t link_mode = relative_links;
+#else
+    std::uint32_t link_mode = pointer_links;
+#endif
+    std::uint64_t alignment = 0;    // The heap's payload alignment
+
+    std::uint64_t base = 0;       // Where the image lived when it was saved
+    std::uint64_t total_size = 0; // Bytes in the image
+    std::uint64_t free_head = 0;  // Offset into the image, or no_free_head
+    std::uint64_t top = 0;        // Offset of the heap's top chunk
+    std::uint64_t top_end = 0;    // Offset of the end of the top chunk
+
+    std::uint64_t stats_size = 0;
+    std::array<std::byte, 48> stats { };
+
+    static std::uint64_t constexpr no_free_head = ~std::uint64_t { 0 };
+};
+
+static_assert(sizeof(SnapshotHeader) == 128);
+
+namespace detail {
+
+// Reads and checks everything in a snapshot's header that doesn't depend on
+// the type of heap restoring it. Aborts if the file can't be used.
+[[nodiscard]] SnapshotHeader read_snapshot_header(char const *path);
+
+void report_snapshot_error(char const *path, char const *reason);
+[[noreturn]] void report_snapshot_failure(char const *path,
+                                          char const *reason);
+
+} // namespace detail
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_HEAPSNAPSHOT_HPP
@@ -0,0 +1,72 @@
+#ifndef BRASSTACKS_MEMORY_LARGEBLOCKLIST_HPP
+#define BRASSTACKS_MEMORY_LARGEBLOCKLIST_HPP
+
+#include "brasstacks/memory/BlockHeader.hpp"
+
+#include <cstddef>
+
+namespace btx::memory {
+
+// Blocks that each get their own pages from the OS. Every block still starts
+// with a BlockHeader, flagged as large, whose size covers the rest of its
+// pages; the headers' links keep the live blocks in a list so whatever's left
+// can be released when the list is destroyed.
+//
+// The list does no locking of its own.
+class LargeBlockList final {
+public:
+    // Returns nullptr if the OS won't map any more pages
+    [[nodiscard]] void * alloc(std::size_t const bytes);
+
+    // Returns nullptr on failure, leaving the original block intact
+    [[nodiscard]] void * realloc(void *address, std::size_t const bytes);
+
+    void free(void *address);
+
+    // Release every block at once
+    void clear();
+
+    // Walks the list, so this is only cheap while there are few blocks
+    [[nodiscard]] bool owns(void const *address) const;
+
+    // Calls visit() with the header of every live block
+    template<typename Visit>
+    void for_each(Visit &&visit) const {
+        for(auto *current_header = _head; current_header != nullptr;
+            current_header = current_header->next)
+        {
+            visit(current_header);
+        }
+    }
+
+    [[nodiscard]] static bool is_large(void *address) {
+        return (BlockHeader::header(address)->flags
+                & BlockHeader::flag_large) != 0;
+    }
+
+    // Bytes currently mapped, headers included, and how many blocks that is
+    [[nodiscard]] auto used()  const { return _used;  }
+    [[nodiscard]] auto count() const { return _count; }
+
+    LargeBlockList() = default;
+    ~LargeBlockList();
+
+    LargeBlockList(LargeBlockList &&other) = delete;
+    LargeBlockList(LargeBlockList const &) = delete;
+
+    LargeBlockList & operator=(LargeBlockList &&other) = delete;
+    LargeBlockList & operator=(LargeBlockList const &) = delete;
+
+private:
+    BlockHeader *_head = nullptr;
+
+    std::size_t _used = 0;
+    std::size_t _count = 0;
+
+    void _link(BlockHeader *header);
+    void _unlink(BlockHeader *header);
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_LARGEBLOCKLIST_HPP
@@ -0,0 +1,101 @@
+#ifndef BRASSTACKS_MEMORY_LATENCYHISTOGRAM_HPP
+#define BRASSTACKS_MEMORY_LATENCYHISTOGRAM_HPP
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #define BTX_MEMORY_HAS_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BTX_MEMORY_HAS_RDTSC
+#endif
+
+namespace btx::memory {
+
+// A cheap, monotonic tick count for timing individual heap operations. On x86
+// this is the time stamp counter; everywhere else it's steady_clock in
+// nanoseconds. Use latency_ticks_per_ns() to convert.
+[[nodiscard]] inline std::uint64_t latency_ticks() {
+#if defined(BTX_MEMORY_HAS_RDTSC)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count()
+    );
+#endif
+}
+
+// Measured once on first call, which takes a few milliseconds
+[[nodiscard]] double latency_ticks_per_ns();
+
+// A log-linear histogram in the style of HdrHistogram. Values below 64 are
+// counted exactly, and every power of two above that is split into 32 equal
+// sub-buckets, so any value reported is within about 3% of the true value.
+class LatencyHistogram final {
+public:
+    void record(std::uint64_t const ticks) {
+        ++_buckets[_bucket_index(ticks)];
+        ++_count;
+        _total += ticks;
+
+        if(ticks > _max) {
+            _max = ticks;
+        }
+    }
+
+    // The smallest recorded value that at least the given fraction (0 to 1)
+    // of all samples are at or below, to within a sub-bucket
+    [[nodiscard]] std::uint64_t percentile(double const fraction) const;
+
+    [[nodiscard]] auto p50()  const { return percentile(0.5);   }
+    [[nodiscard]] auto p99()  const { return percentile(0.99);  }
+    [[nodiscard]] auto p999() const { return percentile(0.999); }
+
+    [[nodiscard]] auto count() const { return _count; }
+    [[nodiscard]] auto max()   const { return _max;   }
+    [[nodiscard]] double mean() const;
+
+    void reset();
+
+private:
+    static std::size_t constexpr _sub_bucket_bits = 5;
+    static std::size_t constexpr _sub_bucket_count = 1u << _sub_bucket_bits;
+
+    // Two sets of sub-buckets cover [0, 64) linearly, then there's one more
+    // set for each power of two from 64 up to the top of a 64-bit value
+    static std::size_t constexpr _bucket_count =
+        (64 - _sub_bucket_bits + 1) * _sub_bucket_count;
+
+    std::array<std::uint64_t, _bucket_count> _buckets { };
+
+    std::uint64_t _count = 0;
+    std::uint64_t _total = 0;
+    std::uint64_t _max = 0;
+
+    [[nodiscard]] static std::size_t _bucket_index(std::uint64_t const value) {
+        if(value < 2 * _sub_bucket_count) {
+            return static_cast<std::size_t>(value);
+        }
+
+        // Shift the value down until it lands in [32, 64), then index the
+        // sub-bucket within that power of two
+        auto const magnitude = static_cast<std::size_t>(std::bit_width(value))
+                             - (_sub_bucket_bits + 1);
+        auto const sub_bucket = static_cast<std::size_t>(value >> magnitude);
+
+        return (magnitude + 1) * _sub_bucket_count
+             + (sub_bucket - _sub_bucket_count);
+    }
+
+    [[nodiscard]] static std::uint64_t _bucket_high(std::size_t const index);
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_LATENCYHISTOGRAM_HPP
\ No newline at end of file
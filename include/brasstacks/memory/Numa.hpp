@@ -0,0 +1,24 @@
+#ifndef BRASSTACKS_MEMORY_NUMA_HPP
+#define BRASSTACKS_MEMORY_NUMA_HPP
+
+#include <cstddef>
+
+// Just enough NUMA topology to place memory near the threads using it. Where
+// the platform has no notion of nodes, everything is node zero.
+namespace btx::memory::numa {
+
+// One more than the highest node number the system could bring online
+[[nodiscard]] std::size_t node_count();
+
+// The node of the CPU the calling thread is running on right now
+[[nodiscard]] std::size_t current_node();
+
+// Map zeroed, readable and writable pages, asking for them to be placed on
+// the given node. Where that can't be arranged the pages are still mapped,
+// and end up wherever the first thread to touch them is. Release them with
+// vm::unmap(). Returns nullptr on failure.
+[[nodiscard]] void * map(std::size_t const bytes, std::size_t const node);
+
+} // namespace btx::memory::numa
+
+#endif // BRASSTACKS_MEMORY_NUMA_HPP
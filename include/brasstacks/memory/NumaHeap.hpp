@@ -0,0 +1,247 @@
+#ifndef BRASSTACKS_MEMORY_NUMAHEAP_HPP
+#define BRASSTACKS_MEMORY_NUMAHEAP_HPP
+
+#include "brasstacks/memory/BasicHeap.hpp"
+#include "brasstacks/memory/HeapPolicies.hpp"
+#include "brasstacks/memory/Numa.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+
+namespace btx::memory {
+
+// One heap per NUMA node, each over pages placed on its node, with every
+// allocation served by the heap local to the calling thread. A node's heap is
+// created by the first thread to allocate from that node, which also touches
+// each of its pages. That places them even where the OS ignores the request
+// made when mapping them. If the local heap is full, allocations spill into
+// other nodes' heaps before failing. Frees go back to whichever heap owns the
+// address, from any thread.
+//
+// On a machine with a single node, or one without NUMA support, this is just
+// one heap. The heaps are shared between threads, so HeapType needs a lock
+// policy other than NoLock.
+template<typename HeapType>
+class BasicNumaHeap final {
+public:
+    // Only fails if every heap this process has touched is full, in which
+    // case alloc() aborts and try_alloc() returns nullptr
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes);
+
+    void free(void *address);
+
+    [[nodiscard]] bool owns(void const *address) const;
+
+    [[nodiscard]] auto node_count()     const { return _node_count;     }
+    [[nodiscard]] auto bytes_per_node() const { return _bytes_per_node; }
+
+    // The heap serving a node, for its stats, or nullptr if no thread has
+    // allocated from that node yet
+    [[nodiscard]] HeapType const * arena(std::size_t const node) const {
+        return _arenas[node].heap.load(std::memory_order_acquire);
+    }
+
+    // Allocations served by a node's heap for threads on that node, and for
+    // threads whose own node's heap was full
+    [[nodiscard]] auto local_allocs(std::size_t const node) const {
+        return _arenas[node].local_allocs.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto spilled_allocs(std::size_t const node) const {
+        return _arenas[node].spilled_allocs.load(std::memory_order_relaxed);
+    }
+
+    // Frees of a node's allocations made by threads on some other node
+    [[nodiscard]] auto remote_frees(std::size_t const node) const {
+        return _arenas[node].remote_frees.load(std::memory_order_relaxed);
+    }
+
+    BasicNumaHeap() = delete;
+    ~BasicNumaHeap();
+
+    // Nothing is mapped until a thread on each node first allocates
+    explicit BasicNumaHeap(std::size_t const bytes_per_node);
+
+    BasicNumaHeap(BasicNumaHeap &&other) = delete;
+    BasicNumaHeap(BasicNumaHeap const &) = delete;
+
+    BasicNumaHeap & operator=(BasicNumaHeap &&other) = delete;
+    BasicNumaHeap & operator=(BasicNumaHeap const &) = delete;
+
+private:
+    // Each on its own cache line, since their counters are bumped by every
+    // thread on that node
+    struct alignas(64) Arena final {
+        std::once_flag created;
+        std::atomic<HeapType *> heap { nullptr };
+
+        std::unique_ptr<HeapType> owner;
+        void *memory = nullptr;
+
+        std::atomic<std::size_t> local_allocs { 0 };
+        std::atomic<std::size_t> spilled_allocs { 0 };
+        std::atomic<std::size_t> remote_frees { 0 };
+    };
+
+    std::size_t const _node_count;
+    std::size_t const _bytes_per_node;
+
+    std::unique_ptr<Arena[]> _arenas;
+
+    [[nodiscard]] std::size_t _current_node() const;
+    [[nodiscard]] HeapType * _local_heap(std::size_t const node);
+};
+
+using NumaHeap = BasicNumaHeap<
+    BasicHeap<FirstFit, MutexLock, HeapStats, sizeof(void *)>
+>;
+
+// =============================================================================
+template<typename HeapType>
+BasicNumaHeap<HeapType>::BasicNumaHeap(std::size_t const bytes_per_node) :
+    _node_count     { numa::node_count() },
+    _bytes_per_node { vm::page_round(bytes_per_node) },
+    _arenas         { std::make_unique<Arena[]>(_node_count) }
+{ }
+
+// =============================================================================
+template<typename HeapType>
+BasicNumaHeap<HeapType>::~BasicNumaHeap() {
+    for(std::size_t node = 0; node < _node_count; ++node) {
+        auto &arena = _arenas[node];
+
+        // The heap has to go before the memory it manages
+        arena.owner.reset();
+
+        if(arena.memory != nullptr) {
+            vm::unmap(arena.memory, _bytes_per_node);
+        }
+    }
+}
+
+// =============================================================================
+template<typename HeapType>
+void * BasicNumaHeap<HeapType>::alloc(std::size_t const req_bytes) {
+    void *address = try_alloc(req_bytes);
+
+    if(address == nullptr) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    return address;
+}
+
+// =============================================================================
+template<typename HeapType>
+void * BasicNumaHeap<HeapType>::try_alloc(std::size_t const req_bytes) {
+    auto const node = _current_node();
+
+    auto *local = _local_heap(node);
+    if(local != nullptr) {
+        void *address = local->try_alloc(req_bytes);
+        if(address != nullptr) {
+            _arenas[node].local_allocs.fetch_add(1, std::memory_order_relaxed);
+            return address;
+        }
+    }
+
+    // Only spill into heaps that already exist. Creating one from here would
+    // first-touch its pages from the wrong node.
+    for(std::size_t other = 0; other < _node_count; ++other) {
+        auto *heap = _arenas[other].heap.load(std::memory_order_acquire);
+        if(other == node || heap == nullptr) {
+            continue;
+        }
+
+        void *address = heap->try_alloc(req_bytes);
+        if(address != nullptr) {
+            _arenas[other].spilled_allocs.fetch_add(1,
+                                                    std::memory_order_relaxed);
+            return address;
+        }
+    }
+
+    return nullptr;
+}
+
+// =============================================================================
+template<typename HeapType>
+void BasicNumaHeap<HeapType>::free(void *address) {
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    for(std::size_t node = 0; node < _node_count; ++node) {
+        auto *heap = _arenas[node].heap.load(std::memory_order_acquire);
+        if(heap == nullptr || !heap->owns(address)) {
+            continue;
+        }
+
+        if(node != _current_node()) {
+            _arenas[node].remote_frees.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        heap->free(address);
+        return;
+    }
+
+    detail::report_invalid_free();
+}
+
+// =============================================================================
+template<typename HeapType>
+bool BasicNumaHeap<HeapType>::owns(void const *address) const {
+    for(std::size_t node = 0; node < _node_count; ++node) {
+        auto *heap = _arenas[node].heap.load(std::memory_order_acquire);
+        if(heap != nullptr && heap->owns(address)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// =============================================================================
+template<typename HeapType>
+std::size_t BasicNumaHeap<HeapType>::_current_node() const {
+    // Nodes can come online after we've counted them; anything we don't know
+    // about shares node zero's heap
+    auto const node = numa::current_node();
+    return node < _node_count ? node : 0;
+}
+
+// =============================================================================
+template<typename HeapType>
+HeapType * BasicNumaHeap<HeapType>::_local_heap(std::size_t const node) {
+    auto &arena = _arenas[node];
+
+    std::call_once(arena.created, [this, &arena, node] {
+        arena.memory = numa::map(_bytes_per_node, node);
+        if(arena.memory == nullptr) {
+            detail::report_storage_failure(_bytes_per_node);
+            return;
+        }
+
+        // First touch, from a thread on the node these pages belong to
+        auto *bytes = static_cast<std::byte *>(arena.memory);
+        auto const page = vm::page_size();
+        for(std::size_t offset = 0; offset < _bytes_per_node; offset += page) {
+            *static_cast<std::byte volatile *>(bytes + offset) = std::byte { 0 };
+        }
+
+        arena.owner = std::make_unique<HeapType>(
+            std::span<std::byte>(bytes, _bytes_per_node)
+        );
+        arena.heap.store(arena.owner.get(), std::memory_order_release);
+    });
+
+    return arena.heap.load(std::memory_order_acquire);
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_NUMAHEAP_HPP
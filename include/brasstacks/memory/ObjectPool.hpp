@@ -0,0 +1,305 @@
+#ifndef BRASSTACKS_MEMORY_OBJECTPOOL_HPP
+#define BRASSTACKS_MEMORY_OBJECTPOOL_HPP
+
+#include "brasstacks/memory/Heap.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace btx::memory {
+
+// Refers to an object in an ObjectPool. Each slot's generation is bumped when
+// its object is destroyed, so a handle that outlives its object is caught
+// rather than quietly finding whatever took its place. A default-constructed
+// handle never refers to anything.
+template<typename T>
+struct ObjectHandle final {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    [[nodiscard]] explicit operator bool() const { return generation != 0; }
+
+    friend bool operator==(ObjectHandle const &, ObjectHandle const &)
+        = default;
+};
+
+// Objects of one type, kept packed together for iteration. Live objects always
+// fill the first size() places, in chunks of ChunkObjects that each sit in one
+// allocation from the heap. Destroying an object moves the last one into its
+// place, so for_each() never steps over a hole. Handles stay valid through
+// those moves, but pointers from get() don't survive the next destroy().
+//
+// The pool grows a chunk at a time and only hands chunks back to the heap when
+// it's destroyed. It isn't thread-safe.
+template<typename T, typename HeapType, std::size_t ChunkObjects = 64>
+class BasicObjectPool final {
+public:
+    using handle = ObjectHandle<T>;
+
+    static_assert(ChunkObjects > 0);
+    static_assert(std::is_move_constructible_v<T>,
+                  "Objects are moved to keep the pool packed");
+
+    // Aborts if the heap can't supply another chunk
+    template<typename... Args>
+    [[nodiscard]] handle create(Args &&...args);
+
+    // Returns false, doing nothing, for a stale or null handle
+    bool destroy(handle const object);
+
+    // nullptr for a stale or null handle
+    [[nodiscard]] T * get(handle const object);
+    [[nodiscard]] T const * get(handle const object) const;
+
+    [[nodiscard]] bool contains(handle const object) const {
+        return _live_slot(object) != nullptr;
+    }
+
+    // Visit every live object in storage order
+    template<typename Fn>
+    void for_each(Fn &&fn);
+
+    [[nodiscard]] auto size()        const { return _size; }
+    [[nodiscard]] auto capacity()    const { return _chunks.size() * ChunkObjects; }
+    [[nodiscard]] auto chunk_count() const { return _chunks.size(); }
+
+    BasicObjectPool() = delete;
+    ~BasicObjectPool();
+
+    // The heap must outlive the pool
+    explicit BasicObjectPool(HeapType &heap) : _heap { heap } { }
+
+    BasicObjectPool(BasicObjectPool &&other) = delete;
+    BasicObjectPool(BasicObjectPool const &) = delete;
+
+    BasicObjectPool & operator=(BasicObjectPool &&other) = delete;
+    BasicObjectPool & operator=(BasicObjectPool const &) = delete;
+
+private:
+    static std::uint32_t constexpr _no_slot =
+        std::numeric_limits<std::uint32_t>::max();
+
+    // Indexed by handle. A live slot holds the index of its object; a free
+    // one holds the next free slot.
+    struct Slot final {
+        std::uint32_t target;
+        std::uint32_t generation;
+    };
+
+    // Each chunk's allocation holds its objects, then the slot index owning
+    // each of those objects, then its share of the slots
+    struct Chunk final {
+        void *raw;
+        T *objects;
+        std::uint32_t *owners;
+        Slot *slots;
+    };
+
+    HeapType &_heap;
+
+    std::vector<Chunk> _chunks;
+    std::size_t _size = 0;
+    std::uint32_t _free_slot = _no_slot;
+
+    [[nodiscard]] T * _object(std::size_t const index) {
+        return _chunks[index / ChunkObjects].objects + index % ChunkObjects;
+    }
+
+    [[nodiscard]] std::uint32_t & _owner(std::size_t const index) {
+        return _chunks[index / ChunkObjects].owners[index % ChunkObjects];
+    }
+
+    [[nodiscard]] Slot & _slot(std::size_t const index) {
+        return _chunks[index / ChunkObjects].slots[index % ChunkObjects];
+    }
+
+    [[nodiscard]] Slot const * _live_slot(handle const object) const;
+
+    void _grow();
+};
+
+template<typename T>
+using ObjectPool = BasicObjectPool<T, Heap>;
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+BasicObjectPool<T, HeapType, ChunkObjects>::~BasicObjectPool() {
+    for(std::size_t index = 0; index < _size; ++index) {
+        std::destroy_at(_object(index));
+    }
+
+    for(auto const &chunk : _chunks) {
+        _heap.free(chunk.raw);
+    }
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+template<typename... Args>
+auto BasicObjectPool<T, HeapType, ChunkObjects>::create(Args &&...args)
+    -> handle
+{
+    if(_free_slot == _no_slot) {
+        _grow();
+    }
+
+    // Construct first, so a throwing constructor leaves the pool as it was
+    auto const index = _size;
+    std::construct_at(_object(index), std::forward<Args>(args)...);
+
+    auto const slot_index = _free_slot;
+    auto &slot = _slot(slot_index);
+
+    _free_slot = slot.target;
+    slot.target = static_cast<std::uint32_t>(index);
+    _owner(index) = slot_index;
+    ++_size;
+
+    return handle { slot_index, slot.generation };
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+bool BasicObjectPool<T, HeapType, ChunkObjects>::destroy(handle const object) {
+    if(_live_slot(object) == nullptr) {
+        return false;
+    }
+
+    auto &slot = _slot(object.index);
+    auto const index = slot.target;
+    auto const last = _size - 1;
+
+    std::destroy_at(_object(index));
+
+    // Fill the hole with the last object, and point its slot at the new home
+    if(index != last) {
+        std::construct_at(_object(index), std::move(*_object(last)));
+        std::destroy_at(_object(last));
+
+        _owner(index) = _owner(last);
+        _slot(_owner(index)).target = index;
+    }
+
+    --_size;
+
+    // Zero is reserved for null handles
+    if(++slot.generation == 0) {
+        slot.generation = 1;
+    }
+
+    slot.target = _free_slot;
+    _free_slot = object.index;
+
+    return true;
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+T * BasicObjectPool<T, HeapType, ChunkObjects>::get(handle const object) {
+    auto const *slot = _live_slot(object);
+    return slot == nullptr ? nullptr : _object(slot->target);
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+T const *
+BasicObjectPool<T, HeapType, ChunkObjects>::get(handle const object) const {
+    return const_cast<BasicObjectPool *>(this)->get(object);
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+template<typename Fn>
+void BasicObjectPool<T, HeapType, ChunkObjects>::for_each(Fn &&fn) {
+    // A chunk at a time, so the inner loop is a plain walk over an array
+    auto remaining = _size;
+    for(auto const &chunk : _chunks) {
+        if(remaining == 0) {
+            break;
+        }
+
+        auto const count = remaining < ChunkObjects ? remaining : ChunkObjects;
+        for(std::size_t index = 0; index < count; ++index) {
+            fn(chunk.objects[index]);
+        }
+
+        remaining -= count;
+    }
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+auto BasicObjectPool<T, HeapType, ChunkObjects>::_live_slot(
+    handle const object
+) const -> Slot const *
+{
+    if(object.generation == 0 || object.index >= capacity()) {
+        return nullptr;
+    }
+
+    auto const &chunk = _chunks[object.index / ChunkObjects];
+    auto const &slot = chunk.slots[object.index % ChunkObjects];
+
+    // Free slots always carry the generation their next object will get, so
+    // a matching generation alone doesn't mean the slot is live
+    if(slot.generation != object.generation || slot.target >= _size) {
+        return nullptr;
+    }
+
+    auto const &owner_chunk = _chunks[slot.target / ChunkObjects];
+    if(owner_chunk.owners[slot.target % ChunkObjects] != object.index) {
+        return nullptr;
+    }
+
+    return &slot;
+}
+
+// =============================================================================
+template<typename T, typename HeapType, std::size_t ChunkObjects>
+void BasicObjectPool<T, HeapType, ChunkObjects>::_grow() {
+    auto constexpr align_up = [](std::size_t const value,
+                                 std::size_t const alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    };
+
+    auto constexpr owners_offset = align_up(ChunkObjects * sizeof(T),
+                                            alignof(std::uint32_t));
+    auto constexpr slots_offset = align_up(
+        owners_offset + ChunkObjects * sizeof(std::uint32_t), alignof(Slot)
+    );
+    auto constexpr chunk_bytes = slots_offset + ChunkObjects * sizeof(Slot);
+
+    // The heap may align less strictly than T needs
+    void *raw = _heap.alloc(chunk_bytes + alignof(T) - 1);
+
+    auto const start = align_up(reinterpret_cast<std::uintptr_t>(raw),
+                                alignof(T));
+    auto *bytes = reinterpret_cast<std::uint8_t *>(start);
+
+    Chunk const chunk {
+        .raw     = raw,
+        .objects = reinterpret_cast<T *>(bytes),
+        .owners  = reinterpret_cast<std::uint32_t *>(bytes + owners_offset),
+        .slots   = reinterpret_cast<Slot *>(bytes + slots_offset),
+    };
+
+    // Thread the new slots onto the free list in index order
+    auto const first_slot = static_cast<std::uint32_t>(capacity());
+    for(std::size_t index = ChunkObjects; index > 0; --index) {
+        chunk.slots[index - 1] = Slot {
+            .target     = _free_slot,
+            .generation = 1,
+        };
+        _free_slot = first_slot + static_cast<std::uint32_t>(index - 1);
+    }
+
+    _chunks.push_back(chunk);
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_OBJECTPOOL_HPP
@@ -0,0 +1,67 @@
+#ifndef BRASSTACKS_MEMORY_RELATIVELINK_HPP
+#define BRASSTACKS_MEMORY_RELATIVELINK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace btx::memory {
+
+// A pointer stored as the distance from the link itself to its target. As
+// long as the link and its target move together, as they do when a heap's
+// storage is mapped at a different address, copied wholesale, or shared
+// between processes, the link stays valid without any fix-up. Zero is null,
+// since nothing links to itself.
+//
+// Links convert to and from plain pointers, so they read like them. Copying a
+// link recomputes the distance from its new home.
+template<typename T>
+class RelativeLink final {
+public:
+    RelativeLink() = default;
+    ~RelativeLink() = default;
+
+    RelativeLink(T *target) { _set(target); }
+    RelativeLink(std::nullptr_t) { }
+
+    RelativeLink(RelativeLink const &other) { _set(other.get()); }
+
+    RelativeLink & operator=(RelativeLink const &other) {
+        _set(other.get());
+        return *this;
+    }
+
+    RelativeLink & operator=(T *target) {
+        _set(target);
+        return *this;
+    }
+
+    [[nodiscard]] T * get() const {
+        if(_offset == 0) {
+            return nullptr;
+        }
+
+        return reinterpret_cast<T *>(
+            reinterpret_cast<std::intptr_t>(this) + _offset
+        );
+    }
+
+    operator T *() const { return get(); }
+    T * operator->() const { return get(); }
+
+    // The raw distance, for inspection
+    [[nodiscard]] auto offset() const { return _offset; }
+
+private:
+    std::intptr_t _offset = 0;
+
+    void _set(T *target) {
+        _offset = target == nullptr
+                ? 0
+                : reinterpret_cast<std::intptr_t>(target)
+                  - reinterpret_cast<std::intptr_t>(this);
+    }
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_RELATIVELINK_HPP
@@ -0,0 +1,82 @@
+#ifndef BRASSTACKS_MEMORY_SHAREDHEAP_HPP
+#define BRASSTACKS_MEMORY_SHAREDHEAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace btx::memory {
+
+// A first-fit, address-ordered, coalescing heap living entirely in a named
+// segment of shared memory, so several processes can allocate from and free
+// to it at once. The free list, stats and lock all live in the segment
+// alongside the blocks, and every link between blocks is relative, so each
+// process is free to map the segment wherever it likes.
+//
+// Since addresses differ between processes, hand allocations across as
+// offsets: one process allocates a message and fills it in place, then passes
+// offset_of() to another, which reads it via address_of() and frees it when
+// it's done.
+//
+// The lock is a spin lock, which needs no help from the OS to work across
+// processes. A process that dies while holding it will leave every other
+// process spinning, so don't.
+class SharedHeap final {
+public:
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes);
+
+    void free(void *address);
+
+    [[nodiscard]] std::uint64_t offset_of(void const *address) const;
+    [[nodiscard]] void * address_of(std::uint64_t const offset) const;
+
+    [[nodiscard]] bool owns(void const *address) const;
+
+    [[nodiscard]] auto total_size() const { return _total_size; }
+
+    [[nodiscard]] std::size_t current_used() const;
+    [[nodiscard]] std::size_t current_allocs() const;
+    [[nodiscard]] std::size_t peak_used() const;
+    [[nodiscard]] std::size_t peak_allocs() const;
+
+    [[nodiscard]] float calc_fragmentation() const;
+
+    // Stop any more processes from opening the segment by name. Those that
+    // already have it are unaffected, and it's released once the last of
+    // them is done.
+    static void remove(char const *name);
+
+    SharedHeap() = delete;
+    ~SharedHeap();
+
+    // Create a new segment; aborts if the name's already in use
+    SharedHeap(char const *name, std::size_t const req_bytes);
+
+    // Open a segment created by another SharedHeap, once its constructor has
+    // returned
+    explicit SharedHeap(char const *name);
+
+    SharedHeap(SharedHeap &&other) = delete;
+    SharedHeap(SharedHeap const &) = delete;
+
+    SharedHeap & operator=(SharedHeap &&other) = delete;
+    SharedHeap & operator=(SharedHeap const &) = delete;
+
+private:
+    struct Block;
+    struct Control;
+
+    std::uint8_t *_segment;  // As returned by vm::map_shared()
+    std::size_t   _mapped_bytes;
+
+    Control      *_control;  // The start of the segment
+    std::uint8_t *_raw_heap; // Just past _control
+
+    std::size_t _total_size;
+
+    void _coalesce(Block *header);
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_SHAREDHEAP_HPP
@@ -0,0 +1,323 @@
+#ifndef BRASSTACKS_MEMORY_SMALLBLOCKHEAP_HPP
+#define BRASSTACKS_MEMORY_SMALLBLOCKHEAP_HPP
+
+#include "brasstacks/memory/Heap.hpp"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace btx::memory {
+
+// Serves requests of max_small_bytes or less from runs of equal-sized slots,
+// and passes everything larger through to a backing heap. Each run tracks its
+// slots with a bitmap rather than headers, so allocation is a find-first-set
+// and freeing is a bit flip, and a run's bookkeeping fits in a few cache
+// lines.
+//
+// Runs are RunBytes each and aligned to their own size, so a slot's run is
+// found by masking its address. They're carved from the backing heap a few at
+// a time and are only handed back when the small block heap is destroyed.
+// Since slots carry no header, free() needs the size that was requested.
+template<typename HeapType, std::size_t RunBytes = 16 * 1024>
+class BasicSmallBlockHeap final {
+public:
+    static_assert(std::has_single_bit(RunBytes));
+    static_assert(RunBytes >= 4 * 1024 && RunBytes <= 64 * 1024);
+
+    static std::size_t constexpr max_small_bytes = 64;
+    static std::size_t constexpr run_bytes = RunBytes;
+
+    // Both abort if the backing heap does
+    [[nodiscard]] void * alloc(std::size_t const req_bytes);
+    void free(void *address, std::size_t const req_bytes);
+
+    // Returns nullptr if the backing heap is exhausted
+    [[nodiscard]] void * try_alloc(std::size_t const req_bytes);
+
+    // Live small allocations, and runs carved so far
+    [[nodiscard]] auto small_allocs() const {
+        std::scoped_lock const guard(_lock);
+        return _small_allocs;
+    }
+
+    [[nodiscard]] auto run_count() const {
+        std::scoped_lock const guard(_lock);
+        return _chunks.size() * _runs_per_chunk;
+    }
+
+    BasicSmallBlockHeap() = delete;
+    ~BasicSmallBlockHeap();
+
+    explicit BasicSmallBlockHeap(HeapType &heap) : _heap { heap } { }
+
+    BasicSmallBlockHeap(BasicSmallBlockHeap &&other) = delete;
+    BasicSmallBlockHeap(BasicSmallBlockHeap const &) = delete;
+
+    BasicSmallBlockHeap & operator=(BasicSmallBlockHeap &&other) = delete;
+    BasicSmallBlockHeap & operator=(BasicSmallBlockHeap const &) = delete;
+
+private:
+    // Size classes step by a pointer's size
+    static std::size_t constexpr _granularity = sizeof(void *);
+    static std::size_t constexpr _class_count =
+        max_small_bytes / _granularity;
+
+    // Enough bits for the smallest slots to fill a run
+    static std::size_t constexpr _bitmap_words =
+        (RunBytes / _granularity + 63) / 64;
+
+    // Runs come from the heap in chunks, with one run's worth of slack so
+    // they can be aligned
+    static std::size_t constexpr _runs_per_chunk = 4;
+    static std::size_t constexpr _chunk_bytes = (_runs_per_chunk + 1) * RunBytes;
+
+    struct Run final {
+        // A set bit is a free slot
+        std::array<std::uint64_t, _bitmap_words> bitmap;
+
+        Run *next;
+        Run *prev;
+
+        std::uint32_t slot_size;
+        std::uint32_t slot_count;
+        std::uint32_t free_count;
+        std::uint32_t first_word; // No free slots in any word before this
+    };
+
+    // Slots start on the cache line after the run's bookkeeping
+    static std::size_t constexpr _slots_offset =
+        ((sizeof(Run) + 63) / 64) * 64;
+
+    static_assert(_slots_offset + max_small_bytes <= RunBytes);
+
+    HeapType &_heap;
+
+    std::vector<void *> _chunks;
+
+    // Runs with at least one free slot, by size class, and runs with no
+    // slots in use that any class can claim
+    std::array<Run *, _class_count> _partial { };
+    Run *_empty = nullptr;
+
+    std::size_t _small_allocs = 0;
+
+    mutable typename HeapType::lock_policy _lock;
+
+    [[nodiscard]] bool _add_chunk();
+    void _init_run(Run *run, std::size_t const slot_size);
+
+    static void _push(Run *&head, Run *run);
+    static void _remove(Run *&head, Run *run);
+
+    [[nodiscard]] static std::size_t _class(std::size_t const bytes) {
+        return (bytes + _granularity - 1) / _granularity - 1;
+    }
+
+    [[nodiscard]] static Run * _run_of(void *address) {
+        return reinterpret_cast<Run *>(
+            reinterpret_cast<std::uintptr_t>(address) & ~(RunBytes - 1)
+        );
+    }
+
+    [[nodiscard]] static std::uint8_t * _slots(Run *run) {
+        return reinterpret_cast<std::uint8_t *>(run) + _slots_offset;
+    }
+};
+
+using SmallBlockHeap = BasicSmallBlockHeap<Heap>;
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+BasicSmallBlockHeap<HeapType, RunBytes>::~BasicSmallBlockHeap() {
+    for(auto *chunk : _chunks) {
+        _heap.free(chunk);
+    }
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+void * BasicSmallBlockHeap<HeapType, RunBytes>::
+alloc(std::size_t const req_bytes) {
+    void *address = try_alloc(req_bytes);
+
+    if(address == nullptr) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    return address;
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+void * BasicSmallBlockHeap<HeapType, RunBytes>::
+try_alloc(std::size_t const req_bytes) {
+    if(req_bytes == 0 || req_bytes > max_small_bytes) {
+        return _heap.try_alloc(req_bytes);
+    }
+
+    std::scoped_lock const guard(_lock);
+
+    auto const size_class = _class(req_bytes);
+    auto *run = _partial[size_class];
+
+    if(run == nullptr) {
+        if(_empty == nullptr && !_add_chunk()) {
+            return nullptr;
+        }
+
+        run = _empty;
+        _remove(_empty, run);
+
+        _init_run(run, (size_class + 1) * _granularity);
+        _push(_partial[size_class], run);
+    }
+
+    // The first set bit from the first word that has one is the lowest free
+    // slot in the run
+    auto word = run->first_word;
+    while(run->bitmap[word] == 0) {
+        ++word;
+    }
+
+    auto const bit = std::countr_zero(run->bitmap[word]);
+    run->bitmap[word] &= run->bitmap[word] - 1;
+    run->first_word = word;
+
+    if(--run->free_count == 0) {
+        _remove(_partial[size_class], run);
+    }
+
+    ++_small_allocs;
+
+    auto const slot = word * 64 + static_cast<std::size_t>(bit);
+    return _slots(run) + slot * run->slot_size;
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+void BasicSmallBlockHeap<HeapType, RunBytes>::
+free(void *address, std::size_t const req_bytes) {
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    if(req_bytes == 0 || req_bytes > max_small_bytes) {
+        _heap.free(address);
+        return;
+    }
+
+    std::scoped_lock const guard(_lock);
+
+    auto *run = _run_of(address);
+    auto const slot = static_cast<std::size_t>(
+        static_cast<std::uint8_t *>(address) - _slots(run)
+    ) / run->slot_size;
+
+    auto const word = static_cast<std::uint32_t>(slot / 64);
+    auto const mask = std::uint64_t { 1 } << (slot % 64);
+
+    if((run->bitmap[word] & mask) != 0) {
+        detail::report_invalid_free();
+    }
+
+    run->bitmap[word] |= mask;
+    if(word < run->first_word) {
+        run->first_word = word;
+    }
+
+    --_small_allocs;
+
+    auto const size_class = _class(run->slot_size);
+
+    // A full run becomes available again, and an emptied one can be
+    // reclaimed by whichever size class needs it next
+    if(run->free_count++ == 0) {
+        _push(_partial[size_class], run);
+    }
+
+    if(run->free_count == run->slot_count) {
+        _remove(_partial[size_class], run);
+        _push(_empty, run);
+    }
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+bool BasicSmallBlockHeap<HeapType, RunBytes>::_add_chunk() {
+    void *chunk = _heap.try_alloc(_chunk_bytes);
+    if(chunk == nullptr) {
+        return false;
+    }
+
+    _chunks.push_back(chunk);
+
+    auto const first = (reinterpret_cast<std::uintptr_t>(chunk) + RunBytes - 1)
+                     & ~(RunBytes - 1);
+
+    for(std::size_t i = 0; i < _runs_per_chunk; ++i) {
+        _push(_empty, reinterpret_cast<Run *>(first + i * RunBytes));
+    }
+
+    return true;
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+void BasicSmallBlockHeap<HeapType, RunBytes>::
+_init_run(Run *run, std::size_t const slot_size) {
+    auto const slot_count = (RunBytes - _slots_offset) / slot_size;
+
+    // Set one bit per slot, leaving any bits past the last slot clear
+    run->bitmap.fill(0);
+    for(std::size_t word = 0; word < slot_count / 64; ++word) {
+        run->bitmap[word] = ~std::uint64_t { 0 };
+    }
+
+    if(slot_count % 64 != 0) {
+        run->bitmap[slot_count / 64] =
+            (std::uint64_t { 1 } << (slot_count % 64)) - 1;
+    }
+
+    run->slot_size = static_cast<std::uint32_t>(slot_size);
+    run->slot_count = static_cast<std::uint32_t>(slot_count);
+    run->free_count = run->slot_count;
+    run->first_word = 0;
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+void BasicSmallBlockHeap<HeapType, RunBytes>::_push(Run *&head, Run *run) {
+    run->prev = nullptr;
+    run->next = head;
+
+    if(head != nullptr) {
+        head->prev = run;
+    }
+
+    head = run;
+}
+
+// =============================================================================
+template<typename HeapType, std::size_t RunBytes>
+void BasicSmallBlockHeap<HeapType, RunBytes>::_remove(Run *&head, Run *run) {
+    if(run->next != nullptr) {
+        run->next->prev = run->prev;
+    }
+
+    if(run->prev != nullptr) {
+        run->prev->next = run->next;
+    }
+    else {
+        head = run->next;
+    }
+
+    run->next = nullptr;
+    run->prev = nullptr;
+}
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_SMALLBLOCKHEAP_HPP
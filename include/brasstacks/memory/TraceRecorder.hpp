@@ -0,0 +1,112 @@
+#ifndef BRASSTACKS_MEMORY_TRACERECORDER_HPP
+#define BRASSTACKS_MEMORY_TRACERECORDER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace btx::memory {
+
+// Large blocks get their own pages, outside the heap, so they're recorded
+// with ops of their own
+enum class TraceOp : std::uint8_t {
+    alloc       = 0,
+    free        = 1,
+    alloc_large = 2,
+    free_large  = 3,
+};
+
+// One fixed-width entry in a trace file. Addresses are stored as offsets from
+// the start of the traced heap so traces from different runs can be compared
+// and replayed against any backend. Large blocks have no such offset, so their
+// records carry the payload's address instead, which only serves to pair each
+// free with its alloc.
+struct TraceRecord final {
+    std::uint64_t timestamp = 0; // Nanoseconds since the recorder was created
+    std::uint64_t offset = 0;    // Payload offset from the heap's base address,
+                                 // or address for large blocks
+    std::uint64_t size = 0;      // Requested bytes for allocs, block size for
+                                 // frees
+    std::uint32_t thread = 0;    // Recorder-assigned index of the calling thread
+    TraceOp op = TraceOp::alloc;
+    std::array<std::uint8_t, 3> reserved { };
+};
+
+static_assert(sizeof(TraceRecord) == 32);
+
+// Each trace file starts with this header, followed by nothing but records
+struct TraceFileHeader final {
+    std::array<char, 8> magic { 'B', 'T', 'X', 'T', 'R', 'A', 'C', 'E' };
+    std::uint32_t version = 2;   // Version 1 had no large block ops
+    std::uint32_t record_size = sizeof(TraceRecord);
+};
+
+static_assert(sizeof(TraceFileHeader) == 16);
+
+class TraceRecorder final {
+public:
+    // Called from Heap::alloc() and Heap::free(). The calling thread only ever
+    // touches its own ring, so recording never takes a lock unless that ring
+    // is full and has to be drained to disk first.
+    void record(TraceOp const op, std::uint64_t const size,
+                std::uint64_t const offset);
+
+    // Drain every thread's ring to the trace file
+    void flush();
+
+    [[nodiscard]] auto records_written() const { return _records_written; }
+
+    // Read a whole trace file back into memory. Returns an empty vector if the
+    // file can't be opened or doesn't carry a valid header.
+    [[nodiscard]] static std::vector<TraceRecord> read(char const *path);
+
+    TraceRecorder() = delete;
+    ~TraceRecorder();
+
+    explicit TraceRecorder(char const *path);
+
+    TraceRecorder(TraceRecorder &&other) = delete;
+    TraceRecorder(TraceRecorder const &) = delete;
+
+    TraceRecorder & operator=(TraceRecorder &&other) = delete;
+    TraceRecorder & operator=(TraceRecorder const &) = delete;
+
+private:
+    // Single-producer, single-consumer ring. The owning thread is the only
+    // producer, and consumers are serialized by _flush_mutex.
+    struct Ring final {
+        static std::size_t constexpr capacity = 1u << 12;
+        static_assert((capacity & (capacity - 1)) == 0);
+
+        std::thread::id owner;
+        std::uint32_t thread = 0;
+
+        alignas(64) std::atomic<std::size_t> head { 0 };
+        alignas(64) std::atomic<std::size_t> tail { 0 };
+
+        std::array<TraceRecord, capacity> records { };
+    };
+
+    std::uint64_t const _id; // Unique per instance, so threads can tell a new
+                             // recorder apart from a destroyed one
+    std::FILE *_file;
+    std::chrono::steady_clock::time_point const _start;
+    std::size_t _records_written;
+
+    std::mutex _flush_mutex;
+    std::mutex _rings_mutex;
+    std::vector<std::unique_ptr<Ring>> _rings;
+
+    Ring & _thread_ring();
+    void _drain(Ring &ring);
+};
+
+} // namespace btx::memory
+
+#endif // BRASSTACKS_MEMORY_TRACERECORDER_HPP
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef BRASSTACKS_MEMORY_VIRTUALMEMORY_HPP
+#define BRASSTACKS_MEMORY_VIRTUALMEMORY_HPP
+
+#include <cstddef>
+
+// Thin wrappers over the platform's page mapping calls: mmap() and friends on
+// POSIX systems, VirtualAlloc() and friends on Windows.
+namespace btx::memory::vm {
+
+[[nodiscard]] std::size_t page_size();
+
+// Round up to a whole number of pages
+[[nodiscard]] std::size_t page_round(std::size_t const bytes);
+
+// Map zeroed, readable and writable pages. Returns nullptr on failure.
+[[nodiscard]] void * map(std::size_t const bytes);
+
+// Grow or shrink a mapping, moving it if need be. Where the OS can't remap
+// in place this copies into a fresh mapping. Returns nullptr on failure, in
+// which case the original mapping is untouched.
+[[nodiscard]] void * remap(void *address, std::size_t const old_bytes,
+                           std::size_t const new_bytes);
+
+// Release pages obtained from map() or reserve(). bytes must match what was
+// mapped.
+void unmap(void *address, std::size_t const bytes);
+
+// Set aside address space without backing any of it, so touching it faults
+// until it's been committed. Returns nullptr on failure.
+[[nodiscard]] void * reserve(std::size_t const bytes);
+
+// The same, but only at exactly address, which must be aligned to the OS's
+// allocation granularity: a page on POSIX systems, 64KiB on Windows. Nothing
+// already mapped there is ever replaced. Returns nullptr if the range isn't
+// free.
+[[nodiscard]] void * reserve_at(void *address, std::size_t const bytes);
+
+// Make reserved pages readable and writable. They read as zero, and the OS
+// backs them as they're first touched. address and bytes must be page
+// aligned. Returns false on failure.
+[[nodiscard]] bool commit(void *address, std::size_t const bytes);
+
+// Hand committed pages back to the OS, leaving them reserved but untouchable
+// until they're committed again. address and bytes must be page aligned.
+void decommit(void *address, std::size_t const bytes);
+
+// Let the OS reclaim the memory behind pages whose contents no longer matter.
+// They stay usable, and on POSIX systems read back as zeroes, or as the file
+// behind them. Windows can only do this for pages it mapped itself, which
+// malloc()'d memory might not be, so there this does nothing. address and
+// bytes must be page aligned.
+void discard(void *address, std::size_t const bytes);
+
+// Map an entire file copy-on-write, so writes through the mapping stay
+// private to this process and never reach the file. The mapping is placed at
+// hint if that range is free, and with exact, nowhere else. Returns nullptr on
+// failure; otherwise bytes is set to the file's size.
+[[nodiscard]] void * map_file(char const *path, std::size_t &bytes,
+                              void *hint = nullptr, bool const exact = false);
+
+// Release a mapping obtained from map_file()
+void unmap_file(void *address, std::size_t const bytes);
+
+// Map a named segment of shared memory read-write, so every process mapping
+// the same name sees the same bytes. With create, the segment is made bytes
+// long and zeroed, and this fails if the name is already taken. Without it,
+// an existing segment is opened and bytes is set to its size. Returns nullptr
+// on failure.
+[[nodiscard]] void * map_shared(char const *name, std::size_t &bytes,
+                                bool const create);
+
+// Release a mapping obtained from map_shared()
+void unmap_shared(void *address, std::size_t const bytes);
+
+// Remove a segment's name so no one else can open it, leaving existing
+// mappings alone. On Windows segments have no lasting name, and disappear
+// along with their last mapping, so this does nothing.
+void remove_shared(char const *name);
+
+} // namespace btx::memory::vm
+
+#endif // BRASSTACKS_MEMORY_VIRTUALMEMORY_HPP
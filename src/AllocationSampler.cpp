@@ -0,0 +1,369 @@
+#include "brasstacks/memory/AllocationSampler.hpp"
+#include "brasstacks/log/Log.hpp"
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+    #include <cxxabi.h>
+    #include <dlfcn.h>
+    #include <execinfo.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+
+#if defined(__GNUC__)
+    #define BTX_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+    #define BTX_NOINLINE __declspec(noinline)
+#else
+    #define BTX_NOINLINE
+#endif
+
+namespace btx::memory {
+
+namespace {
+
+std::atomic<std::uint64_t> next_sampler_id { 1 };
+
+// Frames belonging to the sampler itself: capture_stack() and record()
+int constexpr own_frames = 2;
+
+// =============================================================================
+BTX_NOINLINE std::size_t capture_stack(void **frames, std::size_t const count)
+{
+#if defined(_WIN32)
+    return ::CaptureStackBackTrace(own_frames, static_cast<DWORD>(count),
+                                   frames, nullptr);
+#elif defined(__GLIBC__) || defined(__APPLE__)
+    std::array<void *, AllocationSampler::max_frames + own_frames> all { };
+    auto const depth = ::backtrace(all.data(), static_cast<int>(all.size()));
+    if(depth <= own_frames) {
+        return 0;
+    }
+
+    auto const kept = std::min(static_cast<std::size_t>(depth - own_frames),
+                               count);
+    std::memcpy(frames, all.data() + own_frames, kept * sizeof(void *));
+    return kept;
+#else
+    static_cast<void>(frames);
+    static_cast<void>(count);
+    return 0;
+#endif
+}
+
+// How many allocations of this size one sample of it stands for, given that
+// each byte is sampled with probability 1 / interval
+double sample_count(std::size_t const bytes, std::size_t const interval) {
+    auto const probability = 1.0 - std::exp(
+        -static_cast<double>(bytes) / static_cast<double>(interval)
+    );
+
+    return probability > 0.0 ? 1.0 / probability : 1.0;
+}
+
+} // namespace
+
+// =============================================================================
+AllocationSampler::AllocationSampler(std::size_t const interval) :
+    _id       { next_sampler_id.fetch_add(1, std::memory_order_relaxed) },
+    _interval { std::max<std::size_t>(interval, 1) }
+{ }
+
+// =============================================================================
+void AllocationSampler::record(void const *address, std::size_t const bytes) {
+    Stack stack { };
+    auto const depth = capture_stack(stack.data(), stack.size());
+
+    auto const count = sample_count(bytes, _interval);
+
+    std::scoped_lock const guard(_mutex);
+
+    auto &site = _sites[stack];
+    site.depth = depth;
+    site.live_samples += 1;
+    site.live_bytes += bytes;
+    site.total_samples += 1;
+    site.total_bytes += bytes;
+    site.estimated_count += count;
+    site.estimated_bytes += count * static_cast<double>(bytes);
+
+    _live[address] = Sample {
+        .site  = &site,
+        .bytes = bytes,
+        .count = count,
+    };
+}
+
+// =============================================================================
+void AllocationSampler::forget(void const *address) {
+    std::scoped_lock const guard(_mutex);
+
+    auto const sample = _live.find(address);
+    if(sample != _live.end()) {
+        _forget(sample);
+    }
+}
+
+// =============================================================================
+void AllocationSampler::clear() {
+    std::scoped_lock const guard(_mutex);
+
+    _live.clear();
+
+    for(auto &[stack, site] : _sites) {
+        site.live_samples = 0;
+        site.live_bytes = 0;
+        site.estimated_count = 0.0;
+        site.estimated_bytes = 0.0;
+    }
+}
+
+// =============================================================================
+void AllocationSampler::forget_range(void const *begin, void const *end) {
+    std::scoped_lock const guard(_mutex);
+
+    std::less<void const *> const before;
+
+    auto sample = _live.begin();
+    while(sample != _live.end()) {
+        if(!before(sample->first, begin) && before(sample->first, end)) {
+            sample = _forget(sample);
+        }
+        else {
+            ++sample;
+        }
+    }
+}
+
+// =============================================================================
+std::vector<SampledSite> AllocationSampler::sites() const {
+    std::vector<SampledSite> result;
+
+    {
+        std::scoped_lock const guard(_mutex);
+
+        for(auto const &[stack, site] : _sites) {
+            if(site.live_samples == 0) {
+                continue;
+            }
+
+            result.push_back(SampledSite {
+                .frames = std::vector<void *>(stack.begin(),
+                                              stack.begin() + site.depth),
+                .live_samples    = site.live_samples,
+                .live_bytes      = site.live_bytes,
+                .total_samples   = site.total_samples,
+                .total_bytes     = site.total_bytes,
+                .estimated_count = site.estimated_count,
+                .estimated_bytes = site.estimated_bytes,
+            });
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](SampledSite const &lhs, SampledSite const &rhs) {
+                  return lhs.estimated_bytes > rhs.estimated_bytes;
+              });
+
+    return result;
+}
+
+// =============================================================================
+std::size_t AllocationSampler::live_samples() const {
+    std::scoped_lock const guard(_mutex);
+    return _live.size();
+}
+
+// =============================================================================
+void AllocationSampler::write_folded(std::FILE *file) const {
+    for(auto const &site : sites()) {
+        if(site.frames.empty()) {
+            std::fputs("[unknown]", file);
+        }
+
+        for(auto frame = site.frames.rbegin(); frame != site.frames.rend();
+            ++frame)
+        {
+            if(frame != site.frames.rbegin()) {
+                std::fputc(';', file);
+            }
+            _write_frame(file, *frame);
+        }
+
+        std::fprintf(file, " %.0f\n", site.estimated_bytes);
+    }
+}
+
+// =============================================================================
+void AllocationSampler::write_pprof(std::FILE *file) const {
+    auto const all_sites = sites();
+
+    std::size_t live_samples = 0;
+    std::size_t live_bytes = 0;
+    std::size_t total_samples = 0;
+    std::size_t total_bytes = 0;
+
+    for(auto const &site : all_sites) {
+        live_samples += site.live_samples;
+        live_bytes += site.live_bytes;
+        total_samples += site.total_samples;
+        total_bytes += site.total_bytes;
+    }
+
+    std::fprintf(file, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+                 live_samples, live_bytes, total_samples, total_bytes,
+                 _interval);
+
+    for(auto const &site : all_sites) {
+        std::fprintf(file, "%zu: %zu [%zu: %zu] @",
+                     site.live_samples, site.live_bytes,
+                     site.total_samples, site.total_bytes);
+
+        for(void *frame : site.frames) {
+            std::fprintf(file, " %p", frame);
+        }
+        std::fputc('\n', file);
+    }
+
+#if defined(__linux__)
+    // pprof finds the binaries behind each address from these
+    std::FILE *maps = std::fopen("/proc/self/maps", "r");
+    if(maps != nullptr) {
+        std::fputs("\nMAPPED_LIBRARIES:\n", file);
+
+        std::array<char, 4096> buffer { };
+        std::size_t read = 0;
+        while((read = std::fread(buffer.data(), 1, buffer.size(), maps)) > 0) {
+            std::fwrite(buffer.data(), 1, read, file);
+        }
+
+        std::fclose(maps);
+    }
+#endif
+}
+
+// =============================================================================
+bool AllocationSampler::dump_folded(char const *path) const {
+    std::FILE *file = std::fopen(path, "w");
+    if(file == nullptr) {
+        Log::error("Could not open profile file '{}'", path);
+        return false;
+    }
+
+    write_folded(file);
+    return std::fclose(file) == 0;
+}
+
+// =============================================================================
+bool AllocationSampler::dump_pprof(char const *path) const {
+    std::FILE *file = std::fopen(path, "w");
+    if(file == nullptr) {
+        Log::error("Could not open profile file '{}'", path);
+        return false;
+    }
+
+    write_pprof(file);
+    return std::fclose(file) == 0;
+}
+
+// =============================================================================
+std::size_t AllocationSampler::StackHash::operator()(Stack const &stack) const
+{
+    // FNV-1a over the frame addresses
+    std::uint64_t hash = 14695981039346656037ull;
+    for(void *frame : stack) {
+        hash ^= reinterpret_cast<std::uintptr_t>(frame);
+        hash *= 1099511628211ull;
+    }
+
+    return static_cast<std::size_t>(hash);
+}
+
+// =============================================================================
+auto AllocationSampler::_forget(LiveMap::iterator const sample)
+    -> LiveMap::iterator
+{
+    auto &site = *sample->second.site;
+    site.live_samples -= 1;
+    site.live_bytes -= sample->second.bytes;
+    site.estimated_count -= sample->second.count;
+    site.estimated_bytes -= sample->second.count
+                          * static_cast<double>(sample->second.bytes);
+
+    return _live.erase(sample);
+}
+
+// =============================================================================
+bool AllocationSampler::_countdown_expired(std::size_t const bytes) {
+    // This thread last counted down for some other sampler, or none at all
+    if(_countdown.sampler != _id) {
+        _countdown.sampler = _id;
+        _countdown.remaining = _next_gap();
+
+        if(_countdown.remaining > bytes) {
+            _countdown.remaining -= bytes;
+            return false;
+        }
+    }
+
+    _countdown.remaining = _next_gap();
+    return true;
+}
+
+// =============================================================================
+std::size_t AllocationSampler::_next_gap() const {
+    thread_local std::minstd_rand engine(static_cast<std::uint_fast32_t>(
+        std::hash<std::thread::id> { }(std::this_thread::get_id())
+    ));
+
+    std::exponential_distribution<double> gap(
+        1.0 / static_cast<double>(_interval)
+    );
+
+    return static_cast<std::size_t>(gap(engine));
+}
+
+// =============================================================================
+void AllocationSampler::_write_frame(std::FILE *file, void *frame) {
+#if defined(__GLIBC__) || defined(__APPLE__)
+    Dl_info info { };
+    if(::dladdr(frame, &info) != 0) {
+        if(info.dli_sname != nullptr) {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr,
+                                                  nullptr, &status);
+
+            std::fputs(status == 0 ? demangled : info.dli_sname, file);
+            std::free(demangled);
+            return;
+        }
+
+        // No symbol to go by, but the module and offset are enough for
+        // addr2line
+        if(info.dli_fname != nullptr) {
+            char const *name = std::strrchr(info.dli_fname, '/');
+            std::fprintf(file, "%s+%#zx",
+                         name == nullptr ? info.dli_fname : name + 1,
+                         static_cast<std::size_t>(
+                             static_cast<std::uint8_t *>(frame)
+                             - static_cast<std::uint8_t *>(info.dli_fbase)
+                         ));
+            return;
+        }
+    }
+#endif
+
+    std::fprintf(file, "%p", frame);
+}
+
+} // namespace btx::memory
@@ -0,0 +1,7 @@
+#include "brasstacks/memory/BuddyHeap.hpp"
+
+namespace btx::memory {
+
+template class BasicBuddyHeap<NoLock, HeapStats>;
+
+} // namespace btx::memory
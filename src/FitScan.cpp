@@ -0,0 +1,157 @@
+#include "brasstacks/memory/HeapPolicies.hpp"
+
+#include <bit>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define BTX_FIT_SCAN_X86
+    #define BTX_FIT_SCAN_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+    #include <immintrin.h>
+    #define BTX_FIT_SCAN_X86
+    #define BTX_FIT_SCAN_TARGET(isa)
+#endif
+
+namespace btx::memory::detail {
+
+namespace {
+
+using ScanFn = std::size_t (*)(std::uint32_t const *, std::size_t const,
+                               std::uint32_t const, std::uint32_t const);
+
+struct ScanKernel final {
+    ScanFn scan;
+    char const *name;
+};
+
+// =============================================================================
+std::size_t scan_scalar(std::uint32_t const *sizes, std::size_t const count,
+                        std::uint32_t const exact, std::uint32_t const split)
+{
+    for(std::size_t index = 0; index < count; ++index) {
+        if(sizes[index] == exact || sizes[index] >= split) {
+            return index;
+        }
+    }
+
+    return count;
+}
+
+#if defined(BTX_FIT_SCAN_X86)
+
+// There's no unsigned compare, but max(size, split) == size is size >= split
+
+// =============================================================================
+BTX_FIT_SCAN_TARGET("sse4.1")
+std::size_t scan_sse41(std::uint32_t const *sizes, std::size_t const count,
+                       std::uint32_t const exact, std::uint32_t const split)
+{
+    auto const exact_lanes = _mm_set1_epi32(static_cast<int>(exact));
+    auto const split_lanes = _mm_set1_epi32(static_cast<int>(split));
+
+    std::size_t index = 0;
+    for(; index + 4 <= count; index += 4) {
+        auto const lanes = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(sizes + index)
+        );
+
+        auto const fits = _mm_or_si128(
+            _mm_cmpeq_epi32(lanes, exact_lanes),
+            _mm_cmpeq_epi32(_mm_max_epu32(lanes, split_lanes), lanes)
+        );
+
+        auto const mask = static_cast<unsigned>(
+            _mm_movemask_ps(_mm_castsi128_ps(fits))
+        );
+
+        if(mask != 0) {
+            return index + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+
+    return index + scan_scalar(sizes + index, count - index, exact, split);
+}
+
+// =============================================================================
+BTX_FIT_SCAN_TARGET("avx2")
+std::size_t scan_avx2(std::uint32_t const *sizes, std::size_t const count,
+                      std::uint32_t const exact, std::uint32_t const split)
+{
+    auto const exact_lanes = _mm256_set1_epi32(static_cast<int>(exact));
+    auto const split_lanes = _mm256_set1_epi32(static_cast<int>(split));
+
+    std::size_t index = 0;
+    for(; index + 8 <= count; index += 8) {
+        auto const lanes = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(sizes + index)
+        );
+
+        auto const fits = _mm256_or_si256(
+            _mm256_cmpeq_epi32(lanes, exact_lanes),
+            _mm256_cmpeq_epi32(_mm256_max_epu32(lanes, split_lanes), lanes)
+        );
+
+        auto const mask = static_cast<unsigned>(
+            _mm256_movemask_ps(_mm256_castsi256_ps(fits))
+        );
+
+        if(mask != 0) {
+            return index + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+
+    return index + scan_scalar(sizes + index, count - index, exact, split);
+}
+
+#endif // BTX_FIT_SCAN_X86
+
+// =============================================================================
+ScanKernel select_kernel() {
+#if defined(BTX_FIT_SCAN_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2")) {
+        return { scan_avx2, "avx2" };
+    }
+
+    if(__builtin_cpu_supports("sse4.1")) {
+        return { scan_sse41, "sse4.1" };
+    }
+#elif defined(BTX_FIT_SCAN_X86)
+    // MSVC only gets here when building for AVX2 outright
+    return { scan_avx2, "avx2" };
+#endif
+
+    return { scan_scalar, "scalar" };
+}
+
+// =============================================================================
+ScanKernel const & kernel() {
+    static ScanKernel const selected = select_kernel();
+    return selected;
+}
+
+} // namespace
+
+// =============================================================================
+std::size_t find_fit_index(std::uint32_t const *sizes, std::size_t const count,
+                           std::uint32_t const exact, std::uint32_t const split)
+{
+    return kernel().scan(sizes, count, exact, split);
+}
+
+// =============================================================================
+std::size_t find_fit_index_scalar(std::uint32_t const *sizes,
+                                  std::size_t const count,
+                                  std::uint32_t const exact,
+                                  std::uint32_t const split)
+{
+    return scan_scalar(sizes, count, exact, split);
+}
+
+// =============================================================================
+char const * fit_scan_kernel() {
+    return kernel().name;
+}
+
+} // namespace btx::memory::detail
@@ -0,0 +1,52 @@
+#include "brasstacks/memory/HeapSnapshot.hpp"
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/log/Log.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace btx::memory::detail {
+
+// =============================================================================
+SnapshotHeader read_snapshot_header(char const *path) {
+    std::FILE *file = std::fopen(path, "rb");
+    if(file == nullptr) {
+        report_snapshot_failure(path, "could not open file");
+    }
+
+    SnapshotHeader header { };
+    SnapshotHeader const expected { };
+
+    auto const read = std::fread(&header, sizeof(header), 1, file);
+    std::fclose(file);
+
+    if(read != 1 || header.magic != expected.magic) {
+        report_snapshot_failure(path, "not a heap snapshot");
+    }
+
+    if(header.version != expected.version) {
+        report_snapshot_failure(path, "unsupported snapshot version");
+    }
+
+    if(header.pointer_size != sizeof(void *)
+       || header.header_size != sizeof(BlockHeader)
+       || header.link_mode != expected.link_mode)
+    {
+        report_snapshot_failure(path, "saved by an incompatible build");
+    }
+
+    return header;
+}
+
+// =============================================================================
+void report_snapshot_error(char const *path, char const *reason) {
+    Log::error("Could not save heap snapshot '{}': {}", path, reason);
+}
+
+// =============================================================================
+void report_snapshot_failure(char const *path, char const *reason) {
+    Log::critical("Could not restore heap snapshot '{}': {}", path, reason);
+    std::abort();
+}
+
+} // namespace btx::memory::detail
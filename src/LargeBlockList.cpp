@@ -0,0 +1,125 @@
+#include "brasstacks/memory/LargeBlockList.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+namespace btx::memory {
+
+// =============================================================================
+LargeBlockList::~LargeBlockList() {
+    clear();
+}
+
+// =============================================================================
+void LargeBlockList::clear() {
+    while(_head != nullptr) {
+        free(BlockHeader::payload(_head));
+    }
+}
+
+// =============================================================================
+void * LargeBlockList::alloc(std::size_t const bytes) {
+    auto const mapped_bytes = vm::page_round(sizeof(BlockHeader) + bytes);
+
+    auto *header = static_cast<BlockHeader *>(vm::map(mapped_bytes));
+    if(header == nullptr) {
+        return nullptr;
+    }
+
+    // The rest of the pages are the payload, so the header records that
+    // rather than what was asked for
+    header->size = mapped_bytes - sizeof(BlockHeader);
+    header->flags = BlockHeader::flag_large;
+
+    _link(header);
+    _used += mapped_bytes;
+    _count += 1;
+
+    return BlockHeader::payload(header);
+}
+
+// =============================================================================
+void * LargeBlockList::realloc(void *address, std::size_t const bytes) {
+    auto *header = BlockHeader::header(address);
+
+    auto const old_mapped_bytes = header->size + sizeof(BlockHeader);
+    auto const new_mapped_bytes = vm::page_round(sizeof(BlockHeader) + bytes);
+
+    if(new_mapped_bytes == old_mapped_bytes) {
+        return address;
+    }
+
+    // The block may move, so take it out of the list while its links are
+    // still where we expect them
+    _unlink(header);
+
+    auto *new_header = static_cast<BlockHeader *>(
+        vm::remap(header, old_mapped_bytes, new_mapped_bytes)
+    );
+
+    if(new_header == nullptr) {
+        _link(header);
+        return nullptr;
+    }
+
+    new_header->size = new_mapped_bytes - sizeof(BlockHeader);
+
+    _link(new_header);
+    _used = _used - old_mapped_bytes + new_mapped_bytes;
+
+    return BlockHeader::payload(new_header);
+}
+
+// =============================================================================
+void LargeBlockList::free(void *address) {
+    auto *header = BlockHeader::header(address);
+    auto const mapped_bytes = header->size + sizeof(BlockHeader);
+
+    _unlink(header);
+    _used -= mapped_bytes;
+    _count -= 1;
+
+    vm::unmap(header, mapped_bytes);
+}
+
+// =============================================================================
+bool LargeBlockList::owns(void const *address) const {
+    for(auto *current_header = _head; current_header != nullptr;
+        current_header = current_header->next)
+    {
+        if(BlockHeader::payload(current_header) == address) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// =============================================================================
+void LargeBlockList::_link(BlockHeader *header) {
+    header->prev = nullptr;
+    header->next = _head;
+
+    if(_head != nullptr) {
+        _head->prev = header;
+    }
+
+    _head = header;
+}
+
+// =============================================================================
+void LargeBlockList::_unlink(BlockHeader *header) {
+    if(header->next != nullptr) {
+        header->next->prev = header->prev;
+    }
+
+    if(header->prev != nullptr) {
+        header->prev->next = header->next;
+    }
+    else {
+        _head = header->next;
+    }
+
+    header->next = nullptr;
+    header->prev = nullptr;
+}
+
+} // namespace btx::memory
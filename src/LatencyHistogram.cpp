@@ -0,0 +1,88 @@
+#include "brasstacks/memory/LatencyHistogram.hpp"
+
+#include <thread>
+
+namespace btx::memory {
+
+// =============================================================================
+double latency_ticks_per_ns() {
+#if defined(BTX_MEMORY_HAS_RDTSC)
+    static double const ticks_per_ns = [] {
+        // Count ticks across a short sleep against the steady clock
+        auto const clock_start = std::chrono::steady_clock::now();
+        auto const tick_start = latency_ticks();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        auto const tick_end = latency_ticks();
+        auto const clock_end = std::chrono::steady_clock::now();
+
+        auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_end - clock_start
+        ).count();
+
+        return static_cast<double>(tick_end - tick_start)
+             / static_cast<double>(ns);
+    }();
+
+    return ticks_per_ns;
+#else
+    return 1.0;
+#endif
+}
+
+// =============================================================================
+std::uint64_t LatencyHistogram::percentile(double const fraction) const {
+    if(_count == 0) {
+        return 0;
+    }
+
+    // Walk the buckets until we've passed the requested share of samples
+    auto const threshold = static_cast<std::uint64_t>(
+        fraction * static_cast<double>(_count) + 0.5
+    );
+
+    std::uint64_t seen = 0;
+    for(std::size_t index = 0; index < _bucket_count; ++index) {
+        seen += _buckets[index];
+        if(seen >= threshold && seen > 0) {
+            auto const high = _bucket_high(index);
+            return high < _max ? high : _max;
+        }
+    }
+
+    return _max;
+}
+
+// =============================================================================
+double LatencyHistogram::mean() const {
+    if(_count == 0) {
+        return 0.0;
+    }
+
+    return static_cast<double>(_total) / static_cast<double>(_count);
+}
+
+// =============================================================================
+void LatencyHistogram::reset() {
+    _buckets.fill(0);
+    _count = 0;
+    _total = 0;
+    _max = 0;
+}
+
+// =============================================================================
+std::uint64_t LatencyHistogram::_bucket_high(std::size_t const index) {
+    if(index < 2 * _sub_bucket_count) {
+        return index;
+    }
+
+    // The inverse of _bucket_index(), reporting the highest value that would
+    // have landed in this bucket
+    auto const magnitude = index / _sub_bucket_count - 1;
+    auto const sub_bucket = index % _sub_bucket_count + _sub_bucket_count;
+
+    return ((static_cast<std::uint64_t>(sub_bucket) + 1) << magnitude) - 1;
+}
+
+} // namespace btx::memory
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "brasstacks/memory/Numa.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#include <vector>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+
+    #include <climits>
+    #include <fstream>
+    #include <string>
+#endif
+
+namespace btx::memory::numa {
+
+#if defined(__linux__)
+namespace {
+
+// The kernel lists nodes as ranges, like "0" or "0-1,4-5"
+std::size_t read_node_count() {
+    std::ifstream possible("/sys/devices/system/node/possible");
+
+    std::string ranges;
+    if(!std::getline(possible, ranges)) {
+        return 1;
+    }
+
+    std::size_t highest = 0;
+    std::size_t value = 0;
+    bool in_number = false;
+
+    for(char const c : ranges) {
+        if(c >= '0' && c <= '9') {
+            value = value * 10 + static_cast<std::size_t>(c - '0');
+            in_number = true;
+        }
+        else {
+            if(in_number && value > highest) {
+                highest = value;
+            }
+            value = 0;
+            in_number = false;
+        }
+    }
+
+    if(in_number && value > highest) {
+        highest = value;
+    }
+
+    return highest + 1;
+}
+
+} // namespace
+#endif
+
+// =============================================================================
+std::size_t node_count() {
+    static std::size_t const count = [] {
+#if defined(_WIN32)
+        ULONG highest = 0;
+        return ::GetNumaHighestNodeNumber(&highest)
+             ? static_cast<std::size_t>(highest) + 1
+             : std::size_t { 1 };
+#elif defined(__linux__)
+        return read_node_count();
+#else
+        return std::size_t { 1 };
+#endif
+    }();
+
+    return count;
+}
+
+// =============================================================================
+std::size_t current_node() {
+#if defined(_WIN32)
+    PROCESSOR_NUMBER processor { };
+    ::GetCurrentProcessorNumberEx(&processor);
+
+    USHORT node = 0;
+    if(!::GetNumaProcessorNodeEx(&processor, &node)) {
+        return 0;
+    }
+
+    return static_cast<std::size_t>(node);
+#elif defined(__linux__)
+    unsigned cpu = 0;
+    unsigned node = 0;
+
+    // Served from the vDSO, so there's no trip into the kernel
+    if(::getcpu(&cpu, &node) != 0) {
+        return 0;
+    }
+
+    return static_cast<std::size_t>(node);
+#else
+    return 0;
+#endif
+}
+
+// =============================================================================
+void * map(std::size_t const bytes, [[maybe_unused]] std::size_t const node) {
+#if defined(_WIN32)
+    return ::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, bytes,
+                                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                                static_cast<DWORD>(node));
+#elif defined(__linux__)
+    void *address = vm::map(bytes);
+    if(address == nullptr) {
+        return nullptr;
+    }
+
+    // Prefer the node rather than insisting on it, so a full node spills
+    // onto its neighbours instead of failing. This goes straight to the
+    // system call to avoid a dependency on libnuma; kernels built without
+    // NUMA support refuse it, leaving placement to first touch.
+    std::size_t constexpr bits = sizeof(unsigned long) * CHAR_BIT;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1ul << (node % bits);
+
+    long constexpr mpol_preferred = 1;
+    [[maybe_unused]] auto const result = ::syscall(
+        SYS_mbind, address, bytes, mpol_preferred, mask.data(),
+        mask.size() * bits + 1, 0
+    );
+
+    return address;
+#else
+    return vm::map(bytes);
+#endif
+}
+
+} // namespace btx::memory::numa
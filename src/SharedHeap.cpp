@@ -0,0 +1,293 @@
+#include "brasstacks/memory/SharedHeap.hpp"
+#include "brasstacks/memory/BasicHeap.hpp"
+#include "brasstacks/memory/FreeList.hpp"
+#include "brasstacks/memory/RelativeLink.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+#include "brasstacks/log/Log.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace btx::memory {
+
+// Like BlockHeader, but always linked relatively, whatever the build
+struct alignas(32) SharedHeap::Block final {
+    std::size_t size;
+
+    RelativeLink<Block> next;
+    RelativeLink<Block> prev;
+};
+
+struct alignas(64) SharedHeap::Control final {
+    std::array<char, 8> magic { 'B', 'T', 'X', 'S', 'H', 'A', 'R', 'E' };
+    std::uint32_t version = 2;
+    std::uint32_t block_size = sizeof(Block);
+
+    std::uint64_t total_size = 0;
+
+    // Set last by the creator, once everything else is in place
+    std::atomic<std::uint32_t> ready { 0 };
+
+    SpinLock lock;
+    HeapStats stats;
+
+    // The tail isn't searched from, but free_list keeps one for BasicHeap
+    RelativeLink<Block> free_head;
+    RelativeLink<Block> free_tail;
+};
+
+// Another process's atomics are only ours to touch if they never fall back on
+// a lock that lives in that process
+static_assert(std::atomic<bool>::is_always_lock_free);
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+namespace {
+
+// =============================================================================
+[[noreturn]] void report_shared_failure(char const *name, char const *reason) {
+    Log::critical("Could not map shared heap '{}': {}", name, reason);
+    std::abort();
+}
+
+// =============================================================================
+std::size_t round_bytes(std::size_t const req_bytes,
+                        std::size_t const multiple)
+{
+    return ((req_bytes + multiple - 1) / multiple) * multiple;
+}
+
+} // namespace
+
+// =============================================================================
+SharedHeap::SharedHeap(char const *name, std::size_t const req_bytes) :
+    _mapped_bytes { vm::page_round(sizeof(Control)
+                                   + round_bytes(req_bytes, sizeof(Block))) }
+{
+    static_assert(sizeof(Block) == 32);
+    static_assert(sizeof(Control) % alignof(Block) == 0);
+
+    _segment = static_cast<std::uint8_t *>(
+        vm::map_shared(name, _mapped_bytes, true)
+    );
+
+    if(_segment == nullptr) {
+        report_shared_failure(name, "could not create segment");
+    }
+
+    _control = ::new(_segment) Control { };
+    _raw_heap = _segment + sizeof(Control);
+    _total_size = _mapped_bytes - sizeof(Control);
+
+    auto *first = reinterpret_cast<Block *>(_raw_heap);
+    first->size = _total_size - sizeof(Block);
+    first->next = nullptr;
+    first->prev = nullptr;
+
+    _control->total_size = _total_size;
+    _control->free_head = first;
+    _control->free_tail = first;
+    _control->stats.on_used(sizeof(Block));
+
+    _control->ready.store(1, std::memory_order_release);
+
+    detail::report_heap_created(_total_size);
+}
+
+// =============================================================================
+SharedHeap::SharedHeap(char const *name) :
+    _mapped_bytes { 0 }
+{
+    _segment = static_cast<std::uint8_t *>(
+        vm::map_shared(name, _mapped_bytes, false)
+    );
+
+    if(_segment == nullptr) {
+        report_shared_failure(name, "could not open segment");
+    }
+
+    Control const expected { };
+
+    _control = reinterpret_cast<Control *>(_segment);
+    if(_mapped_bytes < sizeof(Control)
+       || _control->magic != expected.magic
+       || _control->version != expected.version
+       || _control->block_size != expected.block_size
+       || _control->ready.load(std::memory_order_acquire) == 0)
+    {
+        report_shared_failure(name, "not a shared heap");
+    }
+
+    _raw_heap = _segment + sizeof(Control);
+    _total_size = static_cast<std::size_t>(_control->total_size);
+}
+
+SharedHeap::~SharedHeap() {
+    vm::unmap_shared(_segment, _mapped_bytes);
+}
+
+// =============================================================================
+void SharedHeap::remove(char const *name) {
+    vm::remove_shared(name);
+}
+
+// =============================================================================
+void * SharedHeap::alloc(std::size_t const req_bytes) {
+    void *address = try_alloc(req_bytes);
+
+    if(address == nullptr) {
+        detail::report_alloc_failure(req_bytes);
+    }
+
+    return address;
+}
+
+// =============================================================================
+void * SharedHeap::try_alloc(std::size_t const req_bytes) {
+    if(req_bytes == 0) {
+        detail::report_invalid_request(req_bytes);
+    }
+
+    // Rounding to whole blocks keeps every header aligned
+    std::size_t const bytes = round_bytes(req_bytes, sizeof(Block));
+
+    std::scoped_lock const guard(_control->lock);
+
+    Block *current_header = _control->free_head;
+    while(current_header != nullptr
+          && current_header->size != bytes
+          && current_header->size < bytes + sizeof(Block))
+    {
+        current_header = current_header->next;
+    }
+
+    if(current_header == nullptr) {
+        return nullptr;
+    }
+
+    // Split off whatever's left over if there's room for at least one more
+    // block's worth of payload, otherwise hand out the whole thing
+    if(current_header->size >= bytes + 2 * sizeof(Block)) {
+        auto *new_free_header = reinterpret_cast<Block *>(
+            reinterpret_cast<std::uint8_t *>(current_header + 1) + bytes
+        );
+
+        new_free_header->size = current_header->size - sizeof(Block) - bytes;
+        current_header->size = bytes;
+
+        free_list::replace(_control->free_head, _control->free_tail,
+                           current_header, new_free_header);
+        _control->stats.on_used(sizeof(Block));
+    }
+    else {
+        free_list::unlink(_control->free_head, _control->free_tail,
+                          current_header);
+    }
+
+    _control->stats.on_used(current_header->size);
+    _control->stats.on_alloc();
+
+    return current_header + 1;
+}
+
+// =============================================================================
+void SharedHeap::free(void *address) {
+    if(address == nullptr) {
+        detail::report_invalid_free();
+    }
+
+    auto *header = static_cast<Block *>(address) - 1;
+
+    std::scoped_lock const guard(_control->lock);
+
+    _control->stats.on_released(header->size);
+    _control->stats.on_free();
+
+    free_list::insert(_control->free_head, _control->free_tail, header);
+    _coalesce(header);
+}
+
+// =============================================================================
+std::uint64_t SharedHeap::offset_of(void const *address) const {
+    return static_cast<std::uint64_t>(
+        static_cast<std::uint8_t const *>(address) - _raw_heap
+    );
+}
+
+void * SharedHeap::address_of(std::uint64_t const offset) const {
+    return _raw_heap + offset;
+}
+
+bool SharedHeap::owns(void const *address) const {
+    auto const *byte = static_cast<std::uint8_t const *>(address);
+    return byte >= _raw_heap && byte < _raw_heap + _total_size;
+}
+
+// =============================================================================
+std::size_t SharedHeap::current_used() const {
+    std::scoped_lock const guard(_control->lock);
+    return _control->stats.current_used();
+}
+
+std::size_t SharedHeap::current_allocs() const {
+    std::scoped_lock const guard(_control->lock);
+    return _control->stats.current_allocs();
+}
+
+std::size_t SharedHeap::peak_used() const {
+    std::scoped_lock const guard(_control->lock);
+    return _control->stats.peak_used();
+}
+
+std::size_t SharedHeap::peak_allocs() const {
+    std::scoped_lock const guard(_control->lock);
+    return _control->stats.peak_allocs();
+}
+
+// =============================================================================
+float SharedHeap::calc_fragmentation() const {
+    std::scoped_lock const guard(_control->lock);
+
+    std::size_t total_free = 0;
+    std::size_t largest_free_block_size = 0;
+
+    for(Block *current_header = _control->free_head; current_header != nullptr;
+        current_header = current_header->next)
+    {
+        if(current_header->size > largest_free_block_size) {
+            largest_free_block_size = current_header->size;
+        }
+        total_free += current_header->size;
+    }
+
+    if(total_free == 0) {
+        return 0.0f;
+    }
+
+    return 1.0f - (
+        static_cast<float>(largest_free_block_size)
+        / static_cast<float>(total_free)
+    );
+}
+
+// =============================================================================
+void SharedHeap::_coalesce(Block *header) {
+    // Absorb the following block if it starts right where this one ends
+    Block *next_header = header->next;
+    if(next_header != nullptr && free_list::adjacent(header, next_header)) {
+        free_list::absorb_next(_control->free_head, _control->free_tail,
+                               header);
+        _control->stats.on_released(sizeof(Block));
+    }
+
+    // And be absorbed by the preceding block if this one starts where it ends
+    Block *prev_header = header->prev;
+    if(prev_header != nullptr && free_list::adjacent(prev_header, header)) {
+        free_list::absorb_next(_control->free_head, _control->free_tail,
+                               prev_header);
+        _control->stats.on_released(sizeof(Block));
+    }
+}
+
+} // namespace btx::memory
@@ -0,0 +1,175 @@
+#include "brasstacks/memory/TraceRecorder.hpp"
+#include "brasstacks/log/Log.hpp"
+
+#include <algorithm>
+
+namespace btx::memory {
+
+namespace {
+
+std::atomic<std::uint64_t> next_recorder_id { 1 };
+
+// Each thread remembers which ring it was handed by the last recorder it
+// wrote to, which saves a trip through _rings_mutex on every record
+struct ThreadRingCache final {
+    std::uint64_t recorder_id = 0;
+    void *ring = nullptr;
+};
+
+thread_local ThreadRingCache ring_cache;
+
+} // namespace
+
+// =============================================================================
+void TraceRecorder::record(TraceOp const op, std::uint64_t const size,
+                           std::uint64_t const offset)
+{
+    Ring &ring = _thread_ring();
+
+    auto const head = ring.head.load(std::memory_order_relaxed);
+
+    // If the ring is full, this thread becomes a consumer for a moment
+    if(head - ring.tail.load(std::memory_order_acquire) == Ring::capacity) {
+        flush();
+    }
+
+    auto const now = std::chrono::steady_clock::now();
+
+    auto &record = ring.records[head & (Ring::capacity - 1)];
+    record.timestamp = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - _start)
+            .count()
+    );
+    record.offset = offset;
+    record.size = size;
+    record.thread = ring.thread;
+    record.op = op;
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+// =============================================================================
+void TraceRecorder::flush() {
+    std::scoped_lock const flush_lock(_flush_mutex);
+
+    // Rings are never removed, so it's enough to know how many there are
+    std::size_t ring_count = 0;
+    {
+        std::scoped_lock const rings_lock(_rings_mutex);
+        ring_count = _rings.size();
+    }
+
+    for(std::size_t i = 0; i < ring_count; ++i) {
+        Ring *ring = nullptr;
+        {
+            std::scoped_lock const rings_lock(_rings_mutex);
+            ring = _rings[i].get();
+        }
+        _drain(*ring);
+    }
+
+    std::fflush(_file);
+}
+
+// =============================================================================
+std::vector<TraceRecord> TraceRecorder::read(char const *path) {
+    std::vector<TraceRecord> records;
+
+    std::FILE *file = std::fopen(path, "rb");
+    if(file == nullptr) {
+        Log::error("Could not open trace file '{}'", path);
+        return records;
+    }
+
+    TraceFileHeader const expected { };
+    TraceFileHeader header { };
+
+    if(std::fread(&header, sizeof(header), 1, file) != 1
+       || header.magic != expected.magic
+       || header.version == 0
+       || header.version > expected.version
+       || header.record_size != expected.record_size)
+    {
+        Log::error("'{}' is not a valid trace file", path);
+        std::fclose(file);
+        return records;
+    }
+
+    TraceRecord record { };
+    while(std::fread(&record, sizeof(record), 1, file) == 1) {
+        records.push_back(record);
+    }
+
+    std::fclose(file);
+    return records;
+}
+
+// =============================================================================
+TraceRecorder::TraceRecorder(char const *path) :
+    _id              { next_recorder_id.fetch_add(1) },
+    _file            { std::fopen(path, "wb") },
+    _start           { std::chrono::steady_clock::now() },
+    _records_written { 0 }
+{
+    if(_file == nullptr) {
+        Log::critical("Could not open trace file '{}'", path);
+    }
+
+    TraceFileHeader const header { };
+    std::fwrite(&header, sizeof(header), 1, _file);
+
+    Log::trace("Recording allocation trace to '{}'", path);
+}
+
+TraceRecorder::~TraceRecorder() {
+    flush();
+    std::fclose(_file);
+}
+
+// =============================================================================
+TraceRecorder::Ring & TraceRecorder::_thread_ring() {
+    if(ring_cache.recorder_id == _id) {
+        return *static_cast<Ring *>(ring_cache.ring);
+    }
+
+    std::scoped_lock const rings_lock(_rings_mutex);
+
+    // This thread may have written to this recorder before, in between
+    // writes to another one
+    auto const owner = std::this_thread::get_id();
+    auto ring = std::find_if(_rings.begin(), _rings.end(),
+        [owner](auto const &candidate) { return candidate->owner == owner; }
+    );
+
+    if(ring == _rings.end()) {
+        ring = _rings.insert(_rings.end(), std::make_unique<Ring>());
+        (*ring)->owner = owner;
+        (*ring)->thread = static_cast<std::uint32_t>(_rings.size() - 1);
+    }
+
+    ring_cache.recorder_id = _id;
+    ring_cache.ring = ring->get();
+
+    return **ring;
+}
+
+// =============================================================================
+void TraceRecorder::_drain(Ring &ring) {
+    auto const head = ring.head.load(std::memory_order_acquire);
+    auto tail = ring.tail.load(std::memory_order_relaxed);
+
+    while(tail != head) {
+        // Write out the longest contiguous run before the ring wraps
+        auto const start = tail & (Ring::capacity - 1);
+        auto const count = std::min(head - tail, Ring::capacity - start);
+
+        std::fwrite(&ring.records[start], sizeof(TraceRecord), count, _file);
+
+        tail += count;
+        _records_written += count;
+    }
+
+    ring.tail.store(tail, std::memory_order_release);
+}
+
+} // namespace btx::memory
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+namespace btx::memory::vm {
+
+#if !defined(_WIN32)
+namespace {
+
+// Linux 4.17 and later refuse to map over anything already at the address.
+// Elsewhere, and on older kernels that ignore the flag, it's only a hint, so
+// the result is checked either way.
+#if defined(MAP_FIXED_NOREPLACE)
+int constexpr map_exact = MAP_FIXED_NOREPLACE;
+#else
+int constexpr map_exact = 0;
+#endif
+
+void * exact_or_null(void *address, void *wanted, std::size_t const bytes) {
+    if(address == MAP_FAILED) {
+        return nullptr;
+    }
+
+    if(address != wanted) {
+        ::munmap(address, bytes);
+        return nullptr;
+    }
+
+    return address;
+}
+
+} // namespace
+#endif
+
+// =============================================================================
+std::size_t page_size() {
+    static std::size_t const size = [] {
+#if defined(_WIN32)
+        SYSTEM_INFO info { };
+        ::GetSystemInfo(&info);
+        return static_cast<std::size_t>(info.dwPageSize);
+#else
+        return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+    }();
+
+    return size;
+}
+
+// =============================================================================
+std::size_t page_round(std::size_t const bytes) {
+    auto const page = page_size();
+    return ((bytes + page - 1) / page) * page;
+}
+
+// =============================================================================
+void * map(std::size_t const bytes) {
+#if defined(_WIN32)
+    return ::VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT,
+                          PAGE_READWRITE);
+#else
+    void *address = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return address == MAP_FAILED ? nullptr : address;
+#endif
+}
+
+// =============================================================================
+void * remap(void *address, std::size_t const old_bytes,
+             std::size_t const new_bytes)
+{
+#if defined(__linux__)
+    // Linux can move the page table entries rather than the bytes
+    void *new_address = ::mremap(address, old_bytes, new_bytes, MREMAP_MAYMOVE);
+
+    return new_address == MAP_FAILED ? nullptr : new_address;
+#else
+    void *new_address = map(new_bytes);
+    if(new_address == nullptr) {
+        return nullptr;
+    }
+
+    std::memcpy(new_address, address, std::min(old_bytes, new_bytes));
+    unmap(address, old_bytes);
+
+    return new_address;
+#endif
+}
+
+// =============================================================================
+void unmap(void *address, [[maybe_unused]] std::size_t const bytes) {
+#if defined(_WIN32)
+    ::VirtualFree(address, 0, MEM_RELEASE);
+#else
+    ::munmap(address, bytes);
+#endif
+}
+
+// =============================================================================
+void * reserve(std::size_t const bytes) {
+#if defined(_WIN32)
+    return ::VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    // No swap is set aside for the range either, so reserving more than the
+    // machine could ever back still succeeds
+    void *address = ::mmap(nullptr, bytes, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    return address == MAP_FAILED ? nullptr : address;
+#endif
+}
+
+// =============================================================================
+void * reserve_at(void *address, std::size_t const bytes) {
+#if defined(_WIN32)
+    // An address that isn't on the allocation granularity is rounded down
+    void *reserved = ::VirtualAlloc(address, bytes, MEM_RESERVE,
+                                    PAGE_NOACCESS);
+    if(reserved != nullptr && reserved != address) {
+        ::VirtualFree(reserved, 0, MEM_RELEASE);
+        return nullptr;
+    }
+
+    return reserved;
+#else
+    void *reserved = ::mmap(address, bytes, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE
+                            | map_exact,
+                            -1, 0);
+
+    return exact_or_null(reserved, address, bytes);
+#endif
+}
+
+// =============================================================================
+bool commit(void *address, std::size_t const bytes) {
+#if defined(_WIN32)
+    return ::VirtualAlloc(address, bytes, MEM_COMMIT, PAGE_READWRITE)
+        != nullptr;
+#else
+    return ::mprotect(address, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+// =============================================================================
+void decommit(void *address, std::size_t const bytes) {
+#if defined(_WIN32)
+    ::VirtualFree(address, bytes, MEM_DECOMMIT);
+#else
+    // Dropping the pages first means they're gone even if mprotect() is
+    // refused, and come back zeroed when recommitted
+    ::madvise(address, bytes, MADV_DONTNEED);
+    ::mprotect(address, bytes, PROT_NONE);
+#endif
+}
+
+// =============================================================================
+void discard([[maybe_unused]] void *address,
+             [[maybe_unused]] std::size_t const bytes)
+{
+#if !defined(_WIN32)
+    ::madvise(address, bytes, MADV_DONTNEED);
+#endif
+}
+
+// =============================================================================
+void * map_file(char const *path, std::size_t &bytes, void *hint,
+                bool const exact)
+{
+#if defined(_WIN32)
+    HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER size { };
+    if(!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        ::CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0,
+                                          nullptr);
+    ::CloseHandle(file);
+
+    if(mapping == nullptr) {
+        return nullptr;
+    }
+
+    // Unlike mmap(), a hint that can't be honoured fails outright
+    void *address = ::MapViewOfFileEx(mapping, FILE_MAP_COPY, 0, 0, 0, hint);
+    if(address == nullptr && hint != nullptr && !exact) {
+        address = ::MapViewOfFileEx(mapping, FILE_MAP_COPY, 0, 0, 0, nullptr);
+    }
+
+    ::CloseHandle(mapping);
+
+    if(address != nullptr) {
+        bytes = static_cast<std::size_t>(size.QuadPart);
+    }
+
+    return address;
+#else
+    int const file = ::open(path, O_RDONLY);
+    if(file < 0) {
+        return nullptr;
+    }
+
+    struct stat status { };
+    if(::fstat(file, &status) != 0 || status.st_size <= 0) {
+        ::close(file);
+        return nullptr;
+    }
+
+    auto const size = static_cast<std::size_t>(status.st_size);
+
+    void *address = ::mmap(hint, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | (exact ? map_exact : 0), file, 0);
+    ::close(file);
+
+    address = exact ? exact_or_null(address, hint, size)
+                    : (address == MAP_FAILED ? nullptr : address);
+
+    if(address == nullptr) {
+        return nullptr;
+    }
+
+    bytes = size;
+    return address;
+#endif
+}
+
+// =============================================================================
+void unmap_file(void *address, [[maybe_unused]] std::size_t const bytes) {
+#if defined(_WIN32)
+    ::UnmapViewOfFile(address);
+#else
+    ::munmap(address, bytes);
+#endif
+}
+
+// =============================================================================
+void * map_shared(char const *name, std::size_t &bytes, bool const create) {
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+
+    if(create) {
+        auto const size = static_cast<unsigned long long>(bytes);
+        mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+                                       PAGE_READWRITE,
+                                       static_cast<DWORD>(size >> 32),
+                                       static_cast<DWORD>(size), name);
+
+        if(mapping != nullptr && ::GetLastError() == ERROR_ALREADY_EXISTS) {
+            ::CloseHandle(mapping);
+            return nullptr;
+        }
+    }
+    else {
+        mapping = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    }
+
+    if(mapping == nullptr) {
+        return nullptr;
+    }
+
+    // The view keeps the segment alive once the handle's gone
+    void *address = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    ::CloseHandle(mapping);
+
+    if(address != nullptr && !create) {
+        MEMORY_BASIC_INFORMATION info { };
+        ::VirtualQuery(address, &info, sizeof(info));
+        bytes = info.RegionSize;
+    }
+
+    return address;
+#else
+    int const flags = create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR;
+
+    int const segment = ::shm_open(name, flags, 0600);
+    if(segment < 0) {
+        return nullptr;
+    }
+
+    if(create) {
+        if(::ftruncate(segment, static_cast<off_t>(bytes)) != 0) {
+            ::close(segment);
+            ::shm_unlink(name);
+            return nullptr;
+        }
+    }
+    else {
+        struct stat status { };
+        if(::fstat(segment, &status) != 0 || status.st_size <= 0) {
+            ::close(segment);
+            return nullptr;
+        }
+
+        bytes = static_cast<std::size_t>(status.st_size);
+    }
+
+    void *address = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           segment, 0);
+    ::close(segment);
+
+    if(address == MAP_FAILED) {
+        if(create) {
+            ::shm_unlink(name);
+        }
+        return nullptr;
+    }
+
+    return address;
+#endif
+}
+
+// =============================================================================
+void unmap_shared(void *address, [[maybe_unused]] std::size_t const bytes) {
+#if defined(_WIN32)
+    ::UnmapViewOfFile(address);
+#else
+    ::munmap(address, bytes);
+#endif
+}
+
+// =============================================================================
+void remove_shared([[maybe_unused]] char const *name) {
+#if !defined(_WIN32)
+    ::shm_unlink(name);
+#endif
+}
+
+} // namespace btx::memory::vm
@@ -61,16 +61,16 @@ TEST_CASE("Allocate and free three blocks, free a->b->c") {
     // Given 64+96=160 bytes total free, fragmentation is ~0.4
     REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.4f, epsilon));
 
-    // header_a has become the "true" free_header, which means the next pointer
-    // directs us to the free chunk at the end of the heap
-    REQUIRE(header_a->next == free_header);
+    // header_a has become the "true" free_header, but the free chunk at the
+    // end of the heap is the top chunk, which is never on the free list
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
     REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_a);
+    REQUIRE(free_header->prev == nullptr);
 
     // header_a, while now free, has the same size as it did before
     REQUIRE(header_a->size == 64);
@@ -89,16 +89,17 @@ TEST_CASE("Allocate and free three blocks, free a->b->c") {
     // Given 192+96=288 bytes total free, fragmentation is ~0.33
     REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs((1.0f/3.0f), epsilon));
 
-    // header_a->next still  points to the free block at the end of the heap
-    // since it just absorbed alloc_b
-    REQUIRE(header_a->next == free_header);
+    // header_a just absorbed alloc_b, but it still has nothing to link to:
+    // the free block at the end of the heap is the top chunk, which is never
+    // on the free list
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
     REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_a);
+    REQUIRE(free_header->prev == nullptr);
 
     // But the size has grown by size_b and sizeof(BlockHeader)
     REQUIRE(header_a->size == 192);
@@ -165,16 +166,16 @@ TEST_CASE("Allocate and free three blocks, free a->c->b") {
     // Given 64+96=160 bytes total free, fragmentation is ~0.4
     REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.4f, epsilon));
 
-    // header_a has become the "true" free_header, which means the next pointer
-    // directs us to the free chunk at the end of the heap
-    REQUIRE(header_a->next == free_header);
+    // header_a has become the "true" free_header, but the free chunk at the
+    // end of the heap is the top chunk, which is never on the free list
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
     REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_a);
+    REQUIRE(free_header->prev == nullptr);
 
     // header_a, while now free, has the same size as it did before
     REQUIRE(header_a->size == 64);
@@ -189,13 +190,14 @@ TEST_CASE("Allocate and free three blocks, free a->c->b") {
     REQUIRE(heap.peak_used() == 416);
     REQUIRE(heap.peak_allocs() == 3);
 
-    // header_a is still the top of the free list, but now it points to b
-    REQUIRE(header_a->next == header_c);
+    // header_a is still the top of the free list, and header_c now heads the
+    // top chunk, which isn't on it
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
-    REQUIRE(header_c->prev == header_a);
+    REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
     REQUIRE(free_header->prev == nullptr);
 
@@ -263,16 +265,16 @@ TEST_CASE("Allocate and free three blocks, free b->a->c") {
     // alloc_b is now free and is 96 bytes, so we're at ~0.5 fragmentation
     REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.5f, epsilon));
 
-    // With header_b now technically a free header, its next pointer will
-    // lead to the original free_header
+    // header_b is now technically a free header, but the original
+    // free_header is the top chunk, so the two aren't linked
     REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
-    REQUIRE(header_b->next == free_header);
+    REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
     REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_b);
+    REQUIRE(free_header->prev == nullptr);
 
     // Both header_b and free_header will have the same sizes as before
     REQUIRE(header_b->size == 96);
@@ -291,15 +293,16 @@ TEST_CASE("Allocate and free three blocks, free b->a->c") {
     // a and b taken together gives us 192 bytes, so ~0.3 fragmentation
     REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs((1.0f/3.0f), epsilon));
 
-    // header_a->next now jumps to the original free_header
-    REQUIRE(header_a->next == free_header);
+    // header_a now covers a and b, but it still isn't linked to the original
+    // free_header, which is the top chunk, which is never on the free list
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
     REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_a);
+    REQUIRE(free_header->prev == nullptr);
 
     // header_a->size has grown to encompass both a and b, but free_header
     // stays the same
@@ -367,14 +370,14 @@ TEST_CASE("Allocate and free three blocks, free b->c->a") {
     // alloc_b is now free and is 96 bytes, so we're at ~0.5 fragmentation
     REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.5f, epsilon));
 
-    // With header_b now technically the free header, its next pointer will
-    // lead to the original free_header
+    // header_b is now technically the free header, but the original
+    // free_header is the top chunk, so the two aren't linked
     REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
-    REQUIRE(header_b->next == free_header);
+    REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_b);
+    REQUIRE(free_header->prev == nullptr);
 
     // Both header_b and free_header will have the same sizes as before
     REQUIRE(header_b->size == 96);
@@ -491,13 +494,13 @@ TEST_CASE("Allocate and free three blocks, free c->a->b") {
     REQUIRE(heap.peak_used() == 416);
     REQUIRE(heap.peak_allocs() == 3);
 
-    // The free list pointers skip over alloc_b
-    REQUIRE(header_a->next == header_c);
+    // header_a is alone on the free list, since header_c heads the top chunk
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_c->next == nullptr);
-    REQUIRE(header_c->prev == header_a);
+    REQUIRE(header_c->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
     REQUIRE(free_header->prev == nullptr);
 
@@ -80,9 +80,9 @@ TEST_CASE("Allocate four blocks, free a and c, then allocate a block that's "
     // As does free_header
     REQUIRE(free_header->size == 128);
 
-    // header_a has become the "true" free_header, which means the next pointer
-    // directs us to the free chunk at the end of the heap
-    REQUIRE(header_a->next == free_header);
+    // header_a has become the "true" free_header, but the free chunk at the
+    // end of the heap is the top chunk, which is never on the free list
+    REQUIRE(header_a->next == nullptr);
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
@@ -91,7 +91,7 @@ TEST_CASE("Allocate four blocks, free a and c, then allocate a block that's "
     REQUIRE(header_d->next == nullptr);
     REQUIRE(header_d->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_a);
+    REQUIRE(free_header->prev == nullptr);
 
     //--------------------------------------------------------------------------
     // Free alloc_c
@@ -113,12 +113,12 @@ TEST_CASE("Allocate four blocks, free a and c, then allocate a block that's "
     REQUIRE(header_a->prev == nullptr);
     REQUIRE(header_b->next == nullptr);
     REQUIRE(header_b->prev == nullptr);
-    REQUIRE(header_c->next == free_header);
+    REQUIRE(header_c->next == nullptr);
     REQUIRE(header_c->prev == header_a);
     REQUIRE(header_d->next == nullptr);
     REQUIRE(header_d->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == header_c);
+    REQUIRE(free_header->prev == nullptr);
 
     //--------------------------------------------------------------------------
     // Allocate a smaller chunk where alloc_d used to be, but larger than
@@ -146,12 +146,12 @@ TEST_CASE("Allocate four blocks, free a and c, then allocate a block that's "
     REQUIRE(header_b->prev == nullptr);
     REQUIRE(header_e->next == nullptr);
     REQUIRE(header_e->prev == nullptr);
-    REQUIRE(free_half_of_c->next == free_header);
+    REQUIRE(free_half_of_c->next == nullptr);
     REQUIRE(free_half_of_c->prev == header_a);
     REQUIRE(header_d->next == nullptr);
     REQUIRE(header_d->prev == nullptr);
     REQUIRE(free_header->next == nullptr);
-    REQUIRE(free_header->prev == free_half_of_c);
+    REQUIRE(free_header->prev == nullptr);
 
     // And the size of the new free half of C
     REQUIRE(free_half_of_c->size == 96);
@@ -0,0 +1,183 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/TraceRecorder.hpp"
+
+#include "test_helpers.hpp"
+
+#include <filesystem>
+#include <thread>
+
+using namespace btx::memory;
+
+TEST_CASE("Trace records round trip through a file") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_trace_basic.bin")
+        .string();
+
+    {
+        TraceRecorder recorder(path.c_str());
+        recorder.record(TraceOp::alloc, 64, 32);
+        recorder.record(TraceOp::alloc, 96, 128);
+        recorder.record(TraceOp::free, 64, 32);
+    }
+
+    auto const records = TraceRecorder::read(path.c_str());
+    REQUIRE(records.size() == 3);
+
+    REQUIRE(records[0].op == TraceOp::alloc);
+    REQUIRE(records[0].size == 64);
+    REQUIRE(records[0].offset == 32);
+
+    REQUIRE(records[1].op == TraceOp::alloc);
+    REQUIRE(records[1].size == 96);
+    REQUIRE(records[1].offset == 128);
+
+    REQUIRE(records[2].op == TraceOp::free);
+    REQUIRE(records[2].size == 64);
+    REQUIRE(records[2].offset == 32);
+
+    // Timestamps come from a steady clock, so they never go backwards
+    REQUIRE(records[0].timestamp <= records[1].timestamp);
+    REQUIRE(records[1].timestamp <= records[2].timestamp);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Trace rings wrap and drain from several threads") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_trace_threads.bin")
+        .string();
+
+    std::size_t constexpr thread_count = 4;
+    std::size_t constexpr records_per_thread = 10'000; // More than one ring
+
+    {
+        TraceRecorder recorder(path.c_str());
+
+        std::vector<std::thread> threads;
+        for(std::size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&recorder] {
+                for(std::size_t i = 0; i < records_per_thread; ++i) {
+                    recorder.record(TraceOp::alloc, i, i);
+                }
+            });
+        }
+
+        for(auto &thread : threads) {
+            thread.join();
+        }
+
+        recorder.flush();
+        REQUIRE(recorder.records_written() == thread_count * records_per_thread);
+    }
+
+    auto const records = TraceRecorder::read(path.c_str());
+    REQUIRE(records.size() == thread_count * records_per_thread);
+
+    // Each thread's records arrive in the order that thread wrote them
+    std::vector<std::uint64_t> next_expected(thread_count, 0);
+    for(auto const &record : records) {
+        REQUIRE(record.thread < thread_count);
+        REQUIRE(record.size == next_expected[record.thread]);
+        ++next_expected[record.thread];
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("A trace file with a bad header reads back empty") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_trace_bad.bin")
+        .string();
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    REQUIRE(file != nullptr);
+    std::fputs("definitely not a trace", file);
+    std::fclose(file);
+
+    REQUIRE(TraceRecorder::read(path.c_str()).empty());
+
+    std::filesystem::remove(path);
+}
+
+#ifdef BTX_MEMORY_TRACE
+TEST_CASE("Heap alloc and free are traced as payload offsets") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_trace_heap.bin")
+        .string();
+
+    {
+        TraceRecorder recorder(path.c_str());
+        Heap heap(512);
+        heap.set_trace_recorder(&recorder);
+
+        void *alloc_a = heap.alloc(60);
+        void *alloc_b = heap.alloc(96);
+        heap.free(alloc_a);
+        heap.free(alloc_b);
+
+        heap.set_trace_recorder(nullptr);
+    }
+
+    auto const records = TraceRecorder::read(path.c_str());
+    REQUIRE(records.size() == 4);
+
+    // The first payload sits just past the first BlockHeader, and the requested
+    // size is recorded rather than the rounded one
+    REQUIRE(records[0].op == TraceOp::alloc);
+    REQUIRE(records[0].size == 60);
+    REQUIRE(records[0].offset == 32);
+
+    REQUIRE(records[1].op == TraceOp::alloc);
+    REQUIRE(records[1].offset == 128);
+
+    REQUIRE(records[2].op == TraceOp::free);
+    REQUIRE(records[2].offset == 32);
+
+    REQUIRE(records[3].op == TraceOp::free);
+    REQUIRE(records[3].offset == 128);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Large blocks are traced by address with ops of their own") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_trace_large.bin")
+        .string();
+
+    void *large = nullptr;
+    void *moved = nullptr;
+
+    {
+        TraceRecorder recorder(path.c_str());
+        Heap heap(4096);
+        heap.set_large_threshold(1024);
+        heap.set_trace_recorder(&recorder);
+
+        large = heap.alloc(8192);
+        moved = heap.realloc(large, 1 << 20);
+        heap.free(moved);
+
+        heap.set_trace_recorder(nullptr);
+    }
+
+    auto const records = TraceRecorder::read(path.c_str());
+    REQUIRE(records.size() == 4);
+
+    REQUIRE(records[0].op == TraceOp::alloc_large);
+    REQUIRE(records[0].size == 8192);
+    REQUIRE(records[0].offset == reinterpret_cast<std::uintptr_t>(large));
+
+    // Growing it is a free and an alloc, wherever it ended up
+    REQUIRE(records[1].op == TraceOp::free_large);
+    REQUIRE(records[1].offset == records[0].offset);
+
+    REQUIRE(records[2].op == TraceOp::alloc_large);
+    REQUIRE(records[2].size == 1 << 20);
+    REQUIRE(records[2].offset == reinterpret_cast<std::uintptr_t>(moved));
+
+    REQUIRE(records[3].op == TraceOp::free_large);
+    REQUIRE(records[3].offset == records[2].offset);
+
+    std::filesystem::remove(path);
+}
+#endif
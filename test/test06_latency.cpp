@@ -0,0 +1,79 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/LatencyHistogram.hpp"
+
+#include "test_helpers.hpp"
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Latency histogram percentiles") {
+    LatencyHistogram histogram;
+
+    REQUIRE(histogram.count() == 0);
+    REQUIRE(histogram.p50() == 0);
+    REQUIRE(histogram.max() == 0);
+
+    // Small values are counted exactly
+    for(std::uint64_t value = 1; value <= 50; ++value) {
+        histogram.record(value);
+    }
+
+    REQUIRE(histogram.count() == 50);
+    REQUIRE(histogram.p50() == 25);
+    REQUIRE(histogram.max() == 50);
+    REQUIRE_THAT(histogram.mean(), WithinAbs(25.5, epsilon));
+
+    histogram.reset();
+    REQUIRE(histogram.count() == 0);
+    REQUIRE(histogram.max() == 0);
+
+    // Larger values land within a sub-bucket of the truth
+    for(std::uint64_t value = 1; value <= 100'000; ++value) {
+        histogram.record(value);
+    }
+
+    REQUIRE_THAT(static_cast<double>(histogram.p50()),
+                 WithinRel(50'000.0, 0.04));
+    REQUIRE_THAT(static_cast<double>(histogram.p99()),
+                 WithinRel(99'000.0, 0.04));
+    REQUIRE_THAT(static_cast<double>(histogram.p999()),
+                 WithinRel(99'900.0, 0.04));
+    REQUIRE(histogram.max() == 100'000);
+
+    // Percentiles never report beyond the largest recorded value
+    REQUIRE(histogram.percentile(1.0) == 100'000);
+}
+
+TEST_CASE("Latency histogram keeps a single outlier in the tail") {
+    LatencyHistogram histogram;
+
+    for(std::size_t i = 0; i < 9'999; ++i) {
+        histogram.record(40);
+    }
+    histogram.record(1'000'000);
+
+    REQUIRE(histogram.p50() == 40);
+    REQUIRE(histogram.p99() == 40);
+    REQUIRE(histogram.max() == 1'000'000);
+    REQUIRE_THAT(static_cast<double>(histogram.percentile(1.0)),
+                 WithinRel(1'000'000.0, 0.04));
+}
+
+#ifdef BTX_MEMORY_LATENCY
+TEST_CASE("Heap records the latency of every alloc and free") {
+    Heap heap(1024);
+
+    void *alloc_a = heap.alloc(64);
+    void *alloc_b = heap.alloc(128);
+    heap.free(alloc_a);
+
+    REQUIRE(heap.alloc_latency().count() == 2);
+    REQUIRE(heap.free_latency().count() == 1);
+
+    heap.reset_latency();
+    heap.free(alloc_b);
+
+    REQUIRE(heap.alloc_latency().count() == 0);
+    REQUIRE(heap.free_latency().count() == 1);
+}
+#endif
\ No newline at end of file
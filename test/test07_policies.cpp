@@ -0,0 +1,268 @@
+#include "brasstacks/memory/BasicHeap.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+#include <catch2/catch_template_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+template<typename FitPolicy>
+using FitHeap = BasicHeap<FitPolicy, NoLock, HeapStats, sizeof(void *)>;
+
+TEMPLATE_TEST_CASE("Random churn returns the heap to a single block",
+                   "[policies]",
+                   FirstFit, IndexedFirstFit, BestFit, NextFit, SegregatedFit)
+{
+    std::size_t const heap_size = 8 << 20;
+    FitHeap<TestType> heap(heap_size);
+
+    auto const result = churn(
+        heap, [&heap](ChurnBlock const &block) { heap.free(block.address); },
+        1234, 512, 20'000
+    );
+    REQUIRE(result.intact);
+
+    for(auto const &block : result.live) {
+        heap.free(block.address);
+    }
+
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    // And the whole heap can be handed out again in one piece
+    void *everything = heap.alloc(heap_size - sizeof(BlockHeader));
+    REQUIRE(everything != nullptr);
+    heap.free(everything);
+}
+
+TEST_CASE("Best-fit takes the smallest hole that fits") {
+    FitHeap<BestFit> heap(1024);
+
+    // Leave a 128 byte hole, then a 64 byte hole, with blocks between them
+    void *big_hole = heap.alloc(128);
+    void *fence_a = heap.alloc(32);
+    void *small_hole = heap.alloc(64);
+    void *fence_b = heap.alloc(32);
+
+    heap.free(big_hole);
+    heap.free(small_hole);
+
+    // First-fit would take the earlier 128 byte hole
+    REQUIRE(heap.alloc(64) == small_hole);
+    REQUIRE(heap.alloc(128) == big_hole);
+
+    heap.free(fence_a);
+    heap.free(fence_b);
+}
+
+TEST_CASE("Next-fit resumes where the last search succeeded") {
+    FitHeap<NextFit> heap(1024);
+
+    void *hole_a = heap.alloc(64);
+    void *fence_a = heap.alloc(32);
+    void *hole_b = heap.alloc(64);
+    void *fence_b = heap.alloc(32);
+
+    heap.free(hole_a);
+    heap.free(hole_b);
+
+    // The last allocation came off the top chunk, so that's where the next
+    // search starts, and the holes up front are skipped
+    REQUIRE(heap.fit_state().prefers_top());
+    REQUIRE(heap.fit_state().rover() == nullptr);
+
+    void *tail_alloc = heap.alloc(64);
+    REQUIRE(BlockHeader::header(tail_alloc) > BlockHeader::header(fence_b));
+
+    // Use up the rest of the top chunk, and the search wraps to the front
+    auto *top = reinterpret_cast<BlockHeader *>(
+        static_cast<std::uint8_t *>(tail_alloc) + 64
+    );
+    void *rest = heap.alloc(top->size);
+
+    REQUIRE(heap.alloc(64) == hole_a);
+    REQUIRE_FALSE(heap.fit_state().prefers_top());
+
+    // The rover now sits past hole_a, so hole_b is next in line
+    REQUIRE(heap.alloc(64) == hole_b);
+
+    heap.free(fence_a);
+    heap.free(fence_b);
+    heap.free(tail_alloc);
+    heap.free(rest);
+}
+
+TEST_CASE("Next-fit's rover survives coalescing") {
+    std::size_t const heap_size = 1024;
+    FitHeap<NextFit> heap(heap_size);
+
+    // The fence takes the whole top chunk, so every search below has to go
+    // through the free list
+    void *block_a = heap.alloc(64);
+    void *block_b = heap.alloc(128);
+    void *fence = heap.alloc(heap_size - 3 * sizeof(BlockHeader) - 64 - 128);
+    heap.free(block_b);
+
+    // Splitting block_b leaves the rover on what's left of it
+    void *front_of_b = heap.alloc(32);
+    auto *remainder = heap.fit_state().rover();
+    REQUIRE(remainder == reinterpret_cast<BlockHeader *>(
+        static_cast<std::uint8_t *>(front_of_b) + 32
+    ));
+
+    // Freeing block_a coalesces nothing, and leaves the rover alone
+    heap.free(block_a);
+    REQUIRE(heap.fit_state().rover() == remainder);
+
+    // Freeing the front of block_b merges the remainder into it, and then all
+    // of it into block_a. The rover can't be left on the absorbed header.
+    heap.free(front_of_b);
+    REQUIRE(heap.fit_state().rover() != remainder);
+
+    // And the next search still works from wherever it ended up
+    REQUIRE(heap.alloc(64) == block_a);
+
+    heap.free(fence);
+}
+
+TEST_CASE("Next-fit's rover only ever points at free blocks") {
+    FitHeap<NextFit> heap(1 << 20);
+
+    std::minstd_rand rng(4321);
+    std::uniform_int_distribution<std::size_t> size_dist(1, 256);
+
+    std::vector<void *> live;
+
+    auto const rover_is_free = [&heap, &live] {
+        auto const *rover = reinterpret_cast<std::uint8_t const *>(
+            heap.fit_state().rover()
+        );
+        if(rover == nullptr) {
+            return true;
+        }
+
+        if(!heap.owns(rover)) {
+            return false;
+        }
+
+        // It mustn't land on, or inside, anything that's been handed out
+        return std::none_of(live.begin(), live.end(), [rover](void *address) {
+            auto const *header = reinterpret_cast<std::uint8_t const *>(
+                BlockHeader::header(address)
+            );
+            auto const *end = static_cast<std::uint8_t const *>(address)
+                            + BlockHeader::header(address)->size;
+            return rover >= header && rover < end;
+        });
+    };
+
+    for(std::size_t i = 0; i < 5'000; ++i) {
+        if(live.empty() || rng() % 2 == 0) {
+            live.push_back(heap.alloc(size_dist(rng)));
+        }
+        else {
+            auto const index = rng() % live.size();
+            heap.free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        REQUIRE(rover_is_free());
+    }
+
+    for(void *address : live) {
+        heap.free(address);
+    }
+
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Segregated-fit rounds requests up to hold its bin links") {
+    FitHeap<SegregatedFit> heap(1024);
+
+    void *tiny = heap.alloc(1);
+    REQUIRE(BlockHeader::header(tiny)->size == SegregatedFit::min_payload);
+
+    heap.free(tiny);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Heaps without stats carry no counters") {
+    using LeanHeap = BasicHeap<FirstFit, NoLock, NoStats, sizeof(void *)>;
+
+    // Heap's extra size must cover both its counters and the watermark table
+    // that only makes sense alongside them
+    REQUIRE(sizeof(Heap) - sizeof(LeanHeap)
+            >= sizeof(HeapStats)
+               + LeanHeap::max_watermarks * 3 * sizeof(void *));
+
+    LeanHeap heap(512);
+    void *alloc_a = heap.alloc(64);
+    void *alloc_b = heap.alloc(64);
+    heap.free(alloc_a);
+    heap.free(alloc_b);
+
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+}
+
+TEMPLATE_TEST_CASE_SIG("Payloads honour the heap's alignment", "[policies]",
+                       ((std::size_t A), A), 8, 16, 32)
+{
+    BasicHeap<FirstFit, NoLock, HeapStats, A> heap(4096);
+
+    std::vector<void *> allocs;
+    for(std::size_t size = 1; size < 100; size += 7) {
+        allocs.push_back(heap.alloc(size));
+        REQUIRE(reinterpret_cast<std::uintptr_t>(allocs.back()) % A == 0);
+    }
+
+    for(auto *address : allocs) {
+        heap.free(address);
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+}
+
+TEMPLATE_TEST_CASE("Locked heaps can be shared between threads", "[policies]",
+                   MutexLock, SpinLock)
+{
+    BasicHeap<FirstFit, TestType, HeapStats, sizeof(void *)> heap(1 << 20);
+
+    std::size_t constexpr thread_count = 4;
+    std::vector<std::thread> threads;
+
+    for(std::size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&heap, t] {
+            std::minstd_rand rng(static_cast<std::uint32_t>(t + 1));
+            std::vector<void *> live;
+
+            for(std::size_t i = 0; i < 5'000; ++i) {
+                if(live.size() < 32 && rng() % 2 == 0) {
+                    live.push_back(heap.alloc(16 + rng() % 256));
+                }
+                else if(!live.empty()) {
+                    heap.free(live.back());
+                    live.pop_back();
+                }
+            }
+
+            for(auto *address : live) {
+                heap.free(address);
+            }
+        });
+    }
+
+    for(auto &thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
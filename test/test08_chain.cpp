@@ -0,0 +1,107 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/HeapChain.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstring>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("try_alloc returns nullptr and leaves a full heap intact") {
+    Heap heap(256);
+
+    void *alloc_a = heap.try_alloc(128);
+    REQUIRE(alloc_a != nullptr);
+    REQUIRE(heap.owns(alloc_a));
+
+    auto const used = heap.current_used();
+    auto const allocs = heap.current_allocs();
+
+    REQUIRE(heap.try_alloc(256) == nullptr);
+    REQUIRE(heap.current_used() == used);
+    REQUIRE(heap.current_allocs() == allocs);
+
+    // What's left can still be handed out
+    void *alloc_b = heap.try_alloc(32);
+    REQUIRE(alloc_b != nullptr);
+
+    heap.free(alloc_a);
+    heap.free(alloc_b);
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    int on_the_stack = 0;
+    REQUIRE_FALSE(heap.owns(&on_the_stack));
+}
+
+TEST_CASE("Heap chain falls back through its heaps in order") {
+    Heap primary(256);
+    Heap secondary(1024);
+
+    HeapChain chain(primary, false);
+    chain.add(secondary);
+    REQUIRE(chain.heap_count() == 2);
+
+    void *alloc_a = chain.alloc(128);
+    void *alloc_b = chain.alloc(128);
+    void *alloc_c = chain.alloc(512);
+
+    REQUIRE(primary.owns(alloc_a));
+    REQUIRE(secondary.owns(alloc_b));
+    REQUIRE(secondary.owns(alloc_c));
+
+    // Without overflow, running everything dry fails softly
+    REQUIRE(chain.try_alloc(1024) == nullptr);
+
+    chain.free(alloc_b);
+    chain.free(alloc_a);
+
+    // The primary is preferred again as soon as it has room
+    void *alloc_d = chain.alloc(64);
+    REQUIRE(primary.owns(alloc_d));
+
+    chain.free(alloc_c);
+    chain.free(alloc_d);
+
+    REQUIRE(primary.current_allocs() == 0);
+    REQUIRE(secondary.current_allocs() == 0);
+}
+
+TEST_CASE("Heap chain overflows to mapped pages") {
+    Heap primary(256);
+    HeapChain chain(primary);
+
+    auto const page = vm::page_size();
+    REQUIRE(page > 0);
+    REQUIRE(vm::page_round(1) == page);
+
+    auto *spike = static_cast<std::uint8_t *>(chain.alloc(3 * page));
+    REQUIRE(spike != nullptr);
+    REQUIRE_FALSE(primary.owns(spike));
+
+    REQUIRE(chain.overflow_allocs() == 1);
+    REQUIRE(chain.overflow_used() == vm::page_round(3 * page + 32));
+
+    // The mapping is ours to use in full
+    std::memset(spike, 0xAB, 3 * page);
+
+    void *small = chain.alloc(64);
+    REQUIRE(primary.owns(small));
+
+    auto *second_spike = chain.alloc(page);
+    REQUIRE(chain.overflow_allocs() == 2);
+
+    chain.free(spike);
+    REQUIRE(chain.overflow_allocs() == 1);
+    REQUIRE(chain.overflow_used() == vm::page_round(page + 32));
+
+    chain.free(small);
+    REQUIRE(primary.current_allocs() == 0);
+
+    // second_spike is left for the chain to clean up on destruction
+    REQUIRE(second_spike != nullptr);
+}
@@ -0,0 +1,101 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/HeapChain.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstring>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Large allocations bypass the free list") {
+    Heap heap(1024);
+    heap.set_large_threshold(512);
+    REQUIRE(heap.large_threshold() == 512);
+
+    // At the threshold the free list still serves the request
+    void *small = heap.alloc(512);
+    REQUIRE(heap.current_used() == 2 * sizeof(BlockHeader) + 512);
+
+    // Above it, even a request the heap could never hold succeeds
+    auto const large_bytes = std::size_t { 4 << 20 };
+    auto *large = static_cast<std::uint8_t *>(heap.alloc(large_bytes));
+    REQUIRE(large != nullptr);
+    REQUIRE(LargeBlockList::is_large(large));
+    REQUIRE_FALSE(LargeBlockList::is_large(small));
+    REQUIRE(heap.owns(large));
+
+    auto const mapped = vm::page_round(large_bytes + sizeof(BlockHeader));
+    REQUIRE(heap.current_allocs() == 2);
+    REQUIRE(heap.current_used() == 2 * sizeof(BlockHeader) + 512 + mapped);
+
+    std::memset(large, 0x5A, large_bytes);
+
+    // The free list never saw it
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    heap.free(large);
+    REQUIRE_FALSE(heap.owns(large));
+    REQUIRE(heap.current_allocs() == 1);
+    REQUIRE(heap.peak_used() == 2 * sizeof(BlockHeader) + 512 + mapped);
+
+    heap.free(small);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Realloc keeps contents and grows large blocks in place") {
+    Heap heap(4096);
+    heap.set_large_threshold(1024);
+
+    auto *address = static_cast<std::uint8_t *>(heap.alloc(100));
+    for(std::size_t i = 0; i < 100; ++i) {
+        address[i] = static_cast<std::uint8_t>(i);
+    }
+
+    // Within the block's rounding there's nothing to do
+    REQUIRE(heap.realloc(address, 104) == address);
+
+    // Growing past the threshold moves it to its own pages
+    auto *grown = static_cast<std::uint8_t *>(heap.realloc(address, 8192));
+    REQUIRE(LargeBlockList::is_large(grown));
+    REQUIRE(heap.current_allocs() == 1);
+
+    bool intact = true;
+    for(std::size_t i = 0; i < 100; ++i) {
+        intact = intact && grown[i] == static_cast<std::uint8_t>(i);
+    }
+    REQUIRE(intact);
+
+    // And then it's remapped as it grows further
+    grown[8191] = 0xEE;
+    auto const large_bytes = std::size_t { 16 << 20 };
+    auto *regrown = static_cast<std::uint8_t *>(
+        heap.realloc(grown, large_bytes)
+    );
+
+    REQUIRE(regrown[99] == 99);
+    REQUIRE(regrown[8191] == 0xEE);
+    REQUIRE(heap.current_allocs() == 1);
+    REQUIRE(heap.current_used()
+            == sizeof(BlockHeader)
+             + vm::page_round(large_bytes + sizeof(BlockHeader)));
+
+    heap.free(regrown);
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Heap chain frees its heaps' large blocks back to them") {
+    Heap primary(1024);
+    primary.set_large_threshold(256);
+
+    HeapChain chain(primary);
+
+    void *large = chain.alloc(4096);
+    REQUIRE(primary.owns(large));
+    REQUIRE(chain.overflow_allocs() == 0);
+
+    chain.free(large);
+    REQUIRE(primary.current_allocs() == 0);
+}
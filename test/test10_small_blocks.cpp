@@ -0,0 +1,80 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/SmallBlockHeap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <vector>
+
+using namespace btx::memory;
+
+TEST_CASE("Small block heap packs slots into aligned runs") {
+    Heap heap(1 << 20);
+    SmallBlockHeap small(heap);
+
+    REQUIRE(small.run_count() == 0);
+
+    auto *first  = static_cast<std::uint8_t *>(small.alloc(24));
+    auto *second = static_cast<std::uint8_t *>(small.alloc(24));
+    auto *third  = static_cast<std::uint8_t *>(small.alloc(20));
+
+    // One chunk of runs came from the heap, and slots of a size class are
+    // handed out in address order without any headers in between
+    REQUIRE(small.run_count() > 0);
+    REQUIRE(heap.current_allocs() == 1);
+    REQUIRE(second == first + 24);
+    REQUIRE(third == second + 24);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(first) % sizeof(void *) == 0);
+    REQUIRE(small.small_allocs() == 3);
+
+    // The lowest free slot is reused first
+    small.free(second, 24);
+    REQUIRE(small.alloc(17) == second);
+
+    // Anything bigger goes straight to the heap
+    void *big = small.alloc(65);
+    REQUIRE(heap.current_allocs() == 2);
+    small.free(big, 65);
+    REQUIRE(heap.current_allocs() == 1);
+
+    small.free(first, 24);
+    small.free(second, 24);
+    small.free(third, 20);
+    REQUIRE(small.small_allocs() == 0);
+}
+
+TEST_CASE("Small block heap survives random churn across size classes") {
+    Heap heap(4 << 20);
+    SmallBlockHeap small(heap);
+
+    auto result = churn(
+        small,
+        [&small](ChurnBlock const &block) {
+            small.free(block.address, block.size);
+        },
+        5678, 64, 50'000
+    );
+    auto &live = result.live;
+
+    REQUIRE(result.intact);
+    REQUIRE(small.small_allocs() == live.size());
+
+    for(auto const &block : live) {
+        small.free(block.address, block.size);
+    }
+
+    REQUIRE(small.small_allocs() == 0);
+    live.clear();
+
+    // Emptied runs are reclaimed rather than carving more from the heap
+    auto const runs = small.run_count();
+    for(std::size_t i = 0; i < 1000; ++i) {
+        live.push_back({
+            static_cast<std::uint8_t *>(small.alloc(8)), 8, 0
+        });
+    }
+    REQUIRE(small.run_count() == runs);
+
+    for(auto const &block : live) {
+        small.free(block.address, block.size);
+    }
+}
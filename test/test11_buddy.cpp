@@ -0,0 +1,87 @@
+#include "brasstacks/memory/BuddyHeap.hpp"
+
+#include "test_helpers.hpp"
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Buddy heap splits and merges power-of-two blocks") {
+    BuddyHeap heap(1024);
+
+    REQUIRE(heap.total_size() == 1024);
+    REQUIRE(BuddyHeap::block_size(1) == 32);
+    REQUIRE(BuddyHeap::block_size(256) == 256);
+    REQUIRE(BuddyHeap::block_size(257) == 512);
+
+    // Power-of-two requests fit exactly, with no header overhead
+    auto *alloc_a = static_cast<std::uint8_t *>(heap.alloc(256));
+    auto *alloc_b = static_cast<std::uint8_t *>(heap.alloc(256));
+    auto *alloc_c = static_cast<std::uint8_t *>(heap.alloc(512));
+
+    REQUIRE(heap.current_used() == 1024);
+    REQUIRE(heap.current_allocs() == 3);
+    REQUIRE(alloc_b == alloc_a + 256);
+    REQUIRE(alloc_c == alloc_a + 512);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(alloc_a) % 32 == 0);
+
+    REQUIRE(heap.try_alloc(32) == nullptr);
+
+    // alloc_a's buddy is still in use, so nothing merges yet
+    heap.free(alloc_a);
+    REQUIRE(heap.try_alloc(512) == nullptr);
+
+    // Now the two halves merge, and the result merges with nothing else
+    heap.free(alloc_b);
+    auto *alloc_d = heap.alloc(512);
+    REQUIRE(alloc_d == alloc_a);
+
+    heap.free(alloc_c);
+    heap.free(alloc_d);
+
+    // Everything's back in one block
+    REQUIRE(heap.current_used() == 0);
+    REQUIRE(heap.peak_used() == 1024);
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+    REQUIRE(heap.alloc(1024) == alloc_a);
+}
+
+TEST_CASE("Buddy heap handles sizes that aren't a power of two") {
+    // 96 bytes starts as a 64 byte block followed by a 32 byte block
+    BuddyHeap heap(100);
+    REQUIRE(heap.total_size() == 96);
+    REQUIRE_THAT(heap.calc_fragmentation(),
+                 WithinAbs(1.0f - 64.0f / 96.0f, epsilon));
+
+    REQUIRE(heap.try_alloc(96) == nullptr);
+
+    // The trailing block is an exact fit, so the leading one stays whole
+    auto *alloc_a = static_cast<std::uint8_t *>(heap.alloc(32));
+    auto *alloc_b = static_cast<std::uint8_t *>(heap.alloc(64));
+
+    REQUIRE(alloc_b == alloc_a - 64);
+    REQUIRE(heap.try_alloc(32) == nullptr);
+
+    // Neither block has a buddy to merge with
+    heap.free(alloc_a);
+    heap.free(alloc_b);
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.try_alloc(96) == nullptr);
+    REQUIRE(heap.alloc(64) == alloc_b);
+}
+
+TEST_CASE("Buddy heap survives random churn") {
+    BuddyHeap heap(32 << 20);
+
+    auto const result = churn(
+        heap, [&heap](ChurnBlock const &block) { heap.free(block.address); },
+        4321, 4096, 20'000
+    );
+    REQUIRE(result.intact);
+
+    for(auto const &block : result.live) {
+        heap.free(block.address);
+    }
+
+    REQUIRE(heap.current_used() == 0);
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+}
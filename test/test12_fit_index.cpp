@@ -0,0 +1,122 @@
+#include "brasstacks/memory/BasicHeap.hpp"
+#include "brasstacks/memory/HeapPolicies.hpp"
+
+#include "test_helpers.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace btx::memory;
+
+TEST_CASE("Vector fit search agrees with the scalar search") {
+    std::string const kernel = detail::fit_scan_kernel();
+    REQUIRE((kernel == "avx2" || kernel == "sse4.1" || kernel == "scalar"));
+
+    std::minstd_rand rng(99);
+    std::uniform_int_distribution<std::uint32_t> size_dist(0, 512);
+
+    // Every length up to a few vectors' worth, so each tail gets covered
+    bool agree = true;
+    for(std::size_t count = 0; count < 40; ++count) {
+        std::vector<std::uint32_t> sizes(count);
+        for(std::size_t trial = 0; trial < 200; ++trial) {
+            for(auto &size : sizes) {
+                size = size_dist(rng);
+            }
+
+            auto const exact = size_dist(rng);
+            auto const split = exact + 32;
+
+            agree = agree
+                && detail::find_fit_index(sizes.data(), count, exact, split)
+                == detail::find_fit_index_scalar(sizes.data(), count,
+                                                 exact, split);
+        }
+    }
+    REQUIRE(agree);
+
+    // Sizes with the top bit set are still larger, not negative
+    std::vector<std::uint32_t> const large { 16, 0x8000'0000u, 48, 0 };
+    REQUIRE(detail::find_fit_index(large.data(), large.size(), 64, 96) == 1);
+    REQUIRE(detail::find_fit_index(large.data(), large.size(), 48, 80) == 1);
+    REQUIRE(detail::find_fit_index(large.data(), 1, 48, 80) == 1);
+}
+
+TEST_CASE("Indexed first-fit picks the same blocks as first-fit") {
+    using Plain   = BasicHeap<FirstFit, NoLock, HeapStats, sizeof(void *)>;
+    using Indexed = BasicHeap<IndexedFirstFit, NoLock, HeapStats,
+                              sizeof(void *)>;
+
+    Plain plain(1 << 20);
+    Indexed indexed(1 << 20);
+
+    std::minstd_rand rng(7);
+    std::uniform_int_distribution<std::size_t> size_dist(1, 1024);
+
+    std::vector<std::ptrdiff_t> plain_offsets;
+    std::vector<std::ptrdiff_t> indexed_offsets;
+    std::vector<void *> plain_live;
+    std::vector<void *> indexed_live;
+
+    auto *plain_base = static_cast<std::uint8_t *>(plain.alloc(8));
+    auto *indexed_base = static_cast<std::uint8_t *>(indexed.alloc(8));
+
+    for(std::size_t i = 0; i < 5000; ++i) {
+        if(plain_live.empty() || rng() % 3 != 0) {
+            auto const size = size_dist(rng);
+            auto *plain_alloc = static_cast<std::uint8_t *>(plain.alloc(size));
+            auto *indexed_alloc =
+                static_cast<std::uint8_t *>(indexed.alloc(size));
+
+            plain_offsets.push_back(plain_alloc - plain_base);
+            indexed_offsets.push_back(indexed_alloc - indexed_base);
+            plain_live.push_back(plain_alloc);
+            indexed_live.push_back(indexed_alloc);
+        }
+        else {
+            auto const index = rng() % plain_live.size();
+
+            plain.free(plain_live[index]);
+            indexed.free(indexed_live[index]);
+
+            plain_live[index] = plain_live.back();
+            plain_live.pop_back();
+            indexed_live[index] = indexed_live.back();
+            indexed_live.pop_back();
+        }
+    }
+
+    REQUIRE(plain_offsets == indexed_offsets);
+    REQUIRE(plain.calc_fragmentation() == indexed.calc_fragmentation());
+}
+
+TEST_CASE("Indexed first-fit's index holds every free block a heap can have") {
+    using Indexed = BasicHeap<IndexedFirstFit, NoLock, HeapStats,
+                              sizeof(void *)>;
+
+    // Fill the heap with the smallest blocks there are, then free every other
+    // one, which leaves as many separate holes as it can hold
+    Indexed heap(64 * 1024);
+
+    std::vector<void *> blocks;
+    while(void *block = heap.try_alloc(1)) {
+        blocks.push_back(block);
+    }
+
+    for(std::size_t i = 0; i < blocks.size(); i += 2) {
+        heap.free(blocks[i]);
+    }
+
+    // Every hole is still found, lowest first
+    for(std::size_t i = 0; i < blocks.size(); i += 2) {
+        REQUIRE(heap.alloc(1) == blocks[i]);
+    }
+
+    for(void *block : blocks) {
+        heap.free(block);
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
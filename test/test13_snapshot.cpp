@@ -0,0 +1,254 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+namespace {
+
+// Rewrite part of a saved snapshot in place, as a corrupt file might be
+template<typename Edit>
+void patch_snapshot(std::string const &path, Edit &&edit) {
+    std::FILE *file = std::fopen(path.c_str(), "r+b");
+    REQUIRE(file != nullptr);
+
+    std::vector<std::byte> bytes(std::filesystem::file_size(path));
+    REQUIRE(std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+
+    SnapshotHeader header { };
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    edit(header, bytes.data() + sizeof(header));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+
+    std::rewind(file);
+    REQUIRE(std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+    REQUIRE(std::fclose(file) == 0);
+}
+
+} // namespace
+
+TEST_CASE("Heap snapshots restore blocks, free list and stats") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_heap_snapshot.bin")
+        .string();
+
+    std::ptrdiff_t kept_offset = 0;
+    std::size_t used = 0;
+    std::size_t peak = 0;
+    float fragmentation = 0.0f;
+
+    {
+        Heap heap(4096);
+
+        auto *base = static_cast<std::uint8_t *>(heap.alloc(8));
+        auto *kept = static_cast<char *>(heap.alloc(64));
+        void *freed = heap.alloc(256);
+        void *also_kept = heap.alloc(128);
+        REQUIRE(also_kept != nullptr);
+
+        std::strcpy(kept, "still here");
+        heap.free(freed);
+        heap.free(base);
+
+        kept_offset = reinterpret_cast<std::uint8_t *>(kept) - base;
+        used = heap.current_used();
+        peak = heap.peak_used();
+        fragmentation = heap.calc_fragmentation();
+
+        REQUIRE(heap.save(path.c_str()));
+    }
+
+    {
+        Heap heap(FromSnapshot { path.c_str() });
+
+        REQUIRE(heap.total_size() == 4096);
+        REQUIRE(heap.current_allocs() == 2);
+        REQUIRE(heap.current_used() == used);
+        REQUIRE(heap.peak_used() == peak);
+        REQUIRE_THAT(heap.calc_fragmentation(),
+                     WithinAbs(fragmentation, epsilon));
+
+        // The first free block is where the base allocation was, and the
+        // free list leads on to the 256 byte hole
+        auto *base = static_cast<std::uint8_t *>(heap.alloc(8));
+        auto *kept = reinterpret_cast<char *>(base + kept_offset);
+        REQUIRE(std::strcmp(kept, "still here") == 0);
+
+        void *hole = heap.alloc(256);
+        REQUIRE(static_cast<std::uint8_t *>(hole) > base + kept_offset);
+
+        heap.free(kept);
+        heap.free(hole);
+        heap.free(base);
+
+        // Copy-on-write, so none of that reaches the file
+        Heap again(FromSnapshot { path.c_str() });
+        REQUIRE(again.current_allocs() == 2);
+        REQUIRE(again.current_used() == used);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Heaps with large blocks in use can't be saved") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_heap_large.bin")
+        .string();
+
+    Heap heap(1024);
+    heap.set_large_threshold(256);
+
+    void *large = heap.alloc(4096);
+    REQUIRE_FALSE(heap.save(path.c_str()));
+
+    heap.free(large);
+    REQUIRE(heap.save(path.c_str()));
+
+    std::filesystem::remove(path);
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Snapshots saved with the other link mode are refused") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_heap_links.bin")
+        .string();
+
+    {
+        Heap heap(4096);
+        (void)heap.alloc(64);
+        REQUIRE(heap.save(path.c_str()));
+    }
+
+    // Restoring the untouched file is fine
+    REQUIRE_FALSE(aborts([&path] {
+        Heap heap(FromSnapshot { path.c_str() });
+    }));
+
+    // Pointers read as offsets, or offsets as pointers, would send the free
+    // list walk anywhere
+    patch_snapshot(path, [](SnapshotHeader &header, std::byte *) {
+        header.link_mode = header.link_mode == SnapshotHeader::pointer_links
+                         ? SnapshotHeader::relative_links
+                         : SnapshotHeader::pointer_links;
+    });
+
+    REQUIRE(aborts([&path] {
+        Heap heap(FromSnapshot { path.c_str() });
+    }));
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Corrupt snapshots are refused before they're walked") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_heap_corrupt.bin")
+        .string();
+
+    auto const save = [&path] {
+        Heap heap(4096);
+        void *freed = heap.alloc(64);
+        (void)heap.alloc(64);
+        heap.free(freed);
+        REQUIRE(heap.save(path.c_str()));
+    };
+
+    auto const restores = [&path] {
+        return !aborts([&path] { Heap heap(FromSnapshot { path.c_str() }); });
+    };
+
+    save();
+    REQUIRE(restores());
+
+    // Offsets past the end of the image
+    patch_snapshot(path, [](SnapshotHeader &header, std::byte *) {
+        header.free_head = header.total_size;
+    });
+    REQUIRE_FALSE(restores());
+
+    save();
+    patch_snapshot(path, [](SnapshotHeader &header, std::byte *) {
+        header.top_end = header.total_size + 4096;
+    });
+    REQUIRE_FALSE(restores());
+
+    // A free block's header scribbled over, links and size alike
+    save();
+    patch_snapshot(path, [](SnapshotHeader &header, std::byte *image) {
+        std::memset(image + header.free_head, 0x5a, sizeof(BlockHeader));
+    });
+    REQUIRE_FALSE(restores());
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Heaps built at a fixed address restore there, pointers and all") {
+    auto const path =
+        (std::filesystem::temp_directory_path() / "btx_heap_fixed.bin")
+        .string();
+
+    struct Node {
+        Node *next;
+        int value;
+    };
+
+    // Find a range nothing else is using
+    std::size_t const span = 1 << 20;
+    void *spot = vm::reserve(span);
+    REQUIRE(spot != nullptr);
+    vm::unmap(spot, span);
+
+    Node *first = nullptr;
+
+    {
+        Heap heap(64 * 1024, AtAddress { spot });
+        REQUIRE(heap.owns(static_cast<std::uint8_t *>(spot)
+                          + sizeof(SnapshotHeader)));
+
+        first = new(heap.alloc(sizeof(Node))) Node { nullptr, 1 };
+        first->next = new(heap.alloc(sizeof(Node))) Node { nullptr, 2 };
+
+        // The range is taken now
+        REQUIRE(aborts([spot] { Heap other(4096, AtAddress { spot }); }));
+
+        REQUIRE(heap.save(path.c_str()));
+    }
+
+    {
+        Heap heap(FromSnapshot { path.c_str(), true });
+        REQUIRE_FALSE(heap.relocated());
+
+        // The program's own pointers are still good
+        REQUIRE(first->value == 1);
+        REQUIRE(first->next->value == 2);
+        REQUIRE(heap.owns(first->next));
+
+        heap.free(first->next);
+        heap.free(first);
+        REQUIRE(heap.current_allocs() == 0);
+    }
+
+    // With the address taken, a snapshot that insists on it is refused, and
+    // one that doesn't relocates
+    void *squatter = vm::reserve_at(spot, span);
+    REQUIRE(squatter == spot);
+
+    REQUIRE(aborts([&path] { Heap heap(FromSnapshot { path.c_str(), true }); }));
+
+    {
+        Heap heap(FromSnapshot { path.c_str() });
+        REQUIRE(heap.relocated());
+    }
+
+    vm::unmap(squatter, span);
+    std::filesystem::remove(path);
+}
+#endif
@@ -0,0 +1,74 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/RelativeLink.hpp"
+
+#include "test_helpers.hpp"
+
+#include <array>
+#include <cstring>
+
+using namespace btx::memory;
+
+namespace {
+
+struct Node final {
+    RelativeLink<Node> next;
+    int value = 0;
+};
+
+} // namespace
+
+TEST_CASE("Relative links survive being copied elsewhere wholesale") {
+    std::array<Node, 4> nodes { };
+    for(std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].value = static_cast<int>(i);
+    }
+
+    REQUIRE(nodes[0].next == nullptr);
+    REQUIRE(nodes[0].next.offset() == 0);
+
+    nodes[0].next = &nodes[2];
+    nodes[2].next = &nodes[1];
+    nodes[1].next = &nodes[3];
+
+    REQUIRE(nodes[0].next->value == 2);
+    REQUIRE(nodes[0].next.offset()
+            == static_cast<std::intptr_t>(2 * sizeof(Node)));
+
+    // Copying the bytes, as mapping storage somewhere else would, keeps the
+    // whole chain inside the copy
+    std::array<Node, 4> moved;
+    std::memcpy(static_cast<void *>(moved.data()), nodes.data(),
+                sizeof(nodes));
+
+    int sum = 0;
+    std::size_t length = 0;
+    for(Node *node = &moved[0]; node != nullptr; node = node->next) {
+        REQUIRE(node >= moved.data());
+        REQUIRE(node < moved.data() + moved.size());
+        sum += node->value;
+        ++length;
+    }
+
+    REQUIRE(length == 4);
+    REQUIRE(sum == 6);
+
+    // Copying a link through the type recomputes it from its new home
+    moved[3].next = moved[0].next;
+    REQUIRE(moved[3].next.get() == &moved[2]);
+}
+
+#ifdef BTX_MEMORY_RELATIVE_LINKS
+TEST_CASE("Block headers link relatively") {
+    alignas(BlockHeader) std::array<std::byte, 2 * sizeof(BlockHeader)> raw;
+
+    auto *first = reinterpret_cast<BlockHeader *>(raw.data());
+    auto *second = first + 1;
+
+    first->next = second;
+    second->prev = first;
+
+    // The distance is measured from the link, not the header holding it
+    REQUIRE(first->next.get() == second);
+    REQUIRE(second->prev.get() == first);
+}
+#endif
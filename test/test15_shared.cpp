@@ -0,0 +1,110 @@
+#include "brasstacks/memory/SharedHeap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstring>
+#include <string>
+
+#if !defined(_WIN32)
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+namespace {
+
+std::string segment_name(char const *suffix) {
+#if defined(_WIN32)
+    return std::string("btx_test_") + suffix;
+#else
+    return "/btx_test_" + std::to_string(::getpid()) + "_" + suffix;
+#endif
+}
+
+} // namespace
+
+TEST_CASE("Shared heap is visible through every mapping") {
+    auto const name = segment_name("mappings");
+
+    SharedHeap creator(name.c_str(), 64 * 1024);
+    SharedHeap opener(name.c_str());
+
+    // Two mappings of the same segment, at two different addresses
+    REQUIRE(opener.total_size() == creator.total_size());
+
+    auto *message = static_cast<char *>(creator.alloc(100));
+    std::strcpy(message, "hello from the creator");
+
+    auto const offset = creator.offset_of(message);
+    auto *received = static_cast<char *>(opener.address_of(offset));
+
+    REQUIRE(static_cast<void *>(received) != static_cast<void *>(message));
+    REQUIRE(std::strcmp(received, "hello from the creator") == 0);
+    REQUIRE(opener.current_allocs() == 1);
+
+    // Either side can allocate and free, and the free list stays coherent
+    void *reply = opener.alloc(200);
+    REQUIRE(creator.owns(creator.address_of(opener.offset_of(reply))));
+    REQUIRE(creator.current_allocs() == 2);
+
+    opener.free(received);
+    creator.free(creator.address_of(opener.offset_of(reply)));
+
+    REQUIRE(creator.current_allocs() == 0);
+    REQUIRE(creator.current_used() == 32);
+    REQUIRE_THAT(opener.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    // Running dry fails softly
+    REQUIRE(creator.try_alloc(creator.total_size()) == nullptr);
+
+    SharedHeap::remove(name.c_str());
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Shared heap passes messages between processes") {
+    auto const name = segment_name("fork");
+
+    SharedHeap heap(name.c_str(), 1 << 20);
+
+    int offsets[2] { };
+    REQUIRE(::pipe(offsets) == 0);
+
+    pid_t const child = ::fork();
+    REQUIRE(child >= 0);
+
+    if(child == 0) {
+        // Open the segment afresh, allocate a message in place and send back
+        // nothing but its offset
+        SharedHeap other(name.c_str());
+
+        auto *message = static_cast<char *>(other.alloc(4096));
+        std::strcpy(message, "zero-copy");
+
+        auto const offset = other.offset_of(message);
+        auto const written = ::write(offsets[1], &offset, sizeof(offset));
+
+        ::_exit(written == sizeof(offset) ? 0 : 1);
+    }
+
+    std::uint64_t offset = 0;
+    REQUIRE(::read(offsets[0], &offset, sizeof(offset)) == sizeof(offset));
+
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+
+    auto *message = static_cast<char *>(heap.address_of(offset));
+    REQUIRE(std::strcmp(message, "zero-copy") == 0);
+    REQUIRE(heap.current_allocs() == 1);
+
+    heap.free(message);
+    REQUIRE(heap.current_allocs() == 0);
+
+    ::close(offsets[0]);
+    ::close(offsets[1]);
+    SharedHeap::remove(name.c_str());
+}
+#endif
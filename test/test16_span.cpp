@@ -0,0 +1,84 @@
+#include "brasstacks/memory/BasicHeap.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <array>
+#include <span>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+namespace {
+
+alignas(64) std::array<std::byte, 4096> static_storage;
+
+} // namespace
+
+TEST_CASE("Heap over a static array") {
+    {
+        Heap heap { std::span<std::byte>(static_storage) };
+
+        REQUIRE(heap.total_size() == 4096);
+        REQUIRE(heap.current_used() == sizeof(BlockHeader));
+
+        auto *address = static_cast<std::byte *>(heap.alloc(64));
+        REQUIRE(address == static_storage.data() + sizeof(BlockHeader));
+        REQUIRE(heap.owns(address));
+
+        heap.free(address);
+        REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+    }
+
+    // The heap left the memory where it was, and another can take it over
+    Heap heap { std::span<std::byte>(static_storage) };
+    REQUIRE(heap.current_allocs() == 0);
+}
+
+TEST_CASE("Heap over misaligned memory trims both ends") {
+    alignas(64) std::array<std::byte, 1024> stack_storage { };
+
+    // Start a byte in and run a few bytes short
+    std::span<std::byte> const memory(stack_storage.data() + 1, 1000);
+
+    using AlignedHeap = BasicHeap<FirstFit, NoLock, HeapStats, 32>;
+    AlignedHeap heap(memory);
+
+    // 31 bytes to reach alignment, then whole headers' worth of what's left
+    REQUIRE(heap.total_size() == ((1000 - 31) / 32) * 32);
+
+    auto *address = heap.alloc(1);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(address) % 32 == 0);
+    REQUIRE(heap.owns(address));
+    heap.free(address);
+}
+
+TEST_CASE("Heaps nest inside one another") {
+    Heap outer(64 * 1024);
+
+    auto *block = static_cast<std::byte *>(outer.alloc(16 * 1024));
+    {
+        Heap inner(std::span<std::byte>(block, 16 * 1024));
+
+        void *address = inner.alloc(1024);
+        REQUIRE(inner.owns(address));
+        REQUIRE(outer.owns(address));
+        REQUIRE(outer.owns(inner.alloc(16)));
+
+        REQUIRE(outer.current_allocs() == 1);
+        REQUIRE(inner.current_allocs() == 2);
+    }
+    outer.free(block);
+
+    REQUIRE(outer.current_allocs() == 0);
+}
+
+TEST_CASE("Heap over too little memory fails softly") {
+    std::array<std::byte, 48> tiny { };
+
+    Heap heap { std::span<std::byte>(tiny) };
+
+    REQUIRE(heap.total_size() == 0);
+    REQUIRE(heap.try_alloc(8) == nullptr);
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+}
@@ -0,0 +1,135 @@
+#include "brasstacks/memory/Numa.hpp"
+#include "brasstacks/memory/NumaHeap.hpp"
+#include "brasstacks/memory/VirtualMemory.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace btx::memory;
+
+TEST_CASE("NUMA topology is always usable") {
+    REQUIRE(numa::node_count() >= 1);
+    REQUIRE(numa::current_node() < numa::node_count());
+
+    auto const bytes = vm::page_size() * 4;
+    auto *memory = static_cast<std::byte *>(numa::map(bytes, 0));
+    REQUIRE(memory != nullptr);
+
+    // Mapped zeroed and writable
+    REQUIRE(memory[0] == std::byte { 0 });
+    REQUIRE(memory[bytes - 1] == std::byte { 0 });
+    std::memset(memory, 0xab, bytes);
+
+    vm::unmap(memory, bytes);
+}
+
+TEST_CASE("NUMA heap serves allocations from the caller's node") {
+    NumaHeap heap(64 * 1024);
+
+    REQUIRE(heap.node_count() == numa::node_count());
+    REQUIRE(heap.bytes_per_node() == vm::page_round(64 * 1024));
+
+    // Nothing exists until something's allocated
+    for(std::size_t node = 0; node < heap.node_count(); ++node) {
+        REQUIRE(heap.arena(node) == nullptr);
+    }
+
+    void *address = heap.alloc(128);
+    REQUIRE(heap.owns(address));
+
+    // Threads can migrate, so look for the allocation rather than assuming
+    std::size_t node_with_alloc = heap.node_count();
+    for(std::size_t node = 0; node < heap.node_count(); ++node) {
+        auto const *arena = heap.arena(node);
+        if(arena != nullptr && arena->owns(address)) {
+            node_with_alloc = node;
+        }
+    }
+
+    REQUIRE(node_with_alloc < heap.node_count());
+    REQUIRE(heap.local_allocs(node_with_alloc) == 1);
+    REQUIRE(heap.spilled_allocs(node_with_alloc) == 0);
+
+    auto const *arena = heap.arena(node_with_alloc);
+    REQUIRE(arena->current_allocs() == 1);
+
+    heap.free(address);
+    REQUIRE(arena->current_allocs() == 0);
+    REQUIRE(arena->current_used() == sizeof(BlockHeader));
+
+    int on_the_stack = 0;
+    REQUIRE_FALSE(heap.owns(&on_the_stack));
+}
+
+TEST_CASE("NUMA heap fails cleanly once every node is full") {
+    NumaHeap heap(vm::page_size());
+
+    std::vector<void *> live;
+    for(void *address = heap.try_alloc(64); address != nullptr;
+        address = heap.try_alloc(64))
+    {
+        live.push_back(address);
+    }
+
+    REQUIRE_FALSE(live.empty());
+
+    std::size_t allocs = 0;
+    for(std::size_t node = 0; node < heap.node_count(); ++node) {
+        allocs += heap.local_allocs(node) + heap.spilled_allocs(node);
+    }
+    REQUIRE(allocs == live.size());
+
+    for(void *address : live) {
+        heap.free(address);
+    }
+
+    REQUIRE(heap.try_alloc(64) != nullptr);
+}
+
+TEST_CASE("NUMA heap is shared safely between threads") {
+    NumaHeap heap(1024 * 1024);
+
+    std::size_t constexpr thread_count = 4;
+    std::size_t constexpr rounds = 2'000;
+
+    std::vector<std::thread> threads;
+    for(std::size_t thread = 0; thread < thread_count; ++thread) {
+        threads.emplace_back([&heap, thread] {
+            std::vector<void *> live;
+            for(std::size_t round = 0; round < rounds; ++round) {
+                auto const bytes = 16 + (round * 7 + thread * 13) % 240;
+                auto *address = static_cast<std::byte *>(heap.alloc(bytes));
+                std::memset(address, static_cast<int>(thread), bytes);
+                live.push_back(address);
+
+                if(live.size() > 32) {
+                    heap.free(live.front());
+                    live.erase(live.begin());
+                }
+            }
+
+            for(void *address : live) {
+                heap.free(address);
+            }
+        });
+    }
+
+    for(auto &thread : threads) {
+        thread.join();
+    }
+
+    std::size_t allocs = 0;
+    for(std::size_t node = 0; node < heap.node_count(); ++node) {
+        allocs += heap.local_allocs(node) + heap.spilled_allocs(node);
+
+        auto const *arena = heap.arena(node);
+        if(arena != nullptr) {
+            REQUIRE(arena->current_allocs() == 0);
+        }
+    }
+
+    REQUIRE(allocs == thread_count * rounds);
+}
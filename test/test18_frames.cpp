@@ -0,0 +1,167 @@
+#include "brasstacks/memory/FramePool.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <coroutine>
+#include <cstdint>
+#include <vector>
+
+using namespace btx::memory;
+
+namespace {
+
+// Runs to its first suspension point and stays there until destroyed
+struct Job final {
+    struct promise_type : PooledFrame {
+        Job get_return_object() {
+            return Job { std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        std::suspend_always initial_suspend() noexcept { return { }; }
+        std::suspend_always final_suspend() noexcept { return { }; }
+
+        void return_void() { }
+        void unhandled_exception() { }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Job(std::coroutine_handle<promise_type> h) : handle { h } { }
+    Job(Job &&other) noexcept : handle { other.handle } { other.handle = { }; }
+    Job(Job const &) = delete;
+
+    ~Job() {
+        if(handle) {
+            handle.destroy();
+        }
+    }
+
+    [[nodiscard]] void * frame() const { return handle.address(); }
+};
+
+Job pooled_job(std::allocator_arg_t, FramePool &, int value) {
+    volatile int local = value;
+    co_await std::suspend_always { };
+    local = local + 1;
+}
+
+Job default_job(int value) {
+    volatile int local = value;
+    co_await std::suspend_always { };
+    local = local + 1;
+}
+
+} // namespace
+
+TEST_CASE("Frame pool hands out aligned blocks and reuses them") {
+    Heap heap(64 * 1024);
+    FramePool pool(heap);
+
+    void *frame_a = pool.alloc(40);
+    void *frame_b = pool.alloc(40);
+
+    REQUIRE(reinterpret_cast<std::uintptr_t>(frame_a)
+            % FramePool::granularity == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(frame_b)
+            % FramePool::granularity == 0);
+
+    // Frames of one size are packed side by side
+    REQUIRE(static_cast<std::byte *>(frame_b)
+            - static_cast<std::byte *>(frame_a) == 48);
+
+    REQUIRE(pool.live_frames() == 2);
+    REQUIRE(pool.chunk_count() == 1);
+
+    // The last frame freed is the next one handed out
+    pool.free(frame_a, 40);
+    REQUIRE(pool.alloc(33) == frame_a);
+
+    // A different size gets its own chunk
+    void *frame_c = pool.alloc(200);
+    REQUIRE(pool.chunk_count() == 2);
+
+    // Anything too big goes straight to the heap
+    auto const allocs = heap.current_allocs();
+    void *frame_d = pool.alloc(FramePool::max_pooled + 1);
+    REQUIRE(heap.current_allocs() == allocs + 1);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(frame_d)
+            % FramePool::granularity == 0);
+
+    pool.free(frame_d, FramePool::max_pooled + 1);
+    REQUIRE(heap.current_allocs() == allocs);
+
+    pool.free(frame_a, 40);
+    pool.free(frame_b, 40);
+    pool.free(frame_c, 200);
+    REQUIRE(pool.live_frames() == 0);
+}
+
+TEST_CASE("Frame pool returns its chunks to the heap") {
+    Heap heap(64 * 1024);
+
+    {
+        FramePool pool(heap);
+
+        std::vector<void *> frames;
+        for(std::size_t i = 0; i < 200; ++i) {
+            frames.push_back(pool.alloc(96));
+        }
+        REQUIRE(pool.chunk_count() > 1);
+
+        for(void *frame : frames) {
+            pool.free(frame, 96);
+        }
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+}
+
+TEST_CASE("Coroutine frames come from the pool they're handed") {
+    Heap heap(64 * 1024);
+    FramePool pool(heap);
+
+    void *first_frame = nullptr;
+    {
+        auto job = pooled_job(std::allocator_arg, pool, 1);
+        REQUIRE(pool.live_frames() == 1);
+        REQUIRE(heap.owns(job.frame()));
+
+        job.handle.resume();
+        first_frame = job.frame();
+    }
+
+    REQUIRE(pool.live_frames() == 0);
+
+    // The next frame of the same type lands where the last one was
+    auto job_a = pooled_job(std::allocator_arg, pool, 2);
+    REQUIRE(job_a.frame() == first_frame);
+
+    auto job_b = pooled_job(std::allocator_arg, pool, 3);
+    REQUIRE(pool.live_frames() == 2);
+    REQUIRE(pool.chunk_count() == 1);
+}
+
+TEST_CASE("Coroutine frames fall back to the thread's default pool") {
+    Heap heap(64 * 1024);
+    FramePool pool(heap);
+
+    REQUIRE(FramePool::thread_default() == nullptr);
+
+    {
+        FramePool::ScopedDefault const use_pool(pool);
+        REQUIRE(FramePool::thread_default() == &pool);
+
+        auto job = default_job(1);
+        REQUIRE(pool.live_frames() == 1);
+        REQUIRE(heap.owns(job.frame()));
+    }
+
+    REQUIRE(FramePool::thread_default() == nullptr);
+    REQUIRE(pool.live_frames() == 0);
+
+    // With no pool at all, frames come from global new
+    auto job = default_job(2);
+    REQUIRE_FALSE(heap.owns(job.frame()));
+    REQUIRE(pool.live_frames() == 0);
+}
@@ -0,0 +1,126 @@
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/ObjectPool.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace btx::memory;
+
+namespace {
+
+struct alignas(32) Particle final {
+    float position[3];
+    float velocity[3];
+    std::uint32_t id;
+};
+
+} // namespace
+
+TEST_CASE("Object pool creates, finds and destroys objects") {
+    Heap heap(64 * 1024);
+    ObjectPool<std::string> pool(heap);
+
+    REQUIRE(pool.size() == 0);
+    REQUIRE(pool.capacity() == 0);
+    REQUIRE(pool.get(ObjectPool<std::string>::handle { }) == nullptr);
+
+    auto const first = pool.create("first");
+    auto const second = pool.create(5, 'x');
+
+    REQUIRE(first);
+    REQUIRE(pool.size() == 2);
+    REQUIRE(pool.chunk_count() == 1);
+    REQUIRE(*pool.get(first) == "first");
+    REQUIRE(*pool.get(second) == "xxxxx");
+
+    REQUIRE(pool.destroy(first));
+    REQUIRE(pool.size() == 1);
+
+    // The handle is now stale, even once its slot is reused
+    REQUIRE_FALSE(pool.contains(first));
+    REQUIRE(pool.get(first) == nullptr);
+    REQUIRE_FALSE(pool.destroy(first));
+
+    auto const third = pool.create("third");
+    REQUIRE(third.index == first.index);
+    REQUIRE(third.generation != first.generation);
+    REQUIRE(pool.get(first) == nullptr);
+    REQUIRE(*pool.get(third) == "third");
+
+    // Handles survive the objects moving underneath them
+    REQUIRE(*pool.get(second) == "xxxxx");
+}
+
+TEST_CASE("Object pool keeps live objects packed") {
+    Heap heap(256 * 1024);
+    BasicObjectPool<Particle, Heap, 16> pool(heap);
+
+    std::vector<ObjectPool<Particle>::handle> handles;
+    for(std::uint32_t id = 0; id < 100; ++id) {
+        handles.push_back(pool.create(Particle { { }, { }, id }));
+    }
+
+    REQUIRE(pool.size() == 100);
+    REQUIRE(pool.chunk_count() == 7);
+
+    // Drop every third object
+    for(std::size_t i = 0; i < handles.size(); i += 3) {
+        REQUIRE(pool.destroy(handles[i]));
+    }
+
+    REQUIRE(pool.size() == 66);
+
+    std::size_t visited = 0;
+    std::uint64_t id_sum = 0;
+    pool.for_each([&](Particle &particle) {
+        REQUIRE(reinterpret_cast<std::uintptr_t>(&particle) % 32 == 0);
+        REQUIRE(particle.id % 3 != 0);
+        ++visited;
+        id_sum += particle.id;
+    });
+
+    REQUIRE(visited == 66);
+
+    std::uint64_t expected_sum = 0;
+    for(std::uint32_t id = 0; id < 100; ++id) {
+        if(id % 3 != 0) {
+            expected_sum += id;
+        }
+    }
+    REQUIRE(id_sum == expected_sum);
+
+    // Every surviving handle still finds its own object
+    for(std::size_t i = 0; i < handles.size(); ++i) {
+        auto *particle = pool.get(handles[i]);
+        if(i % 3 == 0) {
+            REQUIRE(particle == nullptr);
+        }
+        else {
+            REQUIRE(particle != nullptr);
+            REQUIRE(particle->id == i);
+        }
+    }
+
+    // Freed slots are reused before the pool grows again
+    for(std::uint32_t id = 100; id < 134; ++id) {
+        static_cast<void>(pool.create(Particle { { }, { }, id }));
+    }
+    REQUIRE(pool.chunk_count() == 7);
+}
+
+TEST_CASE("Object pool returns its chunks to the heap") {
+    Heap heap(64 * 1024);
+
+    {
+        ObjectPool<std::string> pool(heap);
+        for(std::size_t i = 0; i < 200; ++i) {
+            static_cast<void>(pool.create(64, 'a'));
+        }
+        REQUIRE(heap.current_allocs() == pool.chunk_count());
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+}
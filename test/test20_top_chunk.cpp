@@ -0,0 +1,95 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("A fresh heap bumps allocations off its top chunk") {
+    Heap heap(4096);
+
+    // Each block lands directly after the last
+    auto *previous = static_cast<std::uint8_t *>(heap.alloc(64));
+    for(std::size_t i = 0; i < 16; ++i) {
+        auto *address = static_cast<std::uint8_t *>(heap.alloc(64));
+        REQUIRE(address == previous + 64 + sizeof(BlockHeader));
+        previous = address;
+    }
+
+    REQUIRE(heap.current_allocs() == 17);
+    REQUIRE(heap.current_used() == 17 * (64 + sizeof(BlockHeader))
+                                   + sizeof(BlockHeader));
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+}
+
+TEST_CASE("Blocks freed next to the top chunk merge back into it") {
+    Heap heap(4096);
+
+    std::vector<void *> blocks;
+    for(std::size_t i = 0; i < 8; ++i) {
+        blocks.push_back(heap.alloc(96));
+    }
+
+    // Freeing from the end hands each block straight back, so the space is
+    // bumped out again in the same place
+    heap.free(blocks.back());
+    REQUIRE(heap.alloc(96) == blocks.back());
+
+    // Free a run in the middle, then the blocks after it. Once the last one
+    // goes back to the top chunk, the whole run follows it.
+    heap.free(blocks[4]);
+    heap.free(blocks[5]);
+    REQUIRE(heap.calc_fragmentation() > 0.0f);
+
+    heap.free(blocks[7]);
+    heap.free(blocks[6]);
+
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+    REQUIRE(heap.current_used() == 4 * (96 + sizeof(BlockHeader))
+                                   + sizeof(BlockHeader));
+    REQUIRE(heap.alloc(96) == blocks[4]);
+}
+
+TEST_CASE("Freed blocks are reused before the top chunk") {
+    Heap heap(4096);
+
+    void *hole = heap.alloc(128);
+    void *fence = heap.alloc(32);
+    heap.free(hole);
+
+    REQUIRE(heap.alloc(64) == hole);
+
+    // Too big for what's left of the hole, so it comes off the top
+    auto *from_top = static_cast<std::uint8_t *>(heap.alloc(256));
+    REQUIRE(from_top == static_cast<std::uint8_t *>(fence) + 32
+                        + sizeof(BlockHeader));
+}
+
+TEST_CASE("A heap can be filled from its top chunk and emptied again") {
+    std::size_t const heap_size = 1024;
+    Heap heap(heap_size);
+
+    std::vector<void *> blocks;
+    while(void *address = heap.try_alloc(32)) {
+        blocks.push_back(address);
+    }
+
+    REQUIRE(blocks.size() == heap_size / (32 + sizeof(BlockHeader)));
+    REQUIRE(heap.current_used() == heap_size);
+
+    for(void *address : blocks) {
+        heap.free(address);
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    // It's all one top chunk again
+    void *everything = heap.alloc(heap_size - sizeof(BlockHeader));
+    REQUIRE(everything == blocks.front());
+}
@@ -0,0 +1,99 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+namespace {
+
+std::size_t constexpr huge_heap = std::size_t { 4 } << 30;
+
+} // namespace
+
+TEST_CASE("Lazily committed heaps only reserve their space") {
+    Heap heap(huge_heap, lazy_commit);
+
+    REQUIRE(heap.total_size() == huge_heap);
+    REQUIRE(heap.committed_bytes() < huge_heap / 1024);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    // Growing past what's committed commits more, and all of it can be used
+    std::size_t const big = 64u << 20;
+    auto *block = static_cast<std::uint8_t *>(heap.alloc(big));
+    REQUIRE(heap.committed_bytes() >= big + 2 * sizeof(BlockHeader));
+    REQUIRE(heap.committed_bytes() < big * 2);
+
+    std::memset(block, 0xab, big);
+
+    std::vector<void *> small;
+    for(std::size_t i = 0; i < 1000; ++i) {
+        small.push_back(heap.alloc(256));
+        std::memset(small.back(), 0xcd, 256);
+    }
+
+    // Freed space is reused without committing anything new
+    auto const committed = heap.committed_bytes();
+    heap.free(block);
+    void *reused = heap.alloc(big / 2);
+    REQUIRE(reused == block);
+    REQUIRE(heap.committed_bytes() == committed);
+
+    heap.free(reused);
+    for(void *address : small) {
+        heap.free(address);
+    }
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Lazily committed heaps fill up like any other") {
+    std::size_t const heap_size = 3 << 20;
+    Heap heap(heap_size, lazy_commit);
+
+    std::vector<void *> blocks;
+    while(void *address = heap.try_alloc(4000)) {
+        std::memset(address, 0x5a, 4000);
+        blocks.push_back(address);
+    }
+
+    REQUIRE(heap.committed_bytes() == heap_size);
+    REQUIRE(blocks.size() == heap_size / (4000 + sizeof(BlockHeader)));
+
+    for(void *address : blocks) {
+        heap.free(address);
+    }
+
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Lazily committed heaps can be snapshotted") {
+    char const *path = "/tmp/btx_heap_lazy.bin";
+
+    {
+        Heap heap(16 << 20, lazy_commit);
+        auto *block = static_cast<char *>(heap.alloc(64));
+        std::strcpy(block, "lazy");
+
+        REQUIRE(heap.committed_bytes() < heap.total_size());
+        REQUIRE(heap.save(path));
+    }
+
+    Heap restored(FromSnapshot { path });
+    REQUIRE(restored.total_size() == 16 << 20);
+    REQUIRE(restored.committed_bytes() == restored.total_size());
+    REQUIRE(restored.current_allocs() == 1);
+
+    // The whole uncommitted tail is still free to hand out
+    void *rest = restored.alloc((8 << 20));
+    REQUIRE(rest != nullptr);
+
+    std::remove(path);
+}
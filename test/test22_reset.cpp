@@ -0,0 +1,134 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/LargeBlockList.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Resetting a heap frees everything at once") {
+    Heap heap(64 * 1024);
+    heap.set_large_threshold(4096);
+
+    void *first = heap.alloc(100);
+
+    std::vector<void *> blocks;
+    for(std::size_t i = 0; i < 200; ++i) {
+        blocks.push_back(heap.alloc(64 + i));
+    }
+
+    // Leave some holes behind, so there's a free list to throw away too
+    for(std::size_t i = 0; i < blocks.size(); i += 3) {
+        heap.free(blocks[i]);
+    }
+
+    auto *large = heap.alloc(1 << 20);
+    REQUIRE(LargeBlockList::is_large(large));
+
+    auto const peak_used = heap.peak_used();
+    auto const peak_allocs = heap.peak_allocs();
+
+    heap.reset();
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+    REQUIRE(heap.peak_used() == peak_used);
+    REQUIRE(heap.peak_allocs() == peak_allocs);
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    // The large block is gone, and placement starts over from the beginning
+    REQUIRE_FALSE(heap.owns(large));
+    REQUIRE(heap.alloc(100) == first);
+
+    // All of it is usable again
+    void *rest = heap.alloc(heap.total_size() - 3 * sizeof(BlockHeader) - 128);
+    REQUIRE(rest != nullptr);
+}
+
+TEST_CASE("Resetting with every fit policy") {
+    auto const exercise = []<typename HeapType>(HeapType &heap) {
+        std::vector<void *> blocks;
+        for(std::size_t i = 0; i < 100; ++i) {
+            blocks.push_back(heap.alloc(32 + (i % 7) * 16));
+        }
+        for(std::size_t i = 0; i < blocks.size(); i += 2) {
+            heap.free(blocks[i]);
+        }
+
+        heap.reset();
+        REQUIRE(heap.current_allocs() == 0);
+
+        // Nothing left over from before should be handed out twice
+        blocks.clear();
+        for(std::size_t i = 0; i < 100; ++i) {
+            auto *address = heap.alloc(48);
+            std::memset(address, static_cast<int>(i), 48);
+            blocks.push_back(address);
+        }
+        for(std::size_t i = 0; i < blocks.size(); ++i) {
+            auto const *bytes = static_cast<std::uint8_t const *>(blocks[i]);
+            REQUIRE(bytes[0] == i);
+            REQUIRE(bytes[47] == i);
+        }
+    };
+
+    BasicHeap<FirstFit, NoLock, HeapStats, sizeof(void *)> first_fit(16384);
+    BasicHeap<NextFit, NoLock, HeapStats, sizeof(void *)> next_fit(16384);
+    BasicHeap<BestFit, NoLock, HeapStats, sizeof(void *)> best_fit(16384);
+    BasicHeap<IndexedFirstFit, NoLock, HeapStats, sizeof(void *)>
+        indexed(16384);
+
+    exercise(first_fit);
+    exercise(next_fit);
+    exercise(best_fit);
+    exercise(indexed);
+}
+
+TEST_CASE("Trimming a lazily committed heap gives its pages back") {
+    Heap heap(std::size_t { 1 } << 30, lazy_commit);
+
+    auto const initial = heap.committed_bytes();
+
+    std::vector<void *> blocks;
+    for(std::size_t i = 0; i < 64; ++i) {
+        blocks.push_back(heap.alloc(64 * 1024));
+        std::memset(blocks.back(), 0xee, 64 * 1024);
+    }
+    REQUIRE(heap.committed_bytes() >= 64 * 64 * 1024);
+
+    // Without trimming, the heap keeps what it committed
+    auto const committed = heap.committed_bytes();
+    heap.reset();
+    REQUIRE(heap.committed_bytes() == committed);
+
+    for(std::size_t i = 0; i < 64; ++i) {
+        std::memset(heap.alloc(64 * 1024), 0xdd, 64 * 1024);
+    }
+
+    heap.reset(true);
+    REQUIRE(heap.committed_bytes() <= initial);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+
+    // And commits again as it grows
+    auto *block = heap.alloc(8 << 20);
+    std::memset(block, 0x11, 8 << 20);
+    REQUIRE(heap.committed_bytes() >= 8 << 20);
+}
+
+TEST_CASE("Trimming a fully committed heap keeps it usable") {
+    Heap heap(1 << 20);
+
+    auto *block = static_cast<std::uint8_t *>(heap.alloc(512 * 1024));
+    std::memset(block, 0x42, 512 * 1024);
+
+    heap.reset(true);
+
+    auto *again = static_cast<std::uint8_t *>(heap.alloc(512 * 1024));
+    REQUIRE(again == block);
+    std::memset(again, 0x24, 512 * 1024);
+    REQUIRE(again[512 * 1024 - 1] == 0x24);
+}
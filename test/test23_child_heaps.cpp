@@ -0,0 +1,147 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+#include "brasstacks/memory/LargeBlockList.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Child heaps live in one block of their parent") {
+    Heap parent(64 * 1024);
+    auto const parent_used = parent.current_used();
+
+    auto child = parent.create_child(16 * 1024);
+    REQUIRE(parent.child_count() == 1);
+    REQUIRE(parent.current_allocs() == 1);
+    REQUIRE(child->total_size() <= 16 * 1024);
+    REQUIRE(child->total_size() > 15 * 1024);
+
+    std::vector<void *> blocks;
+    while(void *address = child->try_alloc(100)) {
+        std::memset(address, 0x77, 100);
+        blocks.push_back(address);
+    }
+
+    // The child fills up on its own, without reaching into the parent
+    REQUIRE(blocks.size() > 100);
+    for(void *address : blocks) {
+        REQUIRE(parent.owns(address));
+        REQUIRE(child->owns(address));
+    }
+    REQUIRE(parent.current_allocs() == 1);
+
+    // And everything it held goes back in a single free
+    child.reset();
+    REQUIRE(parent.child_count() == 0);
+    REQUIRE(parent.current_allocs() == 0);
+    REQUIRE(parent.current_used() == parent_used);
+    REQUIRE_THAT(parent.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+}
+
+TEST_CASE("Child heap stats roll up into their parent's") {
+    Heap parent(256 * 1024);
+    void *own = parent.alloc(1000);
+
+    auto first = parent.create_child(32 * 1024);
+    auto second = parent.create_child(32 * 1024);
+    auto grandchild = first->create_child(8 * 1024);
+
+    REQUIRE(parent.child_count() == 2);
+    REQUIRE(first->child_count() == 1);
+
+    for(std::size_t i = 0; i < 10; ++i) {
+        (void)first->alloc(64);
+    }
+    for(std::size_t i = 0; i < 20; ++i) {
+        (void)second->alloc(128);
+    }
+    for(std::size_t i = 0; i < 5; ++i) {
+        (void)grandchild->alloc(256);
+    }
+
+    // The parent's own view only sees the children's blocks
+    REQUIRE(parent.current_allocs() == 3);
+    REQUIRE(first->current_allocs() == 11);
+
+    REQUIRE(grandchild->subtree_allocs() == 5);
+    REQUIRE(first->subtree_allocs() == 15);
+    REQUIRE(parent.subtree_allocs() == 1 + 15 + 20);
+
+    // Used bytes swap each child's block for what's used inside it
+    auto const own_used = parent.current_used()
+                        - BlockHeader::header(own)->size;
+    auto const expected_used = own_used
+                             - 2 * 32 * 1024 + 1000
+                             + first->subtree_used()
+                             + second->subtree_used();
+    REQUIRE(parent.subtree_used() == expected_used);
+    REQUIRE(parent.subtree_used() < parent.current_used());
+
+    grandchild.reset();
+    REQUIRE(first->child_count() == 0);
+    REQUIRE(parent.subtree_allocs() == 1 + 10 + 20);
+
+    // Destroying children out of the order they were made in is fine
+    first.reset();
+    REQUIRE(parent.child_count() == 1);
+    REQUIRE(parent.subtree_allocs() == 1 + 20);
+
+    second.reset();
+    REQUIRE(parent.child_count() == 0);
+    REQUIRE(parent.subtree_allocs() == 1);
+    REQUIRE(parent.subtree_used() == parent.current_used());
+
+    parent.free(own);
+    REQUIRE(parent.current_used() == sizeof(BlockHeader));
+}
+
+TEST_CASE("Child heaps can be carved from large blocks") {
+    Heap parent(4096);
+    parent.set_large_threshold(1024);
+
+    auto child = parent.create_child(1 << 20);
+    REQUIRE(parent.current_allocs() == 1);
+
+    void *address = child->alloc(512 * 1024);
+    std::memset(address, 0x33, 512 * 1024);
+    REQUIRE(child->owns(address));
+
+    REQUIRE(parent.subtree_allocs() == 1);
+
+    child.reset();
+    REQUIRE(parent.current_allocs() == 0);
+    REQUIRE(parent.current_used() == sizeof(BlockHeader));
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Parents refuse to reset or die under a live child") {
+    REQUIRE(aborts([] {
+        Heap parent(64 * 1024);
+        auto child = parent.create_child(16 * 1024);
+        (void)child->alloc(100);
+
+        parent.reset();
+    }));
+
+    REQUIRE(aborts([] {
+        auto parent = std::make_unique<Heap>(64 * 1024);
+        auto child = parent->create_child(16 * 1024);
+
+        parent.reset();
+    }));
+
+    // Once the child is gone, both are fine
+    Heap parent(64 * 1024);
+    auto child = parent.create_child(16 * 1024);
+    child.reset();
+
+    parent.reset();
+    REQUIRE(parent.child_count() == 0);
+    REQUIRE(parent.current_allocs() == 0);
+}
+#endif
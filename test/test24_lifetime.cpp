@@ -0,0 +1,240 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Long-lived allocations come from the far end of the heap") {
+    Heap heap(4096);
+
+    auto *first = static_cast<std::uint8_t *>(heap.alloc(64));
+    auto *survivor = static_cast<std::uint8_t *>(
+        heap.alloc(64, Lifetime::long_lived)
+    );
+    auto *second = static_cast<std::uint8_t *>(heap.alloc(64));
+    auto *older = static_cast<std::uint8_t *>(
+        heap.alloc(64, Lifetime::long_lived)
+    );
+
+    // Short-lived blocks pack together from the start, long-lived ones from
+    // the end, working down
+    REQUIRE(second == first + 64 + sizeof(BlockHeader));
+    REQUIRE(older + 64 + sizeof(BlockHeader) == survivor);
+    REQUIRE(survivor + 64 == first - sizeof(BlockHeader) + heap.total_size());
+
+    REQUIRE(heap.current_allocs() == 4);
+    REQUIRE(heap.current_used() == 5 * sizeof(BlockHeader) + 4 * 64);
+
+    // Once the churn is gone, what's left is one free region, not two
+    heap.free(first);
+    heap.free(second);
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+
+    // And freeing the survivors gives back the whole heap
+    heap.free(older);
+    heap.free(survivor);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+
+    void *everything = heap.alloc(heap.total_size() - sizeof(BlockHeader));
+    REQUIRE(everything != nullptr);
+}
+
+TEST_CASE("Survivors don't fragment the space churn leaves behind") {
+    auto const run = [](Lifetime const lifetime) {
+        Heap heap(256 * 1024);
+
+        std::vector<void *> churn;
+        std::vector<void *> survivors;
+
+        for(std::size_t i = 0; i < 100; ++i) {
+            churn.push_back(heap.alloc(200));
+            if(i % 10 == 0) {
+                survivors.push_back(heap.alloc(48, lifetime));
+            }
+        }
+
+        for(void *address : churn) {
+            heap.free(address);
+        }
+
+        auto const fragmentation = heap.calc_fragmentation();
+
+        for(void *address : survivors) {
+            heap.free(address);
+        }
+        REQUIRE(heap.current_used() == sizeof(BlockHeader));
+
+        return fragmentation;
+    };
+
+    REQUIRE(run(Lifetime::short_lived) > 0.05f);
+    REQUIRE_THAT(run(Lifetime::long_lived), WithinAbs(0.0f, epsilon));
+}
+
+TEST_CASE("Long-lived allocations reuse holes among their own kind") {
+    Heap heap(8192);
+
+    void *low = heap.alloc(64);
+
+    void *first = heap.alloc(128, Lifetime::long_lived);
+    void *second = heap.alloc(128, Lifetime::long_lived);
+    void *third = heap.alloc(128, Lifetime::long_lived);
+
+    // The hole goes on the free list, but the next survivor fills it rather
+    // than pushing further into the top chunk
+    heap.free(second);
+    void *refill = heap.alloc(128, Lifetime::long_lived);
+    REQUIRE(refill == second);
+
+    // While short-lived requests keep to the near end
+    heap.free(refill);
+    void *short_lived = heap.alloc(128);
+    REQUIRE(short_lived != second);
+    REQUIRE(short_lived > low);
+    REQUIRE(short_lived < third);
+
+    heap.free(short_lived);
+    heap.free(low);
+    heap.free(first);
+    heap.free(third);
+
+    REQUIRE(heap.current_allocs() == 0);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+    REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+}
+
+TEST_CASE("Long-lived allocations fall back to the free list") {
+    Heap heap(2048);
+
+    // Use up the top chunk, leaving one free block near the start
+    void *hole = heap.alloc(256);
+    void *fence = heap.alloc(64);
+    while(heap.try_alloc(64) != nullptr) { }
+    heap.free(hole);
+
+    void *survivor = heap.try_alloc(128, Lifetime::long_lived);
+    REQUIRE(survivor == hole);
+    REQUIRE(heap.try_alloc(256, Lifetime::long_lived) == nullptr);
+
+    (void)fence;
+}
+
+TEST_CASE("Long-lived allocations work with every fit policy") {
+    auto const exercise = []<typename HeapType>(HeapType &heap) {
+        std::vector<void *> blocks;
+        for(std::size_t i = 0; i < 200; ++i) {
+            auto const lifetime = i % 3 == 0 ? Lifetime::long_lived
+                                             : Lifetime::short_lived;
+            auto *address = heap.alloc(32 + (i % 5) * 24, lifetime);
+            std::memset(address, static_cast<int>(i), 32);
+            blocks.push_back(address);
+        }
+
+        for(std::size_t i = 0; i < blocks.size(); i += 2) {
+            heap.free(blocks[i]);
+            blocks[i] = nullptr;
+        }
+
+        for(std::size_t i = 0; i < blocks.size(); i += 2) {
+            blocks[i] = heap.alloc(40, i % 4 == 0 ? Lifetime::long_lived
+                                                  : Lifetime::short_lived);
+            std::memset(blocks[i], static_cast<int>(i), 32);
+        }
+
+        for(std::size_t i = 0; i < blocks.size(); ++i) {
+            auto const *bytes = static_cast<std::uint8_t const *>(blocks[i]);
+            REQUIRE(bytes[0] == static_cast<std::uint8_t>(i));
+            REQUIRE(bytes[31] == static_cast<std::uint8_t>(i));
+        }
+
+        for(void *address : blocks) {
+            heap.free(address);
+        }
+
+        REQUIRE(heap.current_used() == sizeof(BlockHeader));
+        REQUIRE_THAT(heap.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+    };
+
+    BasicHeap<FirstFit, NoLock, HeapStats, sizeof(void *)> first_fit(32768);
+    BasicHeap<NextFit, NoLock, HeapStats, sizeof(void *)> next_fit(32768);
+    BasicHeap<BestFit, NoLock, HeapStats, sizeof(void *)> best_fit(32768);
+    BasicHeap<IndexedFirstFit, NoLock, HeapStats, sizeof(void *)>
+        indexed(32768);
+
+    exercise(first_fit);
+    exercise(next_fit);
+    exercise(best_fit);
+    exercise(indexed);
+}
+
+TEST_CASE("Lazily committed heaps commit long-lived blocks from the end") {
+    Heap heap(std::size_t { 4 } << 30, lazy_commit);
+    auto const initial = heap.committed_bytes();
+
+    auto *survivor = static_cast<std::uint8_t *>(
+        heap.alloc(4096, Lifetime::long_lived)
+    );
+    std::memset(survivor, 0x5a, 4096);
+
+    auto *churn = static_cast<std::uint8_t *>(heap.alloc(4096));
+    std::memset(churn, 0xa5, 4096);
+
+    // Only a chunk at each end is committed, not the gigabytes between
+    REQUIRE(heap.committed_bytes() > initial);
+    REQUIRE(heap.committed_bytes() <= 2 * initial + 4096);
+
+    heap.free(survivor);
+    heap.free(churn);
+    REQUIRE(heap.current_used() == sizeof(BlockHeader));
+
+    // Trimming hands back both ends
+    heap.reset(true);
+    REQUIRE(heap.committed_bytes() <= initial);
+
+    survivor = static_cast<std::uint8_t *>(
+        heap.alloc(4096, Lifetime::long_lived)
+    );
+    std::memset(survivor, 0x11, 4096);
+}
+
+TEST_CASE("Snapshots keep long-lived blocks") {
+    char const *path = "/tmp/btx_heap_lifetime.bin";
+
+    std::size_t survivor_offset = 0;
+
+    {
+        Heap heap(std::size_t { 64 } << 20, lazy_commit);
+        auto *base = static_cast<std::uint8_t *>(heap.alloc(64));
+        auto *survivor = static_cast<char *>(
+            heap.alloc(64, Lifetime::long_lived)
+        );
+        std::strcpy(survivor, "survivor");
+        survivor_offset = static_cast<std::size_t>(
+            reinterpret_cast<std::uint8_t *>(survivor) - base
+        );
+
+        REQUIRE(heap.save(path));
+    }
+
+    Heap restored(FromSnapshot { path });
+    REQUIRE(restored.current_allocs() == 2);
+
+    // The first block sits at the start of the heap, wherever it landed
+    auto *base = static_cast<std::uint8_t *>(restored.alloc(64))
+               - 64 - sizeof(BlockHeader);
+    auto const *survivor =
+        reinterpret_cast<char const *>(base + survivor_offset);
+    REQUIRE(std::strcmp(survivor, "survivor") == 0);
+
+    // The space between the two ends is still one piece
+    REQUIRE_THAT(restored.calc_fragmentation(), WithinAbs(0.0f, epsilon));
+    REQUIRE(restored.alloc(32 << 20, Lifetime::long_lived) != nullptr);
+
+    std::remove(path);
+}
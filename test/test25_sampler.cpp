@@ -0,0 +1,210 @@
+#include "brasstacks/memory/AllocationSampler.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+namespace {
+
+// Stand-ins for allocations; the sampler never touches what they point at
+void const * fake_address(std::size_t const index) {
+    return reinterpret_cast<void const *>((index + 1) * 64);
+}
+
+// Two distinct call sites, kept out of line so each has a frame of its own.
+// Each loops internally, since a loop the compiler unrolls in the caller
+// would make every iteration a call site of its own.
+#if defined(__GNUC__)
+    #define TEST_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+    #define TEST_NOINLINE __declspec(noinline)
+#else
+    #define TEST_NOINLINE
+#endif
+
+TEST_NOINLINE void sample_from_a(AllocationSampler &sampler,
+                                 std::size_t const first,
+                                 std::size_t const count,
+                                 std::size_t const bytes)
+{
+    for(std::size_t i = first; i < first + count; ++i) {
+        if(sampler.should_sample(bytes)) {
+            sampler.record(fake_address(i), bytes);
+        }
+    }
+}
+
+TEST_NOINLINE void sample_from_b(AllocationSampler &sampler,
+                                 std::size_t const first,
+                                 std::size_t const count,
+                                 std::size_t const bytes)
+{
+    for(std::size_t i = first; i < first + count; ++i) {
+        if(sampler.should_sample(bytes)) {
+            sampler.record(fake_address(i), bytes);
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("Sampled allocations are grouped by call stack") {
+    // An interval of one byte samples everything
+    AllocationSampler sampler(1);
+
+    sample_from_a(sampler, 0, 10, 100);
+    sample_from_b(sampler, 10, 4, 1000);
+
+    REQUIRE(sampler.live_samples() == 14);
+
+    auto sites = sampler.sites();
+    REQUIRE(sites.size() == 2);
+
+    // Heaviest first
+    REQUIRE(sites[0].live_samples == 4);
+    REQUIRE(sites[0].live_bytes == 4000);
+    REQUIRE(sites[1].live_samples == 10);
+    REQUIRE(sites[1].live_bytes == 1000);
+
+    REQUIRE_THAT(sites[0].estimated_bytes, WithinRel(4000.0, 1.0e-6));
+    REQUIRE_FALSE(sites[0].frames.empty());
+    REQUIRE(sites[0].frames != sites[1].frames);
+
+    // Freed samples leave their sites, but the totals remember them
+    for(std::size_t i = 10; i < 14; ++i) {
+        sampler.forget(fake_address(i));
+    }
+    sampler.forget(fake_address(100));
+
+    sites = sampler.sites();
+    REQUIRE(sites.size() == 1);
+    REQUIRE(sites[0].live_samples == 10);
+    REQUIRE(sites[0].total_samples == 10);
+
+    sampler.clear();
+    REQUIRE(sampler.live_samples() == 0);
+    REQUIRE(sampler.sites().empty());
+}
+
+TEST_CASE("Sampling estimates what's live from a fraction of it") {
+    AllocationSampler sampler(64 * 1024);
+
+    std::size_t const count = 1'000'000;
+    sample_from_a(sampler, 0, count, 256);
+    sample_from_b(sampler, count, 10'000, 16 * 1024);
+
+    // Only a sliver of the allocations were captured
+    REQUIRE(sampler.live_samples() < count / 50);
+
+    // But scaled back up, they're close to the truth for both sizes
+    auto const sites = sampler.sites();
+    REQUIRE(sites.size() == 2);
+
+    double const small_bytes = count * 256.0;
+    double const large_bytes = 10'000 * 16.0 * 1024.0;
+
+    REQUIRE_THAT(sites[0].estimated_bytes, WithinRel(small_bytes, 0.1));
+    REQUIRE_THAT(sites[0].estimated_count,
+                 WithinRel(static_cast<double>(count), 0.1));
+    REQUIRE_THAT(sites[1].estimated_bytes, WithinRel(large_bytes, 0.1));
+}
+
+TEST_CASE("Sampled sites dump as folded stacks and pprof profiles") {
+    AllocationSampler sampler(1);
+
+    sample_from_a(sampler, 0, 3, 128);
+    sample_from_b(sampler, 3, 1, 512);
+
+    auto const folded_path =
+        (std::filesystem::temp_directory_path() / "btx_sampler.folded")
+        .string();
+    auto const pprof_path =
+        (std::filesystem::temp_directory_path() / "btx_sampler.heap")
+        .string();
+
+    REQUIRE(sampler.dump_folded(folded_path.c_str()));
+    REQUIRE(sampler.dump_pprof(pprof_path.c_str()));
+
+    // One line per site: frames joined by semicolons, then the bytes
+    std::ifstream folded(folded_path);
+    std::vector<std::string> lines;
+    for(std::string line; std::getline(folded, line);) {
+        lines.push_back(line);
+    }
+
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].ends_with(" 512"));
+    REQUIRE(lines[1].ends_with(" 384"));
+    REQUIRE(lines[0].find(';') != std::string::npos);
+
+    std::ifstream pprof(pprof_path);
+    std::string header;
+    std::getline(pprof, header);
+    REQUIRE(header == "heap profile: 4: 896 [4: 896] @ heap_v2/1");
+
+    std::string site;
+    std::getline(pprof, site);
+    REQUIRE(site.starts_with("1: 512 [1: 512] @ 0x"));
+
+    std::filesystem::remove(folded_path);
+    std::filesystem::remove(pprof_path);
+}
+
+#ifdef BTX_MEMORY_SAMPLING
+TEST_CASE("Heaps report sampled allocations and frees") {
+    AllocationSampler sampler(1);
+    Heap heap(64 * 1024);
+    heap.set_large_threshold(8192);
+    heap.set_sampler(&sampler);
+
+    std::vector<void *> blocks;
+    for(std::size_t i = 0; i < 20; ++i) {
+        blocks.push_back(heap.alloc(128));
+    }
+    void *large = heap.alloc(64 * 1024);
+
+    REQUIRE(sampler.live_samples() == 21);
+
+    auto sites = sampler.sites();
+    REQUIRE_FALSE(sites.empty());
+    REQUIRE(sites[0].live_bytes == 64 * 1024);
+
+    for(std::size_t i = 0; i < blocks.size(); i += 2) {
+        heap.free(blocks[i]);
+    }
+    heap.free(large);
+    REQUIRE(sampler.live_samples() == 10);
+
+    // Blocks freed while no sampler is attached just drop their mark, and
+    // reuse of the space starts clean
+    heap.set_sampler(nullptr);
+    heap.free(blocks[1]);
+    void *unsampled = heap.alloc(128);
+    heap.set_sampler(&sampler);
+    heap.free(unsampled);
+    REQUIRE(sampler.live_samples() == 10);
+
+    // Resetting only forgets this heap's samples, large blocks included,
+    // and leaves those of other heaps sharing the sampler
+    Heap other(16 * 1024);
+    other.set_sampler(&sampler);
+    void *kept = other.alloc(256);
+    (void)heap.alloc(64 * 1024);
+    REQUIRE(sampler.live_samples() == 12);
+
+    heap.reset();
+    REQUIRE(sampler.live_samples() == 1);
+
+    other.free(kept);
+    REQUIRE(sampler.live_samples() == 0);
+}
+#endif
@@ -0,0 +1,264 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace btx::memory;
+
+namespace {
+
+struct PressureLog final {
+    std::vector<std::size_t> used;
+};
+
+void record_pressure(void *context, std::size_t const used) {
+    static_cast<PressureLog *>(context)->used.push_back(used);
+}
+
+// One watermark's context, noting which of several fired, in what order
+struct Mark final {
+    std::vector<float> *fired;
+    float fraction;
+};
+
+void record_mark(void *context, std::size_t const) {
+    auto const *mark = static_cast<Mark *>(context);
+    mark->fired->push_back(mark->fraction);
+}
+
+// Removes every watermark in the table from inside a callback, as a cache
+// that's shutting down might
+struct Unregister final {
+    Heap *heap;
+    std::vector<Mark> *marks;
+    std::vector<float> *fired;
+};
+
+void unregister_all(void *context, std::size_t const) {
+    auto *unregister = static_cast<Unregister *>(context);
+    unregister->fired->push_back(0.0f);
+
+    for(auto &mark : *unregister->marks) {
+        unregister->heap->remove_watermark(record_mark, &mark);
+    }
+}
+
+// Stands in for a cache that's been filling the heap with entries it can
+// drop whenever it's asked to
+struct Cache final {
+    Heap *heap;
+    std::vector<void *> entries;
+    std::size_t evictions = 0;
+
+    void evict(std::size_t count) {
+        while(count-- > 0 && !entries.empty()) {
+            heap->free(entries.back());
+            entries.pop_back();
+            ++evictions;
+        }
+    }
+};
+
+void trim_cache(void *context, std::size_t const) {
+    static_cast<Cache *>(context)->evict(8);
+}
+
+bool evict_for_request(void *context, std::size_t const) {
+    auto *cache = static_cast<Cache *>(context);
+    if(cache->entries.empty()) {
+        return false;
+    }
+
+    cache->evict(1);
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("Watermarks fire once on the way up") {
+    Heap heap(64 * 1024);
+
+    PressureLog half;
+    PressureLog three_quarters;
+    REQUIRE(heap.add_watermark(0.5f, record_pressure, &half));
+    REQUIRE(heap.add_watermark(0.75f, record_pressure, &three_quarters));
+
+    std::vector<void *> blocks;
+    while(heap.current_used() < heap.total_size() * 6 / 10) {
+        blocks.push_back(heap.alloc(1024));
+    }
+
+    REQUIRE(half.used.size() == 1);
+    REQUIRE(half.used[0] >= heap.total_size() / 2);
+    REQUIRE(three_quarters.used.empty());
+
+    // Churning above the watermark doesn't fire it again
+    for(int i = 0; i < 10; ++i) {
+        heap.free(blocks.back());
+        blocks.back() = heap.alloc(1024);
+    }
+    REQUIRE(half.used.size() == 1);
+
+    while(heap.current_used() < heap.total_size() * 8 / 10) {
+        blocks.push_back(heap.alloc(1024));
+    }
+
+    REQUIRE(half.used.size() == 1);
+    REQUIRE(three_quarters.used.size() == 1);
+
+    // Dropping back below re-arms it
+    while(heap.current_used() >= heap.total_size() / 2) {
+        heap.free(blocks.back());
+        blocks.pop_back();
+    }
+    blocks.push_back(heap.alloc(heap.total_size() / 4));
+
+    REQUIRE(half.used.size() == 2);
+    REQUIRE(three_quarters.used.size() == 1);
+
+    // Once removed, it stays quiet
+    REQUIRE(heap.remove_watermark(record_pressure, &half));
+    REQUIRE_FALSE(heap.remove_watermark(record_pressure, &half));
+
+    heap.reset();
+    blocks.clear();
+    while(heap.current_used() < heap.total_size() * 6 / 10) {
+        blocks.push_back(heap.alloc(1024));
+    }
+    REQUIRE(half.used.size() == 2);
+}
+
+TEST_CASE("Watermark callbacks can free from the heap") {
+    Heap heap(64 * 1024);
+
+    Cache cache { .heap = &heap };
+    REQUIRE(heap.add_watermark(0.5f, trim_cache, &cache));
+
+    while(cache.evictions == 0) {
+        cache.entries.push_back(heap.alloc(512));
+    }
+
+    REQUIRE(cache.evictions == 8);
+    REQUIRE(heap.current_used() < heap.total_size() / 2);
+}
+
+TEST_CASE("Only so many watermarks can be registered") {
+    Heap heap(4096);
+
+    // Registered highest first, so firing in registration order would show
+    std::vector<float> fired;
+    std::vector<Mark> marks;
+    for(std::size_t i = Heap::max_watermarks; i > 0; --i) {
+        marks.push_back({ &fired, 0.1f * static_cast<float>(i) });
+    }
+
+    for(auto &mark : marks) {
+        REQUIRE(heap.add_watermark(mark.fraction, record_mark, &mark));
+    }
+
+    Mark extra { &fired, 0.95f };
+    REQUIRE_FALSE(heap.add_watermark(extra.fraction, record_mark, &extra));
+
+    // Passing several at once fires them all, lowest first
+    void *block = heap.alloc(2048);
+    REQUIRE(fired.size() == 5);
+    REQUIRE(std::is_sorted(fired.begin(), fired.end()));
+    REQUIRE(fired.front() == marks.back().fraction);
+
+    heap.free(block);
+}
+
+TEST_CASE("Fractions that can't become a byte count are refused") {
+    Heap heap(4096);
+
+    PressureLog log;
+    REQUIRE_FALSE(heap.add_watermark(-0.5f, record_pressure, &log));
+    REQUIRE_FALSE(heap.add_watermark(
+        std::numeric_limits<float>::quiet_NaN(), record_pressure, &log
+    ));
+    REQUIRE_FALSE(heap.add_watermark(
+        std::numeric_limits<float>::infinity(), record_pressure, &log
+    ));
+
+    // None of them took a slot
+    REQUIRE_FALSE(heap.remove_watermark(record_pressure, &log));
+    REQUIRE(heap.add_watermark(0.0f, record_pressure, &log));
+}
+
+TEST_CASE("Watermarks removed mid-callback still fire exactly once") {
+    Heap heap(4096);
+
+    // The table gets reshuffled by every removal, which mustn't change what
+    // an allocation that's already passed them calls back
+    std::vector<float> fired;
+    std::vector<Mark> marks;
+    for(std::size_t i = 1; i < Heap::max_watermarks; ++i) {
+        marks.push_back({ &fired, 0.1f * static_cast<float>(i) });
+    }
+
+    Unregister unregister { .heap = &heap, .marks = &marks, .fired = &fired };
+    REQUIRE(heap.add_watermark(0.05f, unregister_all, &unregister));
+    for(auto &mark : marks) {
+        REQUIRE(heap.add_watermark(mark.fraction, record_mark, &mark));
+    }
+
+    // Passes 0.05 through 0.4, and the first callback removes the rest
+    void *block = heap.alloc(1800);
+    REQUIRE(fired == std::vector<float> { 0.0f, 0.1f, 0.2f, 0.3f, 0.4f });
+
+    // And the ones that were removed stay quiet
+    void *more = heap.alloc(1800);
+    REQUIRE(fired.size() == 5);
+
+    heap.free(more);
+    heap.free(block);
+}
+
+TEST_CASE("Large blocks count toward watermarks") {
+    Heap heap(16 * 1024);
+    heap.set_large_threshold(4096);
+
+    PressureLog log;
+    REQUIRE(heap.add_watermark(2.0f, record_pressure, &log));
+
+    void *small = heap.alloc(1024);
+    void *large = heap.alloc(8192);
+    REQUIRE(log.used.empty());
+
+    large = heap.realloc(large, 64 * 1024);
+    REQUIRE(log.used.size() == 1);
+    REQUIRE(log.used[0] > 2 * heap.total_size());
+
+    heap.free(large);
+    heap.free(small);
+}
+
+TEST_CASE("An exhaustion handler gets a chance to make room") {
+    Heap heap(64 * 1024);
+
+    Cache cache { .heap = &heap };
+    heap.set_exhaustion_handler(evict_for_request, &cache);
+
+    // Fill the heap with cache entries
+    while(void *entry = heap.try_alloc(1024)) {
+        cache.entries.push_back(entry);
+    }
+    auto const cached = cache.entries.size();
+
+    // try_alloc() leaves the failure to its caller
+    REQUIRE(heap.try_alloc(4096) == nullptr);
+    REQUIRE(cache.evictions == 0);
+
+    // alloc() has the cache give up entries until the request fits
+    void *block = heap.alloc(4096);
+    REQUIRE(block != nullptr);
+    REQUIRE(cache.evictions > 0);
+    REQUIRE(cache.evictions < cached);
+
+    heap.free(block);
+    heap.set_exhaustion_handler(nullptr, nullptr);
+}
@@ -0,0 +1,104 @@
+#include "brasstacks/memory/BlockHeader.hpp"
+#include "brasstacks/memory/Heap.hpp"
+
+#include "test_helpers.hpp"
+
+using namespace btx::memory;
+using namespace Catch::Matchers;
+
+TEST_CASE("Free blocks past the head in ascending address order, keeping the "
+          "free list sorted so neighbours coalesce")
+{
+    Heap heap(2048);
+
+    std::size_t const size = 64;
+    std::size_t const stride = sizeof(BlockHeader) + size;
+
+    void *alloc_a = heap.alloc(size);
+    void *alloc_b = heap.alloc(size);
+    void *alloc_c = heap.alloc(size);
+    void *alloc_d = heap.alloc(size);
+    void *alloc_e = heap.alloc(size);
+    void *alloc_f = heap.alloc(size);
+    void *alloc_g = heap.alloc(size);
+
+    BlockHeader *header_b = BlockHeader::header(alloc_b);
+    BlockHeader *header_d = BlockHeader::header(alloc_d);
+    BlockHeader *header_f = BlockHeader::header(alloc_f);
+
+    // The blocks sit back to back, with g keeping the rest of them away from
+    // the top chunk
+    auto const *raw_heap = reinterpret_cast<std::uint8_t const *>(
+        BlockHeader::header(alloc_a)
+    );
+    REQUIRE(reinterpret_cast<std::uint8_t *>(header_b) == raw_heap + stride);
+    REQUIRE(reinterpret_cast<std::uint8_t *>(header_d)
+            == raw_heap + 3 * stride);
+    REQUIRE(reinterpret_cast<std::uint8_t *>(header_f)
+            == raw_heap + 5 * stride);
+
+    //--------------------------------------------------------------------------
+    // Free b, which becomes the head of the free list
+    heap.free(alloc_b);
+
+    REQUIRE(heap.current_allocs() == 6);
+    REQUIRE(header_b->next == nullptr);
+    REQUIRE(header_b->prev == nullptr);
+
+    //--------------------------------------------------------------------------
+    // Free d, which lands after the head
+    heap.free(alloc_d);
+
+    REQUIRE(heap.current_allocs() == 5);
+    REQUIRE(header_b->next == header_d);
+    REQUIRE(header_b->prev == nullptr);
+    REQUIRE(header_d->next == nullptr);
+    REQUIRE(header_d->prev == header_b);
+
+    //--------------------------------------------------------------------------
+    // Free f, which has to be walked past d rather than linked in directly
+    // after the head
+    heap.free(alloc_f);
+
+    REQUIRE(heap.current_allocs() == 4);
+    REQUIRE(header_b->next == header_d);
+    REQUIRE(header_b->prev == nullptr);
+    REQUIRE(header_d->next == header_f);
+    REQUIRE(header_d->prev == header_b);
+    REQUIRE(header_f->next == nullptr);
+    REQUIRE(header_f->prev == header_d);
+
+    // Three separate holes of the same size
+    REQUIRE(header_b->size == size);
+    REQUIRE(header_d->size == size);
+    REQUIRE(header_f->size == size);
+
+    //--------------------------------------------------------------------------
+    // Free c, which merges b, c and d into one block
+    heap.free(alloc_c);
+
+    REQUIRE(heap.current_allocs() == 3);
+    REQUIRE(header_b->size == 2 * stride + size);
+    REQUIRE(header_b->next == header_f);
+    REQUIRE(header_b->prev == nullptr);
+    REQUIRE(header_f->next == nullptr);
+    REQUIRE(header_f->prev == header_b);
+
+    //--------------------------------------------------------------------------
+    // Free e, which merges everything from b through f
+    heap.free(alloc_e);
+
+    REQUIRE(heap.current_allocs() == 2);
+    REQUIRE(header_b->size == 4 * stride + size);
+    REQUIRE(header_b->next == nullptr);
+    REQUIRE(header_b->prev == nullptr);
+
+    // Which a request for all of that space now fits in exactly
+    void *alloc_h = heap.alloc(4 * stride + size);
+    REQUIRE(alloc_h == alloc_b);
+
+    heap.free(alloc_a);
+    heap.free(alloc_g);
+    heap.free(alloc_h);
+    REQUIRE(heap.current_allocs() == 0);
+}
@@ -7,6 +7,8 @@
 #include <functional>
 #include <vector>
 #include <numeric>
+#include <cstdio>
+#include <cstring>
 
 using namespace btx::memory;
 
@@ -69,45 +71,43 @@ TEST_CASE("Benchmarking""[!benchmark]") {
 
     // Test plain malloc() and free()
     BENCHMARK("libstdc malloc and free") {
-        return [&] {
-            std::size_t alloc = 0;
+        std::size_t alloc = 0;
 
-            // Allocate the first half
-            do {
-                allocs[alloc] = std::malloc(alloc_sizes[alloc]);
+        // Allocate the first half
+        do {
+            allocs[alloc] = std::malloc(alloc_sizes[alloc]);
 
-                // Zero the memory
-                std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
+            // Zero the memory
+            std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
 
-                // Write some "useful" information
-                auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
-                *new_block = alloc_sizes[alloc];
+            // Write some "useful" information
+            auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
+            *new_block = alloc_sizes[alloc];
 
-                ++alloc;
-            } while(alloc < alloc_count/2);
+            ++alloc;
+        } while(alloc < alloc_count/2);
 
-            // Free the first half in random order
-            for(auto const index : free_order_first_half) {
-                ::free(allocs[index]);
-            }
+        // Free the first half in random order
+        for(auto const index : free_order_first_half) {
+            ::free(allocs[index]);
+        }
 
-            // Allocate the second half
-            do {
-                allocs[alloc] = std::malloc(alloc_sizes[alloc]);
+        // Allocate the second half
+        do {
+            allocs[alloc] = std::malloc(alloc_sizes[alloc]);
 
-                // Same nonosense as above
-                std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
-                auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
-                *new_block = alloc_sizes[alloc];
+            // Same nonosense as above
+            std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
+            auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
+            *new_block = alloc_sizes[alloc];
 
-                ++alloc;
-            } while(alloc < alloc_count);
+            ++alloc;
+        } while(alloc < alloc_count);
 
-            // Free the second half in random order
-            for(auto const index : free_order_second_half) {
-                std::free(allocs[index]);
-            }
-        };
+        // Free the second half in random order
+        for(auto const index : free_order_second_half) {
+            std::free(allocs[index]);
+        }
     };
 
     // Create a heap that's guaranteed to be able to hold all of our random
@@ -124,46 +124,62 @@ TEST_CASE("Benchmarking""[!benchmark]") {
 
     // And test its performance
     BENCHMARK("btx::memory alloc and free") {
-        return [&] {
-            std::size_t alloc = 0;
+        std::size_t alloc = 0;
+
+        // Allocate the first half
+        do {
+            allocs[alloc] = heap.alloc(alloc_sizes[alloc]);
 
-            // Allocate the first half
-            do {
-                allocs[alloc] = heap.alloc(alloc_sizes[alloc]);
+            // Zero the memory
+            std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
 
-                // Zero the memory
-                std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
+            // Write some "useful" information
+            auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
+            *new_block = alloc_sizes[alloc];
 
-                // Write some "useful" information
-                auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
-                *new_block = alloc_sizes[alloc];
+            ++alloc;
+        } while(alloc < alloc_count/2);
 
-                ++alloc;
-            } while(alloc < alloc_count/2);
+        // Free the first half in random order
+        for(auto const index : free_order_first_half) {
+            heap.free(allocs[index]);
+        }
 
-            // Free the first half in random order
-            for(auto const index : free_order_first_half) {
-                heap.free(allocs[index]);
-            }
+        // Allocate the second half
+        do {
+            allocs[alloc] = heap.alloc(alloc_sizes[alloc]);
 
-            // Allocate the second half
-            do {
-                allocs[alloc] = heap.alloc(alloc_sizes[alloc]);
+            // Same nonosense as above
+            std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
+            auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
+            *new_block = alloc_sizes[alloc];
 
-                // Same nonosense as above
-                std::memset(allocs[alloc], 0, alloc_sizes[alloc]);
-                auto *new_block = static_cast<std::size_t *>(allocs[alloc]);
-                *new_block = alloc_sizes[alloc];
+            ++alloc;
+        } while(alloc < alloc_count);
 
-                ++alloc;
-            } while(alloc < alloc_count);
+        // Free the second half in random order
+        for(auto const index : free_order_second_half) {
+            heap.free(allocs[index]);
+        }
+    };
 
-            // Free the second half in random order
-            for(auto const index : free_order_second_half) {
-                heap.free(allocs[index]);
-            }
+#ifdef BTX_MEMORY_LATENCY
+    // Catch only reports means, so print the heap's own view of the tails
+    auto const ticks_per_ns = latency_ticks_per_ns();
+    auto const print_latency = [ticks_per_ns](char const *label,
+                                              LatencyHistogram const &h) {
+        auto const ns = [ticks_per_ns](std::uint64_t const ticks) {
+            return static_cast<double>(ticks) / ticks_per_ns;
         };
+
+        std::printf("%s ns: p50 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+                    label, ns(h.p50()), ns(h.p99()), ns(h.p999()),
+                    ns(h.max()));
     };
+
+    print_latency("btx::memory alloc", heap.alloc_latency());
+    print_latency("btx::memory free ", heap.free_latency());
+#endif
 }
 
 // */
\ No newline at end of file
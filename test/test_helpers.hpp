@@ -5,6 +5,89 @@
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <csignal>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
 float constexpr epsilon = 1.0e-6f;
 
+// A block handed out by churn(), filled with a pattern of its own
+struct ChurnBlock {
+    std::uint8_t *address;
+    std::size_t size;
+    std::uint8_t pattern;
+};
+
+struct ChurnResult {
+    std::vector<ChurnBlock> live; // Still allocated once churn() returns
+    bool intact = true;           // No block was written over while live
+};
+
+// Randomly allocate blocks of 1 to max_size bytes from heap, three times for
+// every two frees, checking each block's pattern before free_block() gives it
+// back
+template<typename HeapType, typename FreeBlock>
+ChurnResult churn(HeapType &heap, FreeBlock free_block,
+                  std::minstd_rand::result_type const seed,
+                  std::size_t const max_size, std::size_t const steps)
+{
+    std::minstd_rand rng(seed);
+    std::uniform_int_distribution<std::size_t> size_dist(1, max_size);
+
+    ChurnResult result;
+    auto &live = result.live;
+
+    for(std::size_t i = 0; i < steps; ++i) {
+        if(live.empty() || rng() % 5 < 3) {
+            auto const size = size_dist(rng);
+            auto const pattern = static_cast<std::uint8_t>(i);
+            auto *address = static_cast<std::uint8_t *>(heap.alloc(size));
+
+            std::memset(address, pattern, size);
+            live.push_back({ address, size, pattern });
+        }
+        else {
+            auto const index = rng() % live.size();
+            auto const block = live[index];
+
+            result.intact = result.intact && std::all_of(
+                block.address, block.address + block.size,
+                [&block](std::uint8_t const byte) {
+                    return byte == block.pattern;
+                }
+            );
+
+            free_block(block);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+
+    return result;
+}
+
+#if !defined(_WIN32)
+// Run fn in a forked process, so the test survives it aborting
+template<typename Fn>
+bool aborts(Fn &&fn) {
+    pid_t const child = ::fork();
+    if(child == 0) {
+        fn();
+        ::_exit(0);
+    }
+
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+#endif
+
 #endif // TEST_HELPERS_HPP
\ No newline at end of file